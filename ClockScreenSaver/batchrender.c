@@ -0,0 +1,231 @@
+#include "batchrender.h"
+#include "memusage.h"
+#include "swrender.h"
+#include "timefmt.h"
+
+// Frames handed to each worker per round. Consecutive frames usually differ
+// only in the seconds, which the renderer redraws incrementally.
+#define FRAMES_PER_RUN 64
+
+// Upper bound for the raw frames buffered per round
+#define MAX_ROUND_BUFFER (256 * 1024 * 1024)
+
+#define MAX_FRAME_PATH 1024
+
+typedef struct {
+	const BATCH_JOB *job;
+	GLYPH_CACHE glyphCache;
+	SW_RENDERER renderer;
+	// Frames moved by the burn-in drift, if enabled
+	SURFACE drifted;
+	PLATFORM_THREAD thread;
+	BOOL started;
+
+	// Frames [first, first + count) of the current round
+	UINT first;
+	UINT count;
+	const CLOCK_TIME *times;
+	PBYTE raw;
+
+	BOOL failed;
+	DWORD error;
+} BATCH_WORKER, *PBATCH_WORKER;
+
+BOOL IsValidFramePattern(PCWSTR pattern) {
+	UINT conversions = 0;
+	for (PCWSTR p = pattern; *p; p++) {
+		if (*p != '%') continue;
+		if (p[1] == '%') {
+			p++;
+			continue;
+		}
+
+		p++;
+		if (*p == '0') p++;
+		for (UINT digits = 0; *p >= '0' && *p <= '9'; digits++) {
+			if (digits == 2) return FALSE;
+			p++;
+		}
+		if (*p != 'u') return FALSE;
+		conversions++;
+	}
+	return conversions == 1 && wcslen(pattern) < MAX_FRAME_PATH - 16;
+}
+
+static BOOL RenderRun(PBATCH_WORKER worker) {
+	const BATCH_JOB *job = worker->job;
+	UINT nClocks = GetClockCount(job->settings);
+	SIZE_T frameSize = 3 * (SIZE_T)job->width * job->height;
+
+	for (UINT i = 0; i < worker->count; i++) {
+		UINT frame = worker->first + i;
+		if (!RenderClockToSurface(&worker->renderer, job->width, job->height, job->settings,
+			worker->times + (SIZE_T)i * nClocks)) {
+			return FALSE;
+		}
+
+		const SURFACE *surface = &worker->renderer.surface;
+		if (job->settings->driftRange) {
+			LONGLONG utc = job->startUtc + (LONGLONG)frame * job->stepMs;
+			if (!PresentSwRenderer(&worker->renderer, &worker->drifted, job->settings, utc)) {
+				return FALSE;
+			}
+			surface = &worker->drifted;
+		}
+
+		if (job->output == BATCH_OUTPUT_RAW) {
+			CopySurfaceRgb(surface, worker->raw + i * frameSize);
+			continue;
+		}
+
+		WCHAR path[MAX_FRAME_PATH];
+		swprintf(path, MAX_FRAME_PATH, job->imagePattern, frame);
+		if (!WriteImageFile(path, surface, job->imageFormat)) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static DWORD WINAPI WorkerProc(PVOID param) {
+	PBATCH_WORKER worker = param;
+	if (!RenderRun(worker)) {
+		worker->failed = TRUE;
+		worker->error = GetLastError();
+	}
+	return 0;
+}
+
+BOOL RenderFrameBatch(const BATCH_JOB *job, PGLYPH_CACHE_STATS glyphStats) {
+	if (job->width <= 0 || job->height <= 0 || job->stepMs < 0 ||
+		(job->output == BATCH_OUTPUT_IMAGES && !IsValidFramePattern(job->imagePattern)) ||
+		(job->output == BATCH_OUTPUT_RAW && !job->writeRaw)) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+
+	UINT nClocks = GetClockCount(job->settings);
+	SIZE_T frameSize = 3 * (SIZE_T)job->width * job->height;
+
+	// Large raw frames make runs shorter, so that a round of them fits into
+	// the buffer. Then never start more workers than there are runs.
+	UINT nThreads = max(1, job->nThreads ? job->nThreads : GetPlatformProcessorCount());
+	UINT framesPerRun = FRAMES_PER_RUN;
+	if (job->output == BATCH_OUTPUT_RAW) {
+		framesPerRun = (UINT)max(1, min(FRAMES_PER_RUN, MAX_ROUND_BUFFER / nThreads / frameSize));
+	}
+	nThreads = max(1, min(nThreads, (job->nFrames + framesPerRun - 1) / framesPerRun));
+	UINT framesPerRound = framesPerRun * nThreads;
+
+	// Per round: the times of all clocks in every frame, and raw frames
+	PCLOCK_TIME times = malloc((SIZE_T)framesPerRound * nClocks * sizeof(CLOCK_TIME));
+	PBYTE raw = job->output == BATCH_OUTPUT_RAW ? malloc(framesPerRound * frameSize) : NULL;
+	PBATCH_WORKER workers = calloc(nThreads, sizeof(BATCH_WORKER));
+	if (!times || !workers || (job->output == BATCH_OUTPUT_RAW && !raw)) {
+		free(times);
+		free(raw);
+		free(workers);
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return FALSE;
+	}
+
+	// Workers share what the memory budget leaves for glyphs
+	SIZE_T glyphCacheSize = job->glyphCacheSize;
+	if (!glyphCacheSize) {
+		SIZE_T budget = (SIZE_T)job->settings->memoryBudget * 1024 * 1024;
+		glyphCacheSize = budget ? max(MIN_GLYPH_CACHE_SIZE, ChooseGlyphCacheSize(budget) / nThreads) :
+			DEFAULT_GLYPH_CACHE_SIZE;
+	}
+
+	// Each worker keeps its renderer and glyphs for all rounds
+	for (UINT t = 0; t < nThreads; t++) {
+		workers[t].job = job;
+		InitGlyphCache(&workers[t].glyphCache, glyphCacheSize);
+		InitSwRenderer(&workers[t].renderer, job->font, &workers[t].glyphCache);
+	}
+
+	// Resolving zones is not thread-safe on every platform, so all times are
+	// converted here. With cached offsets, this is cheap compared to rendering.
+	LOCAL_TIME_CACHE caches[MAX_CLOCKS];
+	for (UINT c = 0; c < nClocks; c++) {
+		CLOCK_ZONE zone;
+		ResolveClockZone(job->settings->nClocks ? job->settings->clocks[c].zone : NULL, &zone);
+		InitLocalTimeCache(&caches[c], &zone);
+	}
+
+	BOOL ok = TRUE;
+	for (UINT roundStart = 0; ok && roundStart < job->nFrames; roundStart += framesPerRound) {
+		UINT roundFrames = min(framesPerRound, job->nFrames - roundStart);
+
+		for (UINT i = 0; i < roundFrames; i++) {
+			LONGLONG utc = job->startUtc + (LONGLONG)(roundStart + i) * job->stepMs;
+			for (UINT c = 0; c < nClocks; c++) {
+				SplitClockTime(UtcToCachedLocalTimeMs(&caches[c], utc), &times[(SIZE_T)i * nClocks + c]);
+			}
+		}
+
+		// Hand out contiguous runs and render them in parallel. The last
+		// worker renders on this thread.
+		for (UINT t = 0; t < nThreads; t++) {
+			PBATCH_WORKER worker = &workers[t];
+			UINT offset = min(t * framesPerRun, roundFrames);
+			worker->first = roundStart + offset;
+			worker->count = min(framesPerRun, roundFrames - offset);
+			worker->times = times + (SIZE_T)offset * nClocks;
+			worker->raw = raw ? raw + offset * frameSize : NULL;
+			worker->started = FALSE;
+			if (worker->count == 0) continue;
+
+			worker->started = t + 1 < nThreads && StartPlatformThread(&worker->thread, WorkerProc, worker);
+			if (!worker->started) {
+				WorkerProc(worker);
+			}
+		}
+
+		for (UINT t = 0; t < nThreads; t++) {
+			if (workers[t].started) {
+				JoinPlatformThread(&workers[t].thread);
+			}
+		}
+
+		for (UINT t = 0; t < nThreads; t++) {
+			if (workers[t].failed) {
+				SetLastError(workers[t].error);
+				ok = FALSE;
+				break;
+			}
+		}
+
+		// Raw frames are written in order once the whole round is done
+		if (ok && raw && !job->writeRaw(job->writeContext, raw, roundFrames * frameSize)) {
+			ok = FALSE;
+		}
+	}
+
+	if (glyphStats) {
+		ZeroMemory(glyphStats, sizeof(GLYPH_CACHE_STATS));
+	}
+
+	for (UINT t = 0; t < nThreads; t++) {
+		if (glyphStats) {
+			GLYPH_CACHE_STATS stats;
+			GetGlyphCacheStats(&workers[t].glyphCache, &stats);
+			glyphStats->hits += stats.hits;
+			glyphStats->misses += stats.misses;
+			glyphStats->evictions += stats.evictions;
+			glyphStats->entries += stats.entries;
+			glyphStats->bytesInUse += stats.bytesInUse;
+			glyphStats->bytesReserved += stats.bytesReserved;
+		}
+
+		FreeSurface(&workers[t].drifted);
+		FreeSwRenderer(&workers[t].renderer);
+		FreeGlyphCache(&workers[t].glyphCache);
+	}
+	free(workers);
+	free(raw);
+	free(times);
+
+	return ok;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "platform.h"
+#include "glyphcache.h"
+#include "imagefile.h"
+#include "settings.h"
+#include "ttfont.h"
+
+typedef enum {
+	// One image file per frame
+	BATCH_OUTPUT_IMAGES,
+	// Packed 8-bit RGB frames, one after another, e.g. for a video encoder
+	BATCH_OUTPUT_RAW
+} BATCH_OUTPUT;
+
+// Receives raw frames in order. Returns FALSE to stop rendering.
+typedef BOOL (*BATCH_WRITE_PROC)(PVOID context, const BYTE *data, SIZE_T size);
+
+typedef struct {
+	const TTFONT *font;
+	PSETTINGS settings;
+	int width;
+	int height;
+
+	// Frame i shows the UTC time startUtc + i * stepMs
+	LONGLONG startUtc;
+	LONGLONG stepMs;
+	UINT nFrames;
+
+	// Number of worker threads, or 0 for one per processor
+	UINT nThreads;
+
+	// Size of the glyph cache of each worker, or 0 to choose one that fits
+	// into the memory budget of the settings
+	SIZE_T glyphCacheSize;
+
+	BATCH_OUTPUT output;
+	// For BATCH_OUTPUT_IMAGES, a file name containing a single "%u" (which
+	// may have a width and leading zeros, e.g. "%05u") for the frame index
+	PCWSTR imagePattern;
+	IMAGE_FORMAT imageFormat;
+	// For BATCH_OUTPUT_RAW
+	BATCH_WRITE_PROC writeRaw;
+	PVOID writeContext;
+} BATCH_JOB, *PBATCH_JOB;
+
+// Checks that pattern contains exactly one frame index conversion.
+BOOL IsValidFramePattern(PCWSTR pattern);
+
+// Renders all frames of a job. Frames are split into contiguous runs, one
+// per worker, so that each worker only redraws changed digits and reuses its
+// glyphs. Time zones are converted on the calling thread. If glyphStats is
+// not NULL, it receives the combined glyph cache statistics of all workers.
+BOOL RenderFrameBatch(const BATCH_JOB *job, PGLYPH_CACHE_STATS glyphStats);
@@ -0,0 +1,135 @@
+#include "clocklayout.h"
+
+void ComputeClockLayout(PCLOCK_LAYOUT layout, const RECT *rc, UINT nUnits, UINT scale, UINT space) {
+	int width = rc->right - rc->left;
+
+	if (nUnits > MAX_CLOCK_UNITS) nUnits = MAX_CLOCK_UNITS;
+
+	int availableWidth = width * scale / 100;
+	layout->nUnits = nUnits;
+	layout->widthPerUnit = availableWidth / nUnits;
+	layout->textWidthPerUnit = layout->widthPerUnit * (100 - space) / 100;
+
+	LONG marginX = width * (100 - scale) / 2 / 100;
+	LONG offsetX = rc->left + marginX;
+
+	for (UINT i = 0; i < nUnits; i++) {
+		layout->units[i].left = offsetX + layout->widthPerUnit * i;
+		layout->units[i].right = offsetX + layout->widthPerUnit * (i + 1);
+		layout->units[i].top = rc->top;
+		layout->units[i].bottom = rc->bottom;
+	}
+}
+
+int ComputeClockFontHeight(const CLOCK_LAYOUT *layout, int maxHeight, int measuredHeight, int measuredWidth) {
+	if (layout->textWidthPerUnit <= 0 || measuredHeight <= 0) return 0;
+
+	// Width of "00" at maxHeight, assuming that it grows linearly with the height
+	float width = (float)measuredWidth * maxHeight / measuredHeight;
+
+	float f = max(width / layout->textWidthPerUnit, 1);
+	return (int)(maxHeight / f);
+}
+
+// Lays out a single tile of the given size and returns its font height.
+static int LayoutTile(PCLOCK_GRID grid, int tileWidth, int tileHeight, BOOL labels, UINT nUnits,
+	UINT scale, UINT space, int measuredHeight, int measuredWidth) {
+	grid->tileWidth = tileWidth;
+	grid->tileHeight = tileHeight;
+	grid->labelHeight = labels ? tileHeight / 5 : 0;
+
+	RECT digitsRect = {
+		.left = grid->rect.left,
+		.top = grid->rect.top,
+		.right = grid->rect.left + tileWidth,
+		.bottom = grid->rect.top + tileHeight - grid->labelHeight
+	};
+	ComputeClockLayout(&grid->digits, &digitsRect, nUnits, scale, space);
+
+	grid->fontHeight = ComputeClockFontHeight(&grid->digits, digitsRect.bottom - digitsRect.top,
+		measuredHeight, measuredWidth);
+	return grid->fontHeight;
+}
+
+void ComputeClockGrid(PCLOCK_GRID grid, const RECT *rc, UINT nClocks, BOOL labels, UINT nUnits,
+	UINT scale, UINT space, int measuredHeight, int measuredWidth) {
+	int width = rc->right - rc->left;
+	int height = rc->bottom - rc->top;
+
+	if (nClocks == 0) nClocks = 1;
+
+	grid->rect = *rc;
+	grid->nClocks = nClocks;
+
+	// Try all numbers of columns and keep the one with the largest digits,
+	// preferring more columns (i.e., clocks side by side) in case of a tie
+	UINT bestColumns = 1;
+	int bestHeight = -1;
+	for (UINT columns = 1; columns <= nClocks; columns++) {
+		UINT rows = (nClocks + columns - 1) / columns;
+		int fontHeight = LayoutTile(grid, width / columns, height / rows, labels, nUnits,
+			scale, space, measuredHeight, measuredWidth);
+		if (fontHeight >= bestHeight) {
+			bestHeight = fontHeight;
+			bestColumns = columns;
+		}
+	}
+
+	grid->columns = bestColumns;
+	grid->rows = (nClocks + bestColumns - 1) / bestColumns;
+	LayoutTile(grid, width / grid->columns, height / grid->rows, labels, nUnits,
+		scale, space, measuredHeight, measuredWidth);
+}
+
+void GetClockTileOffset(const CLOCK_GRID *grid, UINT index, PPOINT offset) {
+	UINT row = index / grid->columns;
+	UINT column = index % grid->columns;
+
+	offset->x = column * grid->tileWidth;
+	offset->y = row * grid->tileHeight;
+
+	// Center an incomplete last row
+	UINT inRow = min(grid->columns, grid->nClocks - row * grid->columns);
+	offset->x += (grid->columns - inRow) * grid->tileWidth / 2;
+}
+
+void GetClockLabelRect(const CLOCK_GRID *grid, UINT index, PRECT rect) {
+	POINT offset;
+	GetClockTileOffset(grid, index, &offset);
+
+	rect->left = grid->rect.left + offset.x;
+	rect->right = rect->left + grid->tileWidth;
+	rect->bottom = grid->rect.top + offset.y + grid->tileHeight;
+	rect->top = rect->bottom - grid->labelHeight;
+}
+
+UINT GetDriftLayoutRect(const RECT *rc, UINT range, PRECT rect) {
+	// Keep at least half of the width and height for the clock face
+	range = min(range, (UINT)min(rc->right - rc->left, rc->bottom - rc->top) / 4);
+
+	rect->left = rc->left + range;
+	rect->top = rc->top + range;
+	rect->right = rc->right - range;
+	rect->bottom = rc->bottom - range;
+	return range;
+}
+
+// Goes from -range to range and back once per period, in steps of one
+static LONG TriangleWave(LONGLONG time, LONGLONG period, LONG range) {
+	LONGLONG phase = time % period;
+	if (phase < 0) phase += period;
+
+	LONG step = (LONG)(phase * 4 * range / period);
+	return step < 2 * range ? step - range : 3 * range - step;
+}
+
+void GetDriftOffset(UINT range, UINT periodSeconds, LONGLONG timeMs, PPOINT offset) {
+	offset->x = offset->y = 0;
+	if (range == 0 || periodSeconds == 0) return;
+
+	// Periods in the ratio 5:7 trace a Lissajous figure that only repeats
+	// after 35 horizontal periods
+	LONGLONG period = periodSeconds * 1000LL;
+	offset->x = TriangleWave(timeMs, period, range);
+	offset->y = TriangleWave(timeMs, period * 7 / 5, range);
+}
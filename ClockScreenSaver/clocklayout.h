@@ -0,0 +1,59 @@
+#pragma once
+
+#include "platform.h"
+
+#define MAX_CLOCK_UNITS 3
+
+typedef struct {
+	UINT nUnits;
+	int widthPerUnit;
+	int textWidthPerUnit;
+	RECT units[MAX_CLOCK_UNITS];
+} CLOCK_LAYOUT, *PCLOCK_LAYOUT;
+
+// Arrangement of several equally sized clocks in a grid. Each tile holds the
+// digits and, if there are labels, a label band below them.
+typedef struct {
+	RECT rect;
+	UINT nClocks;
+	UINT columns;
+	UINT rows;
+	int tileWidth;
+	int tileHeight;
+	int labelHeight;
+	int fontHeight;
+	// Layout of the digits in the tile at the top left corner
+	CLOCK_LAYOUT digits;
+} CLOCK_GRID, *PCLOCK_GRID;
+
+// Splits rc into nUnits equally sized unit rects, leaving scale percent of the
+// width for the units and space percent of each unit between digit pairs.
+void ComputeClockLayout(PCLOCK_LAYOUT layout, const RECT *rc, UINT nUnits, UINT scale, UINT space);
+
+// Given that the text "00" is measuredWidth wide at measuredHeight, returns the
+// largest font height not exceeding maxHeight at which it fits into
+// layout->textWidthPerUnit.
+int ComputeClockFontHeight(const CLOCK_LAYOUT *layout, int maxHeight, int measuredHeight, int measuredWidth);
+
+// Tiles nClocks clocks in rc, choosing the number of columns that results in
+// the largest digits. measuredHeight and measuredWidth are as above.
+void ComputeClockGrid(PCLOCK_GRID grid, const RECT *rc, UINT nClocks, BOOL labels, UINT nUnits,
+	UINT scale, UINT space, int measuredHeight, int measuredWidth);
+
+// Returns how far the tile at index is from the tile at the top left corner.
+void GetClockTileOffset(const CLOCK_GRID *grid, UINT index, PPOINT offset);
+
+// Returns the label band of the tile at index.
+void GetClockLabelRect(const CLOCK_GRID *grid, UINT index, PRECT rect);
+
+// Burn-in protection moves the whole clock face by up to range pixels in each
+// direction. The face is laid out in rect, which is rc shrunk on every side by
+// the range, or by less if rc is too small. Returns the range to pass to
+// GetDriftOffset.
+UINT GetDriftLayoutRect(const RECT *rc, UINT range, PRECT rect);
+
+// Returns the offset of the clock face at a time in milliseconds. The face
+// moves by one pixel at a time, crossing the box horizontally twice per
+// period and vertically at a slower rate, so that it covers the whole box
+// over time. The offset only depends on the arguments.
+void GetDriftOffset(UINT range, UINT periodSeconds, LONGLONG timeMs, PPOINT offset);
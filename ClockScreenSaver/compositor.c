@@ -0,0 +1,520 @@
+#include "compositor.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COMPOSITOR_SSE2
+#include <emmintrin.h>
+#endif
+
+// Converts a rect in layer coordinates into target coordinates
+static void LayerToTarget(const LAYER *layer, const RECT *rect, PRECT out) {
+	*out = *rect;
+	OffsetRect(out, layer->rect.left, layer->rect.top);
+}
+
+void InitCompositor(PCOMPOSITOR compositor) {
+	ZeroMemory(compositor, sizeof(COMPOSITOR));
+	compositor->fgColor = RGB(255, 255, 255);
+	compositor->bgColor = RGB(0, 0, 0);
+}
+
+void FreeCompositor(PCOMPOSITOR compositor) {
+	RemoveAllLayers(compositor);
+	free(compositor->layers);
+	free(compositor->dirtyTiles);
+	ZeroMemory(compositor, sizeof(COMPOSITOR));
+}
+
+// Sets the format and target, and makes room for a flag per tile
+static BOOL SetTarget(PCOMPOSITOR compositor, COMPOSITOR_FORMAT format, PSURFACE target,
+	PCOVERAGE_SURFACE backBuffer) {
+	UINT tilesX = (target->width + COMPOSITOR_TILE_SIZE - 1) / COMPOSITOR_TILE_SIZE;
+	UINT tilesY = (target->height + COMPOSITOR_TILE_SIZE - 1) / COMPOSITOR_TILE_SIZE;
+
+	if (tilesX * tilesY != compositor->tilesX * compositor->tilesY) {
+		PBYTE dirtyTiles = malloc((SIZE_T)tilesX * tilesY);
+		if (!dirtyTiles && tilesX * tilesY != 0) {
+			SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+			return FALSE;
+		}
+		free(compositor->dirtyTiles);
+		compositor->dirtyTiles = dirtyTiles;
+	}
+
+	// Layers only have pixels of one format
+	if (compositor->format != format) {
+		RemoveAllLayers(compositor);
+		compositor->format = format;
+	}
+
+	compositor->target = target;
+	compositor->backBuffer = backBuffer;
+	compositor->tilesX = tilesX;
+	compositor->tilesY = tilesY;
+	InvalidateCompositor(compositor, NULL);
+	return TRUE;
+}
+
+BOOL SetCompositorTarget(PCOMPOSITOR compositor, PSURFACE target) {
+	return SetTarget(compositor, COMPOSITOR_COLOR, target, NULL);
+}
+
+BOOL SetCompositorCoverageTarget(PCOMPOSITOR compositor, PSURFACE target, PCOVERAGE_SURFACE backBuffer) {
+	if (backBuffer->width != target->width || backBuffer->height != target->height) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+	return SetTarget(compositor, COMPOSITOR_COVERAGE, target, backBuffer);
+}
+
+void SetCompositorBackground(PCOMPOSITOR compositor, COLORREF color) {
+	if (compositor->bgColor != color) {
+		compositor->bgColor = color;
+		InvalidateCompositor(compositor, NULL);
+	}
+}
+
+void SetCompositorForeground(PCOMPOSITOR compositor, COLORREF color) {
+	if (compositor->fgColor != color) {
+		compositor->fgColor = color;
+		if (compositor->format == COMPOSITOR_COVERAGE) {
+			InvalidateCompositor(compositor, NULL);
+		}
+	}
+}
+
+void RemoveAllLayers(PCOMPOSITOR compositor) {
+	for (UINT i = 0; i < compositor->nLayers; i++) {
+		RECT rect;
+		LayerToTarget(&compositor->layers[i], &compositor->layers[i].bounds, &rect);
+		InvalidateCompositor(compositor, &rect);
+		FreeSurface(&compositor->layers[i].surface);
+		FreeCoverageSurface(&compositor->layers[i].coverage);
+	}
+	compositor->nLayers = 0;
+}
+
+BOOL AddLayer(PCOMPOSITOR compositor, const RECT *rect, PUINT index) {
+	if (compositor->nLayers == compositor->capacity) {
+		UINT newCapacity = compositor->capacity ? compositor->capacity * 2 : 16;
+		PLAYER newLayers = realloc(compositor->layers, newCapacity * sizeof(LAYER));
+		if (!newLayers) {
+			SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+			return FALSE;
+		}
+		compositor->layers = newLayers;
+		compositor->capacity = newCapacity;
+	}
+
+	PLAYER layer = &compositor->layers[compositor->nLayers];
+	ZeroMemory(layer, sizeof(LAYER));
+	layer->rect = *rect;
+	layer->opacity = 255;
+
+	// Empty layers have no pixels and are never drawn into
+	int width = rect->right - rect->left, height = rect->bottom - rect->top;
+	if (width > 0 && height > 0) {
+		BOOL created = compositor->format == COMPOSITOR_COVERAGE ?
+			CreateCoverageSurface(&layer->coverage, width, height) : CreateSurface(&layer->surface, width, height);
+		if (!created) return FALSE;
+	}
+
+	*index = compositor->nLayers++;
+	return TRUE;
+}
+
+void ClearLayer(PCOMPOSITOR compositor, UINT index) {
+	PLAYER layer = &compositor->layers[index];
+	RECT *bounds = &layer->bounds;
+	if (IsRectEmpty(bounds)) return;
+
+	// Only what was drawn needs to be cleared and composed again
+	for (LONG y = bounds->top; y < bounds->bottom; y++) {
+		if (compositor->format == COMPOSITOR_COVERAGE) {
+			ZeroMemory(layer->coverage.coverage + (SIZE_T)y * layer->coverage.stride + bounds->left,
+				bounds->right - bounds->left);
+		}
+		else {
+			ZeroMemory(layer->surface.pixels + (SIZE_T)y * layer->surface.stride + bounds->left,
+				(bounds->right - bounds->left) * sizeof(DWORD));
+		}
+	}
+
+	RECT rect;
+	LayerToTarget(layer, bounds, &rect);
+	InvalidateCompositor(compositor, &rect);
+	SetRectEmpty(bounds);
+}
+
+// Divides a product of two 8-bit values by 255, rounded to nearest
+static DWORD MulDiv255(DWORD v) {
+	v += 128;
+	return (v + (v >> 8)) >> 8;
+}
+
+// Draws the part r of a mask at (x, y) into a layer of premultiplied colors
+static void DrawColorMask(PLAYER layer, const RECT *r, int x, int y, const BYTE *mask, SIZE_T stride,
+	COLORREF color) {
+	PSURFACE surface = &layer->surface;
+
+	// The premultiplied color for every coverage value
+	DWORD premultiplied[256];
+	DWORD red = GetRValue(color), green = GetGValue(color), blue = GetBValue(color);
+	for (DWORD alpha = 0; alpha < 256; alpha++) {
+		premultiplied[alpha] = (alpha << 24) | (MulDiv255(red * alpha) << 16) | (MulDiv255(green * alpha) << 8) |
+			MulDiv255(blue * alpha);
+	}
+
+	for (LONG py = r->top; py < r->bottom; py++) {
+		PDWORD row = surface->pixels + (SIZE_T)py * surface->stride;
+		const BYTE *src = mask + (SIZE_T)(py - y) * stride;
+		for (LONG px = r->left; px < r->right; px++) {
+			DWORD alpha = src[px - x], d = row[px];
+			if (alpha == 0) continue;
+
+			// Premultiplied color over what the layer already holds, which is
+			// usually nothing
+			DWORD s = premultiplied[alpha];
+			if (d != 0) {
+				DWORD inverse = 255 - alpha;
+				s += (MulDiv255((d >> 24) * inverse) << 24) | (MulDiv255(((d >> 16) & 0xFF) * inverse) << 16) |
+					(MulDiv255(((d >> 8) & 0xFF) * inverse) << 8) | MulDiv255((d & 0xFF) * inverse);
+			}
+			row[px] = s;
+		}
+	}
+}
+
+// The same for a layer of coverage values
+static void DrawCoverageMask(PLAYER layer, const RECT *r, int x, int y, const BYTE *mask, SIZE_T stride) {
+	PCOVERAGE_SURFACE surface = &layer->coverage;
+
+	for (LONG py = r->top; py < r->bottom; py++) {
+		PBYTE row = surface->coverage + (SIZE_T)py * surface->stride;
+		const BYTE *src = mask + (SIZE_T)(py - y) * stride;
+		for (LONG px = r->left; px < r->right; px++) {
+			DWORD alpha = src[px - x], d = row[px];
+			if (alpha == 0) continue;
+			row[px] = (BYTE)(d ? alpha + MulDiv255(d * (255 - alpha)) : alpha);
+		}
+	}
+}
+
+void DrawLayerMask(PCOMPOSITOR compositor, UINT index, int x, int y, const BYTE *mask, int width, int height,
+	SIZE_T stride, COLORREF color) {
+	PLAYER layer = &compositor->layers[index];
+	LONG layerWidth = layer->rect.right - layer->rect.left, layerHeight = layer->rect.bottom - layer->rect.top;
+
+	RECT r = { max(x, 0), max(y, 0), min(x + width, layerWidth), min(y + height, layerHeight) };
+	if (r.left >= r.right || r.top >= r.bottom) return;
+
+	if (compositor->format == COMPOSITOR_COVERAGE) {
+		DrawCoverageMask(layer, &r, x, y, mask, stride);
+	}
+	else {
+		DrawColorMask(layer, &r, x, y, mask, stride, color);
+	}
+
+	UnionRect(&layer->bounds, &layer->bounds, &r);
+
+	LayerToTarget(layer, &r, &r);
+	InvalidateCompositor(compositor, &r);
+}
+
+void SetLayerOpacity(PCOMPOSITOR compositor, UINT index, BYTE opacity) {
+	PLAYER layer = &compositor->layers[index];
+	if (layer->opacity != opacity) {
+		layer->opacity = opacity;
+		RECT rect;
+		LayerToTarget(layer, &layer->bounds, &rect);
+		InvalidateCompositor(compositor, &rect);
+	}
+}
+
+void InvalidateCompositor(PCOMPOSITOR compositor, const RECT *rect) {
+	if (!compositor->target) return;
+
+	if (!rect) {
+		memset(compositor->dirtyTiles, 1, (SIZE_T)compositor->tilesX * compositor->tilesY);
+		return;
+	}
+
+	LONG left = max(rect->left, 0), top = max(rect->top, 0);
+	LONG right = min(rect->right, compositor->target->width), bottom = min(rect->bottom, compositor->target->height);
+	if (left >= right || top >= bottom) return;
+
+	LONG firstX = left / COMPOSITOR_TILE_SIZE, lastX = (right - 1) / COMPOSITOR_TILE_SIZE;
+	for (LONG ty = top / COMPOSITOR_TILE_SIZE; ty <= (bottom - 1) / COMPOSITOR_TILE_SIZE; ty++) {
+		memset(compositor->dirtyTiles + (SIZE_T)ty * compositor->tilesX + firstX, 1, lastX - firstX + 1);
+	}
+}
+
+static DWORD BlendPremultipliedPixel(DWORD d, DWORD s, DWORD opacity) {
+	if (opacity != 255) {
+		s = (MulDiv255((s >> 24) * opacity) << 24) | (MulDiv255(((s >> 16) & 0xFF) * opacity) << 16) |
+			(MulDiv255(((s >> 8) & 0xFF) * opacity) << 8) | MulDiv255((s & 0xFF) * opacity);
+	}
+
+	DWORD inverse = 255 - (s >> 24);
+	return ((((s >> 16) & 0xFF) + MulDiv255(((d >> 16) & 0xFF) * inverse)) << 16) |
+		((((s >> 8) & 0xFF) + MulDiv255(((d >> 8) & 0xFF) * inverse)) << 8) |
+		((s & 0xFF) + MulDiv255((d & 0xFF) * inverse));
+}
+
+#ifdef COMPOSITOR_SSE2
+// Same as MulDiv255 on eight 16-bit products
+static inline __m128i MulDiv255x8(__m128i v) {
+	v = _mm_add_epi16(v, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+}
+
+// Spreads the alpha of two unpacked pixels over their four channels
+static inline __m128i SpreadAlpha(__m128i v) {
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// Blends two unpacked source pixels over two unpacked destination pixels
+static inline __m128i BlendPremultiplied2(__m128i d, __m128i s, __m128i opacity) {
+	s = MulDiv255x8(_mm_mullo_epi16(s, opacity));
+	__m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), SpreadAlpha(s));
+	return _mm_add_epi16(s, MulDiv255x8(_mm_mullo_epi16(d, inverse)));
+}
+
+// Blends eight unpacked coverage values over eight others
+static inline __m128i BlendCoverage8(__m128i d, __m128i s, __m128i opacity) {
+	s = MulDiv255x8(_mm_mullo_epi16(s, opacity));
+	__m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), s);
+	return _mm_add_epi16(s, MulDiv255x8(_mm_mullo_epi16(d, inverse)));
+}
+
+// Mixes one channel of fg and bg for eight unpacked coverage values
+static inline __m128i ExpandChannel8(__m128i coverage, __m128i inverse, int fg, int bg) {
+	return _mm_add_epi16(MulDiv255x8(_mm_mullo_epi16(coverage, _mm_set1_epi16((short)fg))),
+		MulDiv255x8(_mm_mullo_epi16(inverse, _mm_set1_epi16((short)bg))));
+}
+
+// Expands eight unpacked coverage values into 0x00RRGGBB pixels
+static inline void ExpandCoverage8(PDWORD dst, __m128i coverage, COLORREF fg, COLORREF bg) {
+	__m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), coverage);
+	__m128i red = ExpandChannel8(coverage, inverse, GetRValue(fg), GetRValue(bg));
+	__m128i green = ExpandChannel8(coverage, inverse, GetGValue(fg), GetGValue(bg));
+	__m128i blue = ExpandChannel8(coverage, inverse, GetBValue(fg), GetBValue(bg));
+
+	// 0xGGBB in the low and 0x00RR in the high half of every pixel
+	__m128i greenBlue = _mm_or_si128(_mm_slli_epi16(green, 8), blue);
+	_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(greenBlue, red));
+	_mm_storeu_si128((__m128i *)(dst + 4), _mm_unpackhi_epi16(greenBlue, red));
+}
+#endif
+
+void BlendPremultipliedRow(PDWORD dst, const DWORD *src, SIZE_T count, BYTE opacity) {
+	SIZE_T i = 0;
+
+#ifdef COMPOSITOR_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphaMask = _mm_set1_epi32((int)0xFF000000);
+	const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i opacity16 = _mm_set1_epi16(opacity);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+
+		// Skip transparent runs, which are most of a glyph layer, and copy
+		// opaque ones
+		int transparent = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaMask), zero));
+		if (transparent == 0xFFFF) continue;
+		if (opacity == 255 && _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaMask), alphaMask)) == 0xFFFF) {
+			_mm_storeu_si128((__m128i *)(dst + i), _mm_and_si128(s, colorMask));
+			continue;
+		}
+
+		__m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+		__m128i lo = BlendPremultiplied2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), opacity16);
+		__m128i hi = BlendPremultiplied2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), opacity16);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_and_si128(_mm_packus_epi16(lo, hi), colorMask));
+	}
+#endif
+
+	for (; i < count; i++) {
+		DWORD s = src[i];
+		if ((s >> 24) == 0) continue;
+		dst[i] = opacity == 255 && (s >> 24) == 255 ? s & 0x00FFFFFF : BlendPremultipliedPixel(dst[i], s, opacity);
+	}
+}
+
+void BlendCoverageRow(PBYTE dst, const BYTE *src, SIZE_T count, BYTE opacity) {
+	SIZE_T i = 0;
+
+#ifdef COMPOSITOR_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i opaque = _mm_set1_epi8((char)0xFF);
+	const __m128i opacity16 = _mm_set1_epi16(opacity);
+
+	for (; i + 16 <= count; i += 16) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(s, zero)) == 0xFFFF) continue;
+		if (opacity == 255 && _mm_movemask_epi8(_mm_cmpeq_epi8(s, opaque)) == 0xFFFF) {
+			_mm_storeu_si128((__m128i *)(dst + i), s);
+			continue;
+		}
+
+		__m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+		__m128i lo = BlendCoverage8(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), opacity16);
+		__m128i hi = BlendCoverage8(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), opacity16);
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+#endif
+
+	for (; i < count; i++) {
+		DWORD s = src[i];
+		if (s == 0) continue;
+		if (opacity != 255) {
+			s = MulDiv255(s * opacity);
+		}
+		dst[i] = (BYTE)(s + MulDiv255(dst[i] * (255 - s)));
+	}
+}
+
+// The colors between bg and fg form a palette of 256 entries. They are
+// computed rather than looked up, so that SSE2 can expand 16 pixels at once.
+void ExpandCoverageRow(PDWORD dst, const BYTE *src, SIZE_T count, COLORREF fg, COLORREF bg) {
+	DWORD fgPixel = ColorToPixel(fg), bgPixel = ColorToPixel(bg);
+	SIZE_T i = 0;
+
+#ifdef COMPOSITOR_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i opaque = _mm_set1_epi8((char)0xFF);
+
+	for (; i + 16 <= count; i += 16) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(src + i));
+
+		// Runs of background and solid foreground are most of the pixels
+		int uniform = _mm_movemask_epi8(_mm_cmpeq_epi8(c, zero)) == 0xFFFF ? 1 :
+			_mm_movemask_epi8(_mm_cmpeq_epi8(c, opaque)) == 0xFFFF ? 2 : 0;
+		if (uniform) {
+			__m128i pixels = _mm_set1_epi32((int)(uniform == 1 ? bgPixel : fgPixel));
+			for (SIZE_T j = 0; j < 16; j += 4) {
+				_mm_storeu_si128((__m128i *)(dst + i + j), pixels);
+			}
+			continue;
+		}
+
+		ExpandCoverage8(dst + i, _mm_unpacklo_epi8(c, zero), fg, bg);
+		ExpandCoverage8(dst + i + 8, _mm_unpackhi_epi8(c, zero), fg, bg);
+	}
+#endif
+
+	for (; i < count; i++) {
+		DWORD c = src[i], inverse = 255 - c;
+		dst[i] = c == 0 ? bgPixel : c == 255 ? fgPixel :
+			((MulDiv255(GetRValue(fg) * c) + MulDiv255(GetRValue(bg) * inverse)) << 16) |
+			((MulDiv255(GetGValue(fg) * c) + MulDiv255(GetGValue(bg) * inverse)) << 8) |
+			(MulDiv255(GetBValue(fg) * c) + MulDiv255(GetBValue(bg) * inverse));
+	}
+}
+
+// Composes the coverage of a tile into the back buffer
+static void ComposeCoverageTile(PCOMPOSITOR compositor, const RECT *tile) {
+	PCOVERAGE_SURFACE backBuffer = compositor->backBuffer;
+	LONG width = tile->right - tile->left;
+	for (LONG y = tile->top; y < tile->bottom; y++) {
+		ZeroMemory(backBuffer->coverage + (SIZE_T)y * backBuffer->stride + tile->left, width);
+	}
+
+	for (UINT i = 0; i < compositor->nLayers; i++) {
+		const LAYER *layer = &compositor->layers[i];
+		if (layer->opacity == 0) continue;
+
+		RECT bounds, r;
+		LayerToTarget(layer, &layer->bounds, &bounds);
+		if (!IntersectRect(&r, tile, &bounds)) continue;
+
+		for (LONG y = r.top; y < r.bottom; y++) {
+			PBYTE dst = backBuffer->coverage + (SIZE_T)y * backBuffer->stride + r.left;
+			const BYTE *src = layer->coverage.coverage + (SIZE_T)(y - layer->rect.top) * layer->coverage.stride +
+				(r.left - layer->rect.left);
+			BlendCoverageRow(dst, src, r.right - r.left, layer->opacity);
+		}
+	}
+}
+
+// Expands a part of the back buffer into the target
+static void ExpandBackBuffer(PCOMPOSITOR compositor, const RECT *rect) {
+	PCOVERAGE_SURFACE backBuffer = compositor->backBuffer;
+	PSURFACE target = compositor->target;
+	for (LONG y = rect->top; y < rect->bottom; y++) {
+		ExpandCoverageRow(target->pixels + (SIZE_T)y * target->stride + rect->left,
+			backBuffer->coverage + (SIZE_T)y * backBuffer->stride + rect->left, rect->right - rect->left,
+			compositor->fgColor, compositor->bgColor);
+	}
+}
+
+// Composes a single tile, clipped to the target
+static void ComposeTile(PCOMPOSITOR compositor, const RECT *tile) {
+	if (compositor->format == COMPOSITOR_COVERAGE) {
+		ComposeCoverageTile(compositor, tile);
+		return;
+	}
+
+	PSURFACE target = compositor->target;
+	FillSurfaceRect(target, tile, compositor->bgColor);
+
+	for (UINT i = 0; i < compositor->nLayers; i++) {
+		const LAYER *layer = &compositor->layers[i];
+		if (layer->opacity == 0) continue;
+
+		RECT bounds, r;
+		LayerToTarget(layer, &layer->bounds, &bounds);
+		if (!IntersectRect(&r, tile, &bounds)) continue;
+
+		for (LONG y = r.top; y < r.bottom; y++) {
+			PDWORD dst = target->pixels + (SIZE_T)y * target->stride + r.left;
+			const DWORD *src = layer->surface.pixels + (SIZE_T)(y - layer->rect.top) * layer->surface.stride +
+				(r.left - layer->rect.left);
+			BlendPremultipliedRow(dst, src, r.right - r.left, layer->opacity);
+		}
+	}
+}
+
+UINT ComposeLayers(PCOMPOSITOR compositor) {
+	RECT dirtyRect = { 0, 0, 0, 0 };
+	UINT composed = 0;
+
+	PSURFACE target = compositor->target;
+	for (UINT ty = 0; target && ty < compositor->tilesY; ty++) {
+		// Coverage is expanded for runs of adjacent tiles at once, which
+		// keeps rows long and the back buffer in the cache
+		RECT run = { 0, 0, 0, 0 };
+
+		for (UINT tx = 0; tx <= compositor->tilesX; tx++) {
+			PBYTE dirty = compositor->dirtyTiles + (SIZE_T)ty * compositor->tilesX + tx;
+			if (tx == compositor->tilesX || !*dirty) {
+				if (!IsRectEmpty(&run) && compositor->format == COMPOSITOR_COVERAGE) {
+					ExpandBackBuffer(compositor, &run);
+				}
+				SetRectEmpty(&run);
+				continue;
+			}
+			*dirty = 0;
+
+			RECT tile = { tx * COMPOSITOR_TILE_SIZE, ty * COMPOSITOR_TILE_SIZE,
+				min((LONG)(tx + 1) * COMPOSITOR_TILE_SIZE, target->width),
+				min((LONG)(ty + 1) * COMPOSITOR_TILE_SIZE, target->height) };
+			ComposeTile(compositor, &tile);
+			UnionRect(&run, &run, &tile);
+
+			if (composed++ == 0) {
+				dirtyRect = tile;
+			}
+			else {
+				dirtyRect.left = min(dirtyRect.left, tile.left);
+				dirtyRect.top = min(dirtyRect.top, tile.top);
+				dirtyRect.right = max(dirtyRect.right, tile.right);
+				dirtyRect.bottom = max(dirtyRect.bottom, tile.bottom);
+			}
+		}
+	}
+
+	compositor->dirtyRect = dirtyRect;
+	compositor->composedTiles = composed;
+	return composed;
+}
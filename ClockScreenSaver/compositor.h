@@ -0,0 +1,115 @@
+#pragma once
+
+#include "platform.h"
+#include "surface.h"
+
+// Changes are tracked in square tiles of this size
+#define COMPOSITOR_TILE_SIZE 64
+
+typedef enum {
+	// Layers hold premultiplied colors, which are composed into the target
+	COMPOSITOR_COLOR,
+	// Layers hold the coverage of the foreground color, which is composed
+	// into an 8-bit back buffer. Composed tiles are expanded into the target
+	// using the foreground and background colors.
+	COMPOSITOR_COVERAGE
+} COMPOSITOR_FORMAT;
+
+// An element of the clock face, e.g. a unit or a label, drawn into a surface
+// of its own. Pixels are premultiplied 0xAARRGGBB, or coverage values with
+// COMPOSITOR_COVERAGE, so that a layer can be blended without knowing what is
+// below it.
+typedef struct {
+	SURFACE surface;
+	COVERAGE_SURFACE coverage;
+
+	// Position and size on the target
+	RECT rect;
+
+	// Part of the layer that was drawn into since it was cleared, relative
+	// to rect. Everything outside of it is transparent.
+	RECT bounds;
+
+	// Applied on top of the per-pixel alpha, e.g. to fade a layer out
+	BYTE opacity;
+} LAYER, *PLAYER;
+
+// Composes layers, in the order they were added, over a solid background into
+// a target surface. Layers only change when they are drawn into, and only the
+// tiles that such changes touch are composed again, so the cost of a frame
+// depends on what changed rather than on the number of layers.
+typedef struct {
+	COMPOSITOR_FORMAT format;
+	PSURFACE target;
+	PCOVERAGE_SURFACE backBuffer;
+	COLORREF fgColor;
+	COLORREF bgColor;
+
+	PLAYER layers;
+	UINT nLayers;
+	UINT capacity;
+
+	// One flag per tile that needs to be composed
+	UINT tilesX;
+	UINT tilesY;
+	PBYTE dirtyTiles;
+
+	// Bounding box and number of the tiles composed by the last
+	// ComposeLayers call, e.g. to present only that part of the target
+	RECT dirtyRect;
+	UINT composedTiles;
+} COMPOSITOR, *PCOMPOSITOR;
+
+void InitCompositor(PCOMPOSITOR compositor);
+
+void FreeCompositor(PCOMPOSITOR compositor);
+
+// Sets the surface to compose into, which must outlive the compositor or be
+// replaced. The whole target is composed by the next ComposeLayers call.
+// Switching between the formats removes all layers.
+BOOL SetCompositorTarget(PCOMPOSITOR compositor, PSURFACE target);
+
+// Same for COMPOSITOR_COVERAGE, with a back buffer of the same size as target.
+BOOL SetCompositorCoverageTarget(PCOMPOSITOR compositor, PSURFACE target, PCOVERAGE_SURFACE backBuffer);
+
+void SetCompositorBackground(PCOMPOSITOR compositor, COLORREF color);
+
+// Sets the color of everything drawn with COMPOSITOR_COVERAGE.
+void SetCompositorForeground(PCOMPOSITOR compositor, COLORREF color);
+
+// Removes all layers, e.g. before the layout changes.
+void RemoveAllLayers(PCOMPOSITOR compositor);
+
+// Adds a transparent layer on top of the others and stores its index.
+BOOL AddLayer(PCOMPOSITOR compositor, const RECT *rect, PUINT index);
+
+// Makes a layer transparent again.
+void ClearLayer(PCOMPOSITOR compositor, UINT index);
+
+// Blends color into a layer at (x, y), in layer coordinates, using an 8-bit
+// coverage mask with the given dimensions and stride. With COMPOSITOR_COVERAGE,
+// color is ignored in favor of the foreground color.
+void DrawLayerMask(PCOMPOSITOR compositor, UINT index, int x, int y, const BYTE *mask, int width, int height,
+	SIZE_T stride, COLORREF color);
+
+void SetLayerOpacity(PCOMPOSITOR compositor, UINT index, BYTE opacity);
+
+// Makes the next ComposeLayers call compose rect, or the whole target if rect
+// is NULL.
+void InvalidateCompositor(PCOMPOSITOR compositor, const RECT *rect);
+
+// Composes the tiles that changed into the target. Returns the number of
+// composed tiles.
+UINT ComposeLayers(PCOMPOSITOR compositor);
+
+// Composes count premultiplied pixels from src over the opaque pixels in dst,
+// scaling src by opacity first. The alpha byte of dst stays zero. Uses SSE2
+// where available and gives the same result either way.
+void BlendPremultipliedRow(PDWORD dst, const DWORD *src, SIZE_T count, BYTE opacity);
+
+// The same for coverage values: src, scaled by opacity, over dst.
+void BlendCoverageRow(PBYTE dst, const BYTE *src, SIZE_T count, BYTE opacity);
+
+// Turns count coverage values into opaque pixels between bg and fg. The result
+// is what BlendPremultipliedRow gives for fg at that coverage over bg.
+void ExpandCoverageRow(PDWORD dst, const BYTE *src, SIZE_T count, COLORREF fg, COLORREF bg);
@@ -0,0 +1,126 @@
+#include "gdicache.h"
+
+typedef enum {
+	GDI_CACHE_BRUSH,
+	GDI_CACHE_FONT
+} GDI_CACHE_TYPE;
+
+typedef struct {
+	GDI_CACHE_TYPE type;
+	union {
+		COLORREF color;
+		LOGFONT font;
+	} key;
+	HGDIOBJ hObject;
+	UINT refs;
+} GDI_CACHE_ENTRY, *PGDI_CACHE_ENTRY;
+
+static struct {
+	UINT count;
+	UINT capacity;
+	PGDI_CACHE_ENTRY items;
+} cache;
+
+static BOOL FontKeyEquals(const LOGFONT *a, const LOGFONT *b) {
+	// Compare everything up to the face name, then the face name as a string
+	// because the bytes after the terminator are not significant.
+	if (memcmp(a, b, FIELD_OFFSET(LOGFONT, lfFaceName)) != 0) {
+		return FALSE;
+	}
+	return wcsncmp(a->lfFaceName, b->lfFaceName, LF_FACESIZE) == 0;
+}
+
+static PGDI_CACHE_ENTRY FindEntry(GDI_CACHE_TYPE type, COLORREF color, const LOGFONT *lfont) {
+	for (UINT i = 0; i < cache.count; i++) {
+		PGDI_CACHE_ENTRY entry = &cache.items[i];
+		if (entry->type != type) continue;
+
+		if (type == GDI_CACHE_BRUSH ? entry->key.color == color : FontKeyEquals(&entry->key.font, lfont)) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static PGDI_CACHE_ENTRY AddEntry(GDI_CACHE_TYPE type, HGDIOBJ hObject) {
+	if (cache.count == cache.capacity) {
+		UINT newCapacity = cache.capacity ? cache.capacity * 2 : 8;
+		PGDI_CACHE_ENTRY newItems = realloc(cache.items, newCapacity * sizeof(GDI_CACHE_ENTRY));
+		if (!newItems) {
+			return NULL;
+		}
+		cache.items = newItems;
+		cache.capacity = newCapacity;
+	}
+
+	PGDI_CACHE_ENTRY entry = &cache.items[cache.count++];
+	ZeroMemory(entry, sizeof(GDI_CACHE_ENTRY));
+	entry->type = type;
+	entry->hObject = hObject;
+	entry->refs = 1;
+	return entry;
+}
+
+HBRUSH AcquireSolidBrush(COLORREF color) {
+	PGDI_CACHE_ENTRY entry = FindEntry(GDI_CACHE_BRUSH, color, NULL);
+	if (entry) {
+		entry->refs++;
+		return entry->hObject;
+	}
+
+	HBRUSH hBrush = CreateSolidBrush(color);
+	if (!hBrush) {
+		return NULL;
+	}
+
+	entry = AddEntry(GDI_CACHE_BRUSH, hBrush);
+	if (!entry) {
+		DeleteObject(hBrush);
+		return NULL;
+	}
+	entry->key.color = color;
+
+	return hBrush;
+}
+
+HFONT AcquireFont(const LOGFONT *lfont) {
+	PGDI_CACHE_ENTRY entry = FindEntry(GDI_CACHE_FONT, 0, lfont);
+	if (entry) {
+		entry->refs++;
+		return entry->hObject;
+	}
+
+	HFONT hFont = CreateFontIndirect(lfont);
+	if (!hFont) {
+		return NULL;
+	}
+
+	entry = AddEntry(GDI_CACHE_FONT, hFont);
+	if (!entry) {
+		DeleteObject(hFont);
+		return NULL;
+	}
+	entry->key.font = *lfont;
+
+	return hFont;
+}
+
+void ReleaseGdiObject(HGDIOBJ hObject) {
+	if (!hObject) return;
+
+	for (UINT i = 0; i < cache.count; i++) {
+		if (cache.items[i].hObject != hObject) continue;
+
+		if (--cache.items[i].refs == 0) {
+			DeleteObject(hObject);
+
+			// Order does not matter, so fill the gap with the last entry
+			cache.items[i] = cache.items[--cache.count];
+		}
+		return;
+	}
+}
+
+UINT GetLiveGdiObjectCount(void) {
+	return cache.count;
+}
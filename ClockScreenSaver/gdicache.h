@@ -0,0 +1,18 @@
+#pragma once
+
+#include <Windows.h>
+
+// Returns a shared solid brush for the given color. Every successful call must
+// be balanced by a call to ReleaseGdiObject.
+HBRUSH AcquireSolidBrush(COLORREF color);
+
+// Returns a shared font matching the given LOGFONT. Every successful call must
+// be balanced by a call to ReleaseGdiObject.
+HFONT AcquireFont(const LOGFONT *lfont);
+
+// Drops a reference obtained from AcquireSolidBrush or AcquireFont. The object
+// is deleted once it is no longer referenced. NULL is ignored.
+void ReleaseGdiObject(HGDIOBJ hObject);
+
+// Number of GDI objects currently held by the cache (for leak diagnostics).
+UINT GetLiveGdiObjectCount(void);
@@ -0,0 +1,319 @@
+#include "glyphcache.h"
+#include "memusage.h"
+
+// Size classes grow in quarter steps between powers of two, so that at most
+// a fifth of a block is wasted: 64, 80, 96, 112, 128, 160, ..., 16384
+#define SIZE_CLASS(i) ((SIZE_T)(4 + (i) % 4) * (16 << ((i) / 4)))
+#define NUM_SIZE_CLASSES 33
+#define MAX_CLASS_SIZE SIZE_CLASS(NUM_SIZE_CLASSES - 1)
+
+// Blocks above MAX_CLASS_SIZE, i.e. large digits, get a page of their own.
+// The allocation is then small compared to rasterizing them.
+#define LARGE_CLASS NUM_SIZE_CLASSES
+
+// Pages are small enough that a partially used page per size class does not
+// waste much, and large enough to amortize the allocation
+#define MIN_BLOCKS_PER_PAGE 8
+
+struct GLYPH_POOL_PAGE {
+	PBYTE memory;
+	SIZE_T size;
+	UINT sizeClass;
+	// Blocks in use, blocks in total and blocks never handed out
+	UINT live;
+	UINT capacity;
+	UINT unused;
+	// Blocks that were freed, linked through their first bytes
+	PVOID freeList;
+};
+
+// Bytes of the entries and buckets for a capacity
+static LONGLONG IndexBytes(UINT capacity) {
+	return (LONGLONG)capacity * (sizeof(GLYPH_ENTRY) + 2 * sizeof(UINT));
+}
+
+static UINT GetSizeClass(SIZE_T size) {
+	for (UINT i = 0; i < NUM_SIZE_CLASSES; i++) {
+		if (SIZE_CLASS(i) >= size) return i;
+	}
+	return LARGE_CLASS;
+}
+
+static SIZE_T GetBlockSize(UINT sizeClass, SIZE_T size) {
+	return sizeClass == LARGE_CLASS ? size : SIZE_CLASS(sizeClass);
+}
+
+static PGLYPH_POOL_PAGE AddPage(PGLYPH_CACHE cache, UINT sizeClass, SIZE_T size) {
+	PGLYPH_POOL_PAGE *pages = realloc(cache->pages, (cache->nPages + 1) * sizeof(PGLYPH_POOL_PAGE));
+	if (!pages) return NULL;
+	cache->pages = pages;
+
+	PGLYPH_POOL_PAGE page = calloc(1, sizeof(GLYPH_POOL_PAGE));
+	if (!page) return NULL;
+
+	page->size = sizeClass == LARGE_CLASS ? size :
+		max(GLYPH_POOL_MIN_PAGE_SIZE, SIZE_CLASS(sizeClass) * MIN_BLOCKS_PER_PAGE);
+	page->memory = malloc(page->size);
+	if (!page->memory) {
+		free(page);
+		return NULL;
+	}
+
+	page->sizeClass = sizeClass;
+	page->capacity = (UINT)(page->size / GetBlockSize(sizeClass, size));
+	page->unused = page->capacity;
+
+	cache->pages[cache->nPages++] = page;
+	cache->stats.bytesReserved += page->size;
+	TrackMemory(MEMORY_GLYPHS, page->size);
+	return page;
+}
+
+static PBYTE AllocBlock(PGLYPH_CACHE cache, SIZE_T size, PUINT sizeClass) {
+	*sizeClass = GetSizeClass(size);
+
+	// There are few pages, a linear search for one with room is cheap
+	PGLYPH_POOL_PAGE page = NULL;
+	if (*sizeClass != LARGE_CLASS) {
+		for (UINT i = 0; i < cache->nPages; i++) {
+			PGLYPH_POOL_PAGE p = cache->pages[i];
+			if (p->sizeClass == *sizeClass && p->live < p->capacity) {
+				page = p;
+				break;
+			}
+		}
+	}
+
+	if (!page && !(page = AddPage(cache, *sizeClass, size))) {
+		return NULL;
+	}
+
+	PBYTE block;
+	if (page->freeList) {
+		block = page->freeList;
+		page->freeList = *(PVOID *)block;
+	}
+	else {
+		block = page->memory + (page->capacity - page->unused) * GetBlockSize(*sizeClass, size);
+		page->unused--;
+	}
+
+	page->live++;
+	cache->stats.bytesInUse += GetBlockSize(*sizeClass, size);
+	return block;
+}
+
+static void FreeBlock(PGLYPH_CACHE cache, PBYTE block, UINT sizeClass, SIZE_T size) {
+	for (UINT i = 0; i < cache->nPages; i++) {
+		PGLYPH_POOL_PAGE page = cache->pages[i];
+		if (block < page->memory || block >= page->memory + page->size) continue;
+
+		cache->stats.bytesInUse -= GetBlockSize(sizeClass, size);
+
+		// Give empty pages back so that memory follows the cache contents,
+		// e.g. after a resize changed the size of all masks
+		if (--page->live == 0) {
+			cache->stats.bytesReserved -= page->size;
+			TrackMemory(MEMORY_GLYPHS, -(LONGLONG)page->size);
+			free(page->memory);
+			free(page);
+			cache->pages[i] = cache->pages[--cache->nPages];
+			return;
+		}
+
+		*(PVOID *)block = page->freeList;
+		page->freeList = block;
+		return;
+	}
+}
+
+void InitGlyphCache(PGLYPH_CACHE cache, SIZE_T maxBytes) {
+	ZeroMemory(cache, sizeof(GLYPH_CACHE));
+	cache->maxBytes = maxBytes;
+}
+
+void ClearGlyphCache(PGLYPH_CACHE cache) {
+	for (UINT i = 0; i < cache->nPages; i++) {
+		free(cache->pages[i]->memory);
+		free(cache->pages[i]);
+	}
+	free(cache->pages);
+	free(cache->entries);
+	free(cache->buckets);
+	TrackMemory(MEMORY_GLYPHS, -(LONGLONG)cache->stats.bytesReserved - IndexBytes(cache->capacity));
+
+	GLYPH_CACHE_STATS stats = cache->stats;
+	InitGlyphCache(cache, cache->maxBytes);
+	cache->stats.hits = stats.hits;
+	cache->stats.misses = stats.misses;
+	cache->stats.evictions = stats.evictions;
+}
+
+void FreeGlyphCache(PGLYPH_CACHE cache) {
+	ClearGlyphCache(cache);
+	ZeroMemory(cache, sizeof(GLYPH_CACHE));
+}
+
+static UINT HashKey(const TTFONT *font, UINT glyph, int height, UINT subpixel) {
+	UINT hash = (UINT)((uintptr_t)font >> 4) * 0x9E3779B1u;
+	hash = (hash ^ glyph) * 0x85EBCA77u;
+	hash = (hash ^ (UINT)height) * 0xC2B2AE3Du;
+	hash = (hash ^ subpixel) * 0x27D4EB2Fu;
+	return hash ^ (hash >> 15);
+}
+
+#define ENTRY(cache, ref) (&(cache)->entries[(ref) - 1])
+
+static void UnlinkLru(PGLYPH_CACHE cache, UINT ref) {
+	PGLYPH_ENTRY entry = ENTRY(cache, ref);
+	if (entry->newer) ENTRY(cache, entry->newer)->older = entry->older;
+	else cache->newest = entry->older;
+	if (entry->older) ENTRY(cache, entry->older)->newer = entry->newer;
+	else cache->oldest = entry->newer;
+	entry->newer = entry->older = 0;
+}
+
+static void PushLru(PGLYPH_CACHE cache, UINT ref) {
+	PGLYPH_ENTRY entry = ENTRY(cache, ref);
+	entry->older = cache->newest;
+	entry->newer = 0;
+	if (cache->newest) ENTRY(cache, cache->newest)->newer = ref;
+	cache->newest = ref;
+	if (!cache->oldest) cache->oldest = ref;
+}
+
+static PUINT FindBucket(PGLYPH_CACHE cache, const GLYPH_ENTRY *entry) {
+	UINT hash = HashKey(entry->font, entry->glyph, entry->height, entry->subpixel);
+	return &cache->buckets[hash & (2 * cache->capacity - 1)];
+}
+
+static void Evict(PGLYPH_CACHE cache, UINT ref) {
+	PGLYPH_ENTRY entry = ENTRY(cache, ref);
+
+	// Remove from the hash chain
+	for (PUINT link = FindBucket(cache, entry); *link; link = &ENTRY(cache, *link)->next) {
+		if (*link == ref) {
+			*link = entry->next;
+			break;
+		}
+	}
+
+	UnlinkLru(cache, ref);
+	if (entry->mask.coverage) {
+		FreeBlock(cache, entry->mask.coverage, entry->sizeClass, (SIZE_T)entry->mask.width * entry->mask.height);
+	}
+
+	ZeroMemory(entry, sizeof(GLYPH_ENTRY));
+	entry->next = cache->freeEntry;
+	cache->freeEntry = ref;
+	cache->count--;
+	cache->stats.evictions++;
+}
+
+// Makes room for one more entry. The number of buckets is twice the capacity,
+// which is a power of two.
+static BOOL GrowEntries(PGLYPH_CACHE cache) {
+	if (cache->freeEntry || cache->count < cache->capacity) {
+		return TRUE;
+	}
+
+	UINT newCapacity = cache->capacity ? cache->capacity * 2 : 64;
+	PGLYPH_ENTRY entries = realloc(cache->entries, newCapacity * sizeof(GLYPH_ENTRY));
+	if (!entries) return FALSE;
+	cache->entries = entries;
+
+	PUINT buckets = calloc(2 * (SIZE_T)newCapacity, sizeof(UINT));
+	if (!buckets) return FALSE;
+	free(cache->buckets);
+	cache->buckets = buckets;
+	TrackMemory(MEMORY_GLYPHS, IndexBytes(newCapacity) - IndexBytes(cache->capacity));
+	cache->capacity = newCapacity;
+
+	// All entries are in use, rebuild the chains
+	for (UINT ref = 1; ref <= cache->count; ref++) {
+		PUINT bucket = FindBucket(cache, ENTRY(cache, ref));
+		ENTRY(cache, ref)->next = *bucket;
+		*bucket = ref;
+	}
+
+	return TRUE;
+}
+
+const GLYPH_MASK *GetCachedGlyph(PGLYPH_CACHE cache, const TTFONT *font, UINT glyph, int height, UINT subpixel) {
+	static const GLYPH_MASK empty = { 0 };
+
+	if (cache->buckets) {
+		UINT hash = HashKey(font, glyph, height, subpixel);
+		for (UINT ref = cache->buckets[hash & (2 * cache->capacity - 1)]; ref; ref = ENTRY(cache, ref)->next) {
+			PGLYPH_ENTRY entry = ENTRY(cache, ref);
+			if (entry->font == font && entry->glyph == glyph && entry->height == height &&
+				entry->subpixel == subpixel) {
+				cache->stats.hits++;
+				UnlinkLru(cache, ref);
+				PushLru(cache, ref);
+				return &entry->mask;
+			}
+		}
+	}
+
+	cache->stats.misses++;
+
+	float scale = GetFontScale(font, height);
+	float subpixelX = (float)subpixel / GLYPH_SUBPIXEL_BUCKETS;
+	GLYPH_MASK mask;
+	if (!MeasureGlyph(font, glyph, scale, subpixelX, &mask)) {
+		return &empty;
+	}
+
+	// Evict until the new mask fits. A mask larger than the whole cache is
+	// still stored, and is the first to go next time.
+	SIZE_T size = (SIZE_T)mask.width * mask.height;
+	SIZE_T blockSize = GetBlockSize(GetSizeClass(size), size);
+	while (cache->oldest && cache->stats.bytesInUse + blockSize > cache->maxBytes) {
+		Evict(cache, cache->oldest);
+	}
+
+	if (!GrowEntries(cache)) {
+		return &empty;
+	}
+
+	UINT sizeClass = 0;
+	if (size) {
+		mask.coverage = AllocBlock(cache, size, &sizeClass);
+		if (!mask.coverage || !RasterizeGlyphInto(font, glyph, scale, subpixelX, &mask)) {
+			if (mask.coverage) FreeBlock(cache, mask.coverage, sizeClass, size);
+			return &empty;
+		}
+	}
+
+	UINT ref;
+	if (cache->freeEntry) {
+		ref = cache->freeEntry;
+		cache->freeEntry = ENTRY(cache, ref)->next;
+	}
+	else {
+		ref = cache->count + 1;
+	}
+	cache->count++;
+
+	PGLYPH_ENTRY entry = ENTRY(cache, ref);
+	ZeroMemory(entry, sizeof(GLYPH_ENTRY));
+	entry->font = font;
+	entry->glyph = glyph;
+	entry->height = height;
+	entry->subpixel = subpixel;
+	entry->mask = mask;
+	entry->sizeClass = sizeClass;
+
+	PUINT bucket = FindBucket(cache, entry);
+	entry->next = *bucket;
+	*bucket = ref;
+	PushLru(cache, ref);
+
+	return &entry->mask;
+}
+
+void GetGlyphCacheStats(const GLYPH_CACHE *cache, PGLYPH_CACHE_STATS stats) {
+	*stats = cache->stats;
+	stats->entries = cache->count;
+}
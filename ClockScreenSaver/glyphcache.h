@@ -0,0 +1,77 @@
+#pragma once
+
+#include "platform.h"
+#include "ttfont.h"
+
+// Horizontal positions are rounded to this fraction of a pixel. Thin strokes
+// keep their shape instead of jumping between whole pixels.
+#define GLYPH_SUBPIXEL_BUCKETS 4
+
+#define DEFAULT_GLYPH_CACHE_SIZE (16 * 1024 * 1024)
+
+// Coverage masks of similar size are carved out of shared pages, which hold
+// at least this many bytes
+#define GLYPH_POOL_MIN_PAGE_SIZE (16 * 1024)
+
+typedef struct {
+	ULONGLONG hits;
+	ULONGLONG misses;
+	ULONGLONG evictions;
+	UINT entries;
+	// Bytes of the blocks that hold masks, and bytes allocated for them
+	SIZE_T bytesInUse;
+	SIZE_T bytesReserved;
+} GLYPH_CACHE_STATS, *PGLYPH_CACHE_STATS;
+
+typedef struct GLYPH_POOL_PAGE GLYPH_POOL_PAGE, *PGLYPH_POOL_PAGE;
+
+typedef struct {
+	const TTFONT *font;
+	UINT glyph;
+	int height;
+	UINT subpixel;
+
+	GLYPH_MASK mask;
+	UINT sizeClass;
+
+	// Doubly linked LRU list and hash chain, as indices plus one
+	UINT newer;
+	UINT older;
+	UINT next;
+} GLYPH_ENTRY, *PGLYPH_ENTRY;
+
+// Rasterized glyphs keyed on font, cell height, glyph and subpixel offset,
+// evicted least recently used first once the masks exceed maxBytes. A cache
+// may be shared by several renderers on the same thread, e.g. one per
+// monitor, but not between threads.
+typedef struct {
+	SIZE_T maxBytes;
+
+	PGLYPH_ENTRY entries;
+	UINT count;
+	UINT capacity;
+	UINT freeEntry;
+	PUINT buckets;
+	UINT newest;
+	UINT oldest;
+
+	PGLYPH_POOL_PAGE *pages;
+	UINT nPages;
+
+	GLYPH_CACHE_STATS stats;
+} GLYPH_CACHE, *PGLYPH_CACHE;
+
+void InitGlyphCache(PGLYPH_CACHE cache, SIZE_T maxBytes);
+
+void FreeGlyphCache(PGLYPH_CACHE cache);
+
+// Discards all masks but keeps the statistics.
+void ClearGlyphCache(PGLYPH_CACHE cache);
+
+// Returns the mask of a glyph at the given cell height, shifted right by
+// subpixel / GLYPH_SUBPIXEL_BUCKETS pixels, rasterizing it if necessary. The
+// result is valid until the next call for the same cache, and has no
+// coverage for empty glyphs or on failure.
+const GLYPH_MASK *GetCachedGlyph(PGLYPH_CACHE cache, const TTFONT *font, UINT glyph, int height, UINT subpixel);
+
+void GetGlyphCacheStats(const GLYPH_CACHE *cache, PGLYPH_CACHE_STATS stats);
@@ -0,0 +1,178 @@
+#include "imagefile.h"
+
+// Deflate allows at most this many bytes in a stored block
+#define MAX_STORED_BLOCK 65535
+
+// CRC-32 of PNG chunks, four bits at a time. The table is small enough to be
+// a constant, which keeps encoding safe to run on several threads.
+static const DWORD crcNibbles[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static DWORD UpdateCrc(DWORD crc, const BYTE *data, SIZE_T len) {
+	for (SIZE_T i = 0; i < len; i++) {
+		crc ^= data[i];
+		crc = crcNibbles[crc & 0xF] ^ (crc >> 4);
+		crc = crcNibbles[crc & 0xF] ^ (crc >> 4);
+	}
+	return crc;
+}
+
+static PBYTE PutU32(PBYTE p, DWORD v) {
+	p[0] = (BYTE)(v >> 24);
+	p[1] = (BYTE)(v >> 16);
+	p[2] = (BYTE)(v >> 8);
+	p[3] = (BYTE)v;
+	return p + 4;
+}
+
+// Writes a chunk whose data has already been placed after the header
+static PBYTE FinishChunk(PBYTE chunk, const char *type, SIZE_T len) {
+	PutU32(chunk, (DWORD)len);
+	memcpy(chunk + 4, type, 4);
+	DWORD crc = UpdateCrc(0xFFFFFFFFu, chunk + 4, len + 4) ^ 0xFFFFFFFFu;
+	return PutU32(chunk + 8 + len, crc);
+}
+
+// Sums bytes in chunks that cannot overflow before the modulo, see zlib
+#define ADLER_CHUNK 5552
+
+static DWORD Adler32(const BYTE *data, SIZE_T len) {
+	DWORD a = 1, b = 0;
+	while (len > 0) {
+		SIZE_T n = min(len, ADLER_CHUNK);
+		len -= n;
+		while (n--) {
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+void CopySurfaceRowRgb(const SURFACE *surface, int y, PBYTE out) {
+	const DWORD *row = surface->pixels + (SIZE_T)y * surface->stride;
+	for (int x = 0; x < surface->width; x++) {
+		out[0] = (BYTE)(row[x] >> 16);
+		out[1] = (BYTE)(row[x] >> 8);
+		out[2] = (BYTE)row[x];
+		out += 3;
+	}
+}
+
+void CopySurfaceRgb(const SURFACE *surface, PBYTE out) {
+	for (int y = 0; y < surface->height; y++) {
+		CopySurfaceRowRgb(surface, y, out);
+		out += 3 * (SIZE_T)surface->width;
+	}
+}
+
+PBYTE EncodePng(const SURFACE *surface, PSIZE_T size) {
+	// Each row starts with a filter type byte
+	SIZE_T rowSize = 1 + 3 * (SIZE_T)surface->width;
+	SIZE_T rawSize = rowSize * surface->height;
+	SIZE_T nBlocks = (rawSize + MAX_STORED_BLOCK - 1) / MAX_STORED_BLOCK;
+	SIZE_T zlibSize = 2 + rawSize + 5 * nBlocks + 4;
+	if (rawSize == 0 || zlibSize > 0x7FFFFFFF) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return NULL;
+	}
+
+	static const BYTE signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	*size = sizeof(signature) + (12 + 13) + (12 + zlibSize) + 12;
+
+	PBYTE png = malloc(*size);
+	PBYTE raw = malloc(rawSize);
+	if (!png || !raw) {
+		free(png);
+		free(raw);
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return NULL;
+	}
+
+	// Scanlines without filtering
+	for (int y = 0; y < surface->height; y++) {
+		raw[y * rowSize] = 0;
+		CopySurfaceRowRgb(surface, y, raw + y * rowSize + 1);
+	}
+
+	PBYTE p = png;
+	memcpy(p, signature, sizeof(signature));
+	p += sizeof(signature);
+
+	// IHDR: 8-bit truecolor, no interlacing
+	PBYTE chunk = p;
+	p = PutU32(chunk + 8, surface->width);
+	p = PutU32(p, surface->height);
+	p[0] = 8;
+	p[1] = 2;
+	p[2] = p[3] = p[4] = 0;
+	p = FinishChunk(chunk, "IHDR", 13);
+
+	// IDAT: a zlib stream of stored deflate blocks
+	chunk = p;
+	p = chunk + 8;
+	*p++ = 0x78;
+	*p++ = 0x01;
+
+	for (SIZE_T offset = 0; offset < rawSize; offset += MAX_STORED_BLOCK) {
+		SIZE_T len = min(rawSize - offset, MAX_STORED_BLOCK);
+		*p++ = offset + len == rawSize ? 1 : 0;
+		p[0] = (BYTE)len;
+		p[1] = (BYTE)(len >> 8);
+		p[2] = (BYTE)~p[0];
+		p[3] = (BYTE)~p[1];
+		memcpy(p + 4, raw + offset, len);
+		p += 4 + len;
+	}
+
+	p = PutU32(p, Adler32(raw, rawSize));
+	free(raw);
+	p = FinishChunk(chunk, "IDAT", p - (chunk + 8));
+
+	p = FinishChunk(p, "IEND", 0);
+	*size = p - png;
+
+	return png;
+}
+
+PBYTE EncodePpm(const SURFACE *surface, PSIZE_T size) {
+	char header[32];
+	int headerLen = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", surface->width, surface->height);
+
+	*size = headerLen + 3 * (SIZE_T)surface->width * surface->height;
+	PBYTE ppm = malloc(*size);
+	if (!ppm) {
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return NULL;
+	}
+
+	memcpy(ppm, header, headerLen);
+	CopySurfaceRgb(surface, ppm + headerLen);
+
+	return ppm;
+}
+
+IMAGE_FORMAT GetImageFormatFromPath(PCWSTR path) {
+	PCWSTR ext = wcsrchr(path, '.');
+	if (ext && _wcsicmp(ext, L".ppm") == 0) {
+		return IMAGE_FORMAT_PPM;
+	}
+	return IMAGE_FORMAT_PNG;
+}
+
+BOOL WriteImageFile(PCWSTR path, const SURFACE *surface, IMAGE_FORMAT format) {
+	SIZE_T size;
+	PBYTE data = format == IMAGE_FORMAT_PPM ? EncodePpm(surface, &size) : EncodePng(surface, &size);
+	if (!data) return FALSE;
+
+	BOOL ret = WriteFileContents(path, data, size);
+	free(data);
+
+	return ret;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "platform.h"
+#include "surface.h"
+
+typedef enum {
+	IMAGE_FORMAT_PNG,
+	IMAGE_FORMAT_PPM
+} IMAGE_FORMAT;
+
+// Writes the pixels of one row, or of the whole surface, as packed 8-bit RGB.
+void CopySurfaceRowRgb(const SURFACE *surface, int y, PBYTE out);
+
+void CopySurfaceRgb(const SURFACE *surface, PBYTE out);
+
+// Encodes a surface as an uncompressed 8-bit RGB PNG. The result must be
+// freed with free().
+PBYTE EncodePng(const SURFACE *surface, PSIZE_T size);
+
+// Encodes a surface as a binary PPM (P6). The result must be freed with free().
+PBYTE EncodePpm(const SURFACE *surface, PSIZE_T size);
+
+// Guesses the format from the extension of path, defaulting to PNG.
+IMAGE_FORMAT GetImageFormatFromPath(PCWSTR path);
+
+BOOL WriteImageFile(PCWSTR path, const SURFACE *surface, IMAGE_FORMAT format);
@@ -0,0 +1,62 @@
+#include "memusage.h"
+#include "glyphcache.h"
+
+static volatile LONGLONG trackedBytes[MEMORY_CATEGORIES];
+static volatile LONGLONG totalBytes;
+static volatile LONGLONG peakBytes;
+
+void TrackMemory(MEMORY_CATEGORY category, LONGLONG delta) {
+	InterlockedExchangeAdd64(&trackedBytes[category], delta);
+	LONGLONG total = InterlockedExchangeAdd64(&totalBytes, delta) + delta;
+
+	LONGLONG peak = peakBytes;
+	while (total > peak) {
+		LONGLONG seen = InterlockedCompareExchange64(&peakBytes, total, peak);
+		if (seen == peak) break;
+		peak = seen;
+	}
+}
+
+void GetMemoryUsage(PMEMORY_USAGE usage) {
+	for (UINT i = 0; i < MEMORY_CATEGORIES; i++) {
+		usage->bytes[i] = (SIZE_T)max(trackedBytes[i], 0);
+	}
+	usage->total = (SIZE_T)max(totalBytes, 0);
+	usage->peak = (SIZE_T)max(peakBytes, 0);
+}
+
+// Rounds up so that anything held shows as at least 1 KB
+static unsigned long ToKilobytes(SIZE_T bytes) {
+	return (unsigned long)((bytes + 1023) / 1024);
+}
+
+void FormatMemoryUsage(const MEMORY_USAGE *usage, PWSTR out, SIZE_T size) {
+	swprintf(out, size,
+		L"surfaces %lu KB, glyphs %lu KB, fonts %lu KB, properties %lu KB, total %lu KB, peak %lu KB",
+		ToKilobytes(usage->bytes[MEMORY_SURFACES]), ToKilobytes(usage->bytes[MEMORY_GLYPHS]),
+		ToKilobytes(usage->bytes[MEMORY_FONTS]), ToKilobytes(usage->bytes[MEMORY_PROPERTIES]),
+		ToKilobytes(usage->total), ToKilobytes(usage->peak));
+}
+
+static SIZE_T GetRemainingBudget(SIZE_T budget) {
+	MEMORY_USAGE usage;
+	GetMemoryUsage(&usage);
+	return budget > usage.total ? budget - usage.total : 0;
+}
+
+BACK_BUFFER_MODE ChooseBackBufferMode(SIZE_T budget, int width, int height) {
+	if (!budget) return BACK_BUFFER_FULL_COLOR;
+
+	SIZE_T remaining = GetRemainingBudget(budget);
+	SIZE_T pixels = (SIZE_T)max(width, 0) * max(height, 0);
+	if (pixels * 4 <= remaining) return BACK_BUFFER_FULL_COLOR;
+	if (pixels * 2 <= remaining) return BACK_BUFFER_LOW_COLOR;
+	return BACK_BUFFER_NONE;
+}
+
+SIZE_T ChooseGlyphCacheSize(SIZE_T budget) {
+	if (!budget) return DEFAULT_GLYPH_CACHE_SIZE;
+
+	SIZE_T size = GetRemainingBudget(budget) / 4;
+	return max(MIN_GLYPH_CACHE_SIZE, min(size, DEFAULT_GLYPH_CACHE_SIZE));
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "platform.h"
+
+// What the tracked bytes are held by
+typedef enum {
+	MEMORY_SURFACES,    // back buffers, software surfaces and layers
+	MEMORY_GLYPHS,      // glyph cache pages and index
+	MEMORY_FONTS,       // font files loaded into memory
+	MEMORY_PROPERTIES,  // property names, values and index
+	MEMORY_CATEGORIES
+} MEMORY_CATEGORY;
+
+typedef struct {
+	SIZE_T bytes[MEMORY_CATEGORIES];
+	SIZE_T total;
+	// Highest total since the process started
+	SIZE_T peak;
+} MEMORY_USAGE, *PMEMORY_USAGE;
+
+// Maximum number of characters written by FormatMemoryUsage, including the terminator
+#define MEMORY_USAGE_MAX_CHARS 160
+
+// Records that bytes were allocated (delta > 0) or freed (delta < 0) on
+// behalf of a category. Safe to call from any thread.
+void TrackMemory(MEMORY_CATEGORY category, LONGLONG delta);
+
+void GetMemoryUsage(PMEMORY_USAGE usage);
+
+// Describes usage in a single line, e.g. for a debug log.
+void FormatMemoryUsage(const MEMORY_USAGE *usage, PWSTR out, SIZE_T size);
+
+// How a renderer keeps the previous frame
+typedef enum {
+	BACK_BUFFER_FULL_COLOR,  // 32 bits per pixel
+	BACK_BUFFER_LOW_COLOR,   // 16 bits per pixel, half the memory
+	BACK_BUFFER_NONE         // changes are drawn straight to the screen
+} BACK_BUFFER_MODE;
+
+// Budgets are in bytes, zero means unlimited. The choices below leave room
+// for what is already tracked, so resources should be freed before they are
+// replaced.
+
+// Picks the best back buffer of the given size that fits into the budget.
+BACK_BUFFER_MODE ChooseBackBufferMode(SIZE_T budget, int width, int height);
+
+// Glyph caches are not made smaller than this, even if the budget is exceeded
+#define MIN_GLYPH_CACHE_SIZE (256 * 1024)
+
+// Picks the size of a glyph cache: DEFAULT_GLYPH_CACHE_SIZE, or a quarter of
+// what remains of the budget, but no less than MIN_GLYPH_CACHE_SIZE.
+SIZE_T ChooseGlyphCacheSize(SIZE_T budget);
@@ -0,0 +1,243 @@
+#pragma once
+
+// Platform abstraction for the modules that do not depend on the Windows UI:
+// properties, settings, time formatting, layout and software rendering. On
+// Windows, this is just Windows.h. Elsewhere, the subset of Windows types and
+// macros used by these modules is provided here, and platform_posix.c
+// implements the functions declared at the end of this file.
+
+#ifdef _WIN32
+
+#include <Windows.h>
+
+typedef struct {
+	DYNAMIC_TIME_ZONE_INFORMATION dtzi;
+} PLATFORM_ZONE, *PPLATFORM_ZONE;
+
+typedef struct {
+	HANDLE handle;
+} PLATFORM_THREAD, *PPLATFORM_THREAD;
+
+#else
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+
+typedef int BOOL, *PBOOL;
+typedef uint8_t BYTE, *PBYTE;
+typedef uint16_t WORD, *PWORD;
+typedef uint32_t DWORD, *PDWORD;
+typedef int32_t LONG;
+typedef unsigned int UINT, *PUINT;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef size_t SIZE_T, *PSIZE_T;
+typedef void *PVOID, *HANDLE;
+typedef char CHAR, *PCHAR, *PSTR;
+typedef const char *PCSTR;
+typedef wchar_t WCHAR;
+typedef WCHAR *PWSTR;
+typedef const WCHAR *PCWSTR;
+typedef DWORD COLORREF, *LPCOLORREF;
+
+typedef struct {
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+} RECT, *PRECT;
+
+typedef struct {
+	LONG x;
+	LONG y;
+} POINT, *PPOINT;
+
+typedef struct {
+	LONG cx;
+	LONG cy;
+} SIZE, *PSIZE;
+
+#define TRUE 1
+#define FALSE 0
+
+#define TEXT(s) L##s
+
+#define WINAPI
+
+#define MAXUINT ((UINT)~0u)
+#define MAXLONGLONG INT64_MAX
+#define MINLONGLONG INT64_MIN
+
+#define FW_DONTCARE 0
+
+#define RGB(r, g, b) ((COLORREF)(((BYTE)(r)) | ((WORD)((BYTE)(g)) << 8) | (((DWORD)(BYTE)(b)) << 16)))
+#define GetRValue(rgb) ((BYTE)(rgb))
+#define GetGValue(rgb) ((BYTE)((rgb) >> 8))
+#define GetBValue(rgb) ((BYTE)((rgb) >> 16))
+
+#define FIELD_OFFSET(type, field) offsetof(type, field)
+#define ZeroMemory(dst, len) memset((dst), 0, (len))
+#define SecureZeroMemory(dst, len) memset((dst), 0, (len))
+#define CopyMemory(dst, src, len) memcpy((dst), (src), (len))
+#define MoveMemory(dst, src, len) memmove((dst), (src), (len))
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define _wcsdup wcsdup
+#define _wcsicmp wcscasecmp
+#define _wcsnicmp wcsncasecmp
+
+static inline BOOL EqualRect(const RECT *a, const RECT *b) {
+	return a->left == b->left && a->top == b->top && a->right == b->right && a->bottom == b->bottom;
+}
+
+static inline BOOL OffsetRect(PRECT rect, int dx, int dy) {
+	rect->left += dx;
+	rect->right += dx;
+	rect->top += dy;
+	rect->bottom += dy;
+	return TRUE;
+}
+
+static inline BOOL SetRectEmpty(PRECT rect) {
+	rect->left = rect->top = rect->right = rect->bottom = 0;
+	return TRUE;
+}
+
+static inline BOOL IsRectEmpty(const RECT *rect) {
+	return rect->left >= rect->right || rect->top >= rect->bottom;
+}
+
+static inline BOOL IntersectRect(PRECT dst, const RECT *a, const RECT *b) {
+	RECT r = { max(a->left, b->left), max(a->top, b->top), min(a->right, b->right), min(a->bottom, b->bottom) };
+	if (IsRectEmpty(&r)) {
+		SetRectEmpty(dst);
+		return FALSE;
+	}
+	*dst = r;
+	return TRUE;
+}
+
+static inline BOOL UnionRect(PRECT dst, const RECT *a, const RECT *b) {
+	if (IsRectEmpty(a)) {
+		*dst = *b;
+	}
+	else if (IsRectEmpty(b)) {
+		*dst = *a;
+	}
+	else {
+		RECT r = { min(a->left, b->left), min(a->top, b->top), max(a->right, b->right), max(a->bottom, b->bottom) };
+		*dst = r;
+	}
+	return !IsRectEmpty(dst);
+}
+
+static inline LONGLONG InterlockedExchangeAdd64(volatile LONGLONG *target, LONGLONG value) {
+	return __atomic_fetch_add(target, value, __ATOMIC_SEQ_CST);
+}
+
+static inline LONGLONG InterlockedCompareExchange64(volatile LONGLONG *target, LONGLONG exchange,
+	LONGLONG comparand) {
+	return __sync_val_compare_and_swap(target, comparand, exchange);
+}
+
+#define _TRUNCATE ((SIZE_T)-1)
+
+// Minimal versions of the bounds-checked string functions. Unlike the real
+// ones, they truncate instead of invoking an invalid parameter handler.
+static inline int wcsncpy_s(PWSTR dst, SIZE_T size, PCWSTR src, SIZE_T count) {
+	if (size == 0) return -1;
+	SIZE_T n = 0;
+	while (n + 1 < size && n < count && src[n]) {
+		dst[n] = src[n];
+		n++;
+	}
+	dst[n] = '\0';
+	return 0;
+}
+
+static inline int wcscpy_s(PWSTR dst, SIZE_T size, PCWSTR src) {
+	return wcsncpy_s(dst, size, src, _TRUNCATE);
+}
+
+static inline int wcscat_s(PWSTR dst, SIZE_T size, PCWSTR src) {
+	SIZE_T n = wcslen(dst);
+	return n < size ? wcsncpy_s(dst + n, size - n, src, _TRUNCATE) : -1;
+}
+
+// Error codes that are passed through SetLastError
+#define ERROR_SUCCESS 0
+#define ERROR_FILE_NOT_FOUND 2
+#define ERROR_ACCESS_DENIED 5
+#define ERROR_NOT_ENOUGH_MEMORY 8
+#define ERROR_INVALID_DATA 13
+#define ERROR_READ_FAULT 30
+#define ERROR_WRITE_FAULT 29
+#define ERROR_INVALID_PARAMETER 87
+#define ERROR_BUFFER_OVERFLOW 111
+#define ERROR_FILE_TOO_LARGE 223
+
+void SetLastError(DWORD error);
+
+DWORD GetLastError(void);
+
+typedef struct {
+	char name[128];
+} PLATFORM_ZONE, *PPLATFORM_ZONE;
+
+typedef struct {
+	pthread_t thread;
+} PLATFORM_THREAD, *PPLATFORM_THREAD;
+
+#endif
+
+// Reads a whole file into a newly allocated buffer, which must be freed with
+// free(). Fails with ERROR_FILE_TOO_LARGE if the file exceeds maxSize bytes.
+BOOL ReadFileContents(PCWSTR path, SIZE_T maxSize, PBYTE *data, PSIZE_T size);
+
+// Replaces the contents of a file.
+BOOL WriteFileContents(PCWSTR path, const BYTE *data, SIZE_T size);
+
+// Returns the current UTC time in milliseconds since 1601-01-01.
+LONGLONG GetPlatformUtcTimeMs(void);
+
+// Returns a monotonic time in milliseconds that is unaffected by changes of
+// the system time.
+LONGLONG GetPlatformMonotonicTimeMs(void);
+
+// Same in microseconds, e.g. to time startup.
+LONGLONG GetPlatformMonotonicTimeUs(void);
+
+// Looks up a time zone by name. Windows uses time zone key names such as
+// "Tokyo Standard Time", other systems use IANA names such as "Asia/Tokyo".
+BOOL ResolvePlatformZone(PCWSTR name, PPLATFORM_ZONE zone);
+
+// Retrieves the difference between the time in a zone and UTC at the given
+// UTC time, in milliseconds. If zone is NULL, the system time zone is used.
+BOOL GetPlatformZoneOffset(const PLATFORM_ZONE *zone, LONGLONG utc, LONGLONG *offset);
+
+typedef DWORD (WINAPI *PLATFORM_THREAD_PROC)(PVOID param);
+
+// Runs proc(param) on a new thread.
+BOOL StartPlatformThread(PPLATFORM_THREAD thread, PLATFORM_THREAD_PROC proc, PVOID param);
+
+// Waits for a thread to finish and releases it.
+void JoinPlatformThread(PPLATFORM_THREAD thread);
+
+// Returns the number of logical processors available to the process.
+UINT GetPlatformProcessorCount(void);
+
+// Retrieves the name of the computer, e.g. to select profiles. Fails with
+// ERROR_BUFFER_OVERFLOW if it does not fit in size characters.
+BOOL GetPlatformHostName(PWSTR name, SIZE_T size);
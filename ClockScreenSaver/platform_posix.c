@@ -0,0 +1,267 @@
+#define _GNU_SOURCE
+#include "platform.h"
+#include "utf.h"
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+// Milliseconds between 1601-01-01 and 1970-01-01
+#define UNIX_EPOCH_MS 11644473600000LL
+
+static _Thread_local DWORD lastError;
+
+void SetLastError(DWORD error) {
+	lastError = error;
+}
+
+DWORD GetLastError(void) {
+	return lastError;
+}
+
+static void SetLastErrorFromErrno(void) {
+	switch (errno) {
+	case ENOENT:
+		SetLastError(ERROR_FILE_NOT_FOUND);
+		break;
+	case EACCES:
+	case EPERM:
+		SetLastError(ERROR_ACCESS_DENIED);
+		break;
+	case ENOMEM:
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		break;
+	default:
+		SetLastError(ERROR_INVALID_PARAMETER);
+		break;
+	}
+}
+
+static FILE *OpenFile(PCWSTR path, const char *mode) {
+	PSTR pathUtf8 = WideToUtf8String(path);
+	if (!pathUtf8) {
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return NULL;
+	}
+
+	FILE *file = fopen(pathUtf8, mode);
+	if (!file) {
+		SetLastErrorFromErrno();
+	}
+
+	free(pathUtf8);
+	return file;
+}
+
+BOOL ReadFileContents(PCWSTR path, SIZE_T maxSize, PBYTE *data, PSIZE_T size) {
+	FILE *file = OpenFile(path, "rb");
+	if (!file) {
+		return FALSE;
+	}
+
+	// Read in chunks rather than trusting the file size, which also works
+	// for pipes and special files
+	SIZE_T capacity = 4096, total = 0;
+	PBYTE buffer = malloc(capacity);
+	if (!buffer) {
+		fclose(file);
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return FALSE;
+	}
+
+	for (;;) {
+		if (total == capacity) {
+			if (capacity > maxSize) {
+				free(buffer);
+				fclose(file);
+				SetLastError(ERROR_FILE_TOO_LARGE);
+				return FALSE;
+			}
+
+			PBYTE newBuffer = realloc(buffer, capacity * 2);
+			if (!newBuffer) {
+				free(buffer);
+				fclose(file);
+				SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+				return FALSE;
+			}
+			buffer = newBuffer;
+			capacity *= 2;
+		}
+
+		SIZE_T read = fread(buffer + total, 1, capacity - total, file);
+		total += read;
+		if (read == 0) break;
+	}
+
+	BOOL failed = ferror(file);
+	fclose(file);
+
+	if (failed) {
+		free(buffer);
+		SetLastError(ERROR_READ_FAULT);
+		return FALSE;
+	}
+
+	if (total > maxSize) {
+		free(buffer);
+		SetLastError(ERROR_FILE_TOO_LARGE);
+		return FALSE;
+	}
+
+	*data = buffer;
+	*size = total;
+	return TRUE;
+}
+
+BOOL WriteFileContents(PCWSTR path, const BYTE *data, SIZE_T size) {
+	FILE *file = OpenFile(path, "wb");
+	if (!file) {
+		return FALSE;
+	}
+
+	BOOL ok = fwrite(data, 1, size, file) == size;
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok) {
+		SetLastError(ERROR_WRITE_FAULT);
+	}
+	return ok;
+}
+
+LONGLONG GetPlatformUtcTimeMs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return UNIX_EPOCH_MS + (LONGLONG)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+LONGLONG GetPlatformMonotonicTimeMs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (LONGLONG)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+LONGLONG GetPlatformMonotonicTimeUs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (LONGLONG)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+BOOL ResolvePlatformZone(PCWSTR name, PPLATFORM_ZONE zone) {
+	PSTR nameUtf8 = WideToUtf8String(name);
+	if (!nameUtf8) return FALSE;
+
+	// Only accept zones that exist in the time zone database, otherwise the
+	// C library would silently fall back to UTC
+	BOOL ok = FALSE;
+	if (strlen(nameUtf8) < sizeof(zone->name) && !strstr(nameUtf8, "..") && nameUtf8[0] != '/') {
+		char path[256];
+		snprintf(path, sizeof(path), "/usr/share/zoneinfo/%s", nameUtf8);
+		FILE *file = fopen(path, "rb");
+		if (file) {
+			fclose(file);
+			strcpy(zone->name, nameUtf8);
+			ok = TRUE;
+		}
+	}
+
+	free(nameUtf8);
+	return ok;
+}
+
+// The C library only converts times for the zone in the TZ environment
+// variable, so switching zones means changing the environment. This is not
+// thread-safe; callers convert times on a single thread.
+BOOL GetPlatformZoneOffset(const PLATFORM_ZONE *zone, LONGLONG utc, LONGLONG *offset) {
+	char *previous = NULL;
+	if (zone) {
+		const char *tz = getenv("TZ");
+		if (tz) {
+			previous = strdup(tz);
+			if (!previous) return FALSE;
+		}
+		setenv("TZ", zone->name, 1);
+		tzset();
+	}
+
+	LONGLONG ms = utc - UNIX_EPOCH_MS;
+	time_t t = (time_t)(ms >= 0 ? ms / 1000 : -((-ms + 999) / 1000));
+	struct tm tm;
+	BOOL ok = localtime_r(&t, &tm) != NULL;
+	if (ok) {
+		*offset = (LONGLONG)tm.tm_gmtoff * 1000;
+	}
+
+	if (zone) {
+		if (previous) {
+			setenv("TZ", previous, 1);
+			free(previous);
+		}
+		else {
+			unsetenv("TZ");
+		}
+		tzset();
+	}
+
+	return ok;
+}
+
+typedef struct {
+	PLATFORM_THREAD_PROC proc;
+	PVOID param;
+} THREAD_START;
+
+static void *ThreadStart(void *arg) {
+	THREAD_START start = *(THREAD_START *)arg;
+	free(arg);
+	start.proc(start.param);
+	return NULL;
+}
+
+BOOL StartPlatformThread(PPLATFORM_THREAD thread, PLATFORM_THREAD_PROC proc, PVOID param) {
+	THREAD_START *start = malloc(sizeof(THREAD_START));
+	if (!start) {
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return FALSE;
+	}
+	start->proc = proc;
+	start->param = param;
+
+	if (pthread_create(&thread->thread, NULL, ThreadStart, start) != 0) {
+		free(start);
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void JoinPlatformThread(PPLATFORM_THREAD thread) {
+	pthread_join(thread->thread, NULL);
+}
+
+UINT GetPlatformProcessorCount(void) {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (UINT)n : 1;
+}
+
+BOOL GetPlatformHostName(PWSTR name, SIZE_T size) {
+	char host[256];
+	if (gethostname(host, sizeof(host)) != 0) {
+		SetLastErrorFromErrno();
+		return FALSE;
+	}
+	host[sizeof(host) - 1] = '\0';
+
+	PWSTR wide = Utf8ToWideString(host);
+	if (!wide) return FALSE;
+
+	BOOL ok = wcslen(wide) < size;
+	if (ok) {
+		wcscpy(name, wide);
+	}
+	else {
+		SetLastError(ERROR_BUFFER_OVERFLOW);
+	}
+	free(wide);
+	return ok;
+}
@@ -0,0 +1,168 @@
+#include "platform.h"
+
+#pragma comment(lib, "advapi32.lib")
+
+BOOL ReadFileContents(PCWSTR path, SIZE_T maxSize, PBYTE *data, PSIZE_T size) {
+	HANDLE hFile = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return FALSE;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize)) {
+		CloseHandle(hFile);
+		return FALSE;
+	}
+
+	if ((ULONGLONG)fileSize.QuadPart > maxSize || fileSize.QuadPart > MAXDWORD) {
+		CloseHandle(hFile);
+		SetLastError(ERROR_FILE_TOO_LARGE);
+		return FALSE;
+	}
+
+	DWORD fileLen = fileSize.LowPart;
+	PBYTE buffer = malloc(fileLen ? fileLen : 1);
+	if (!buffer) {
+		CloseHandle(hFile);
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return FALSE;
+	}
+
+	// ReadFile may return fewer bytes than requested
+	DWORD total = 0, read;
+	while (total < fileLen) {
+		if (!ReadFile(hFile, buffer + total, fileLen - total, &read, NULL)) {
+			free(buffer);
+			CloseHandle(hFile);
+			return FALSE;
+		}
+		if (read == 0) break;
+		total += read;
+	}
+
+	CloseHandle(hFile);
+
+	*data = buffer;
+	*size = total;
+	return TRUE;
+}
+
+BOOL WriteFileContents(PCWSTR path, const BYTE *data, SIZE_T size) {
+	HANDLE hFile = CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return FALSE;
+	}
+
+	// A short write would leave a truncated file behind
+	DWORD written;
+	BOOL ok = size <= MAXDWORD && WriteFile(hFile, data, (DWORD)size, &written, NULL) && written == size &&
+		FlushFileBuffers(hFile);
+	ok = CloseHandle(hFile) && ok;
+
+	if (!ok) {
+		SetLastError(ERROR_WRITE_FAULT);
+	}
+	return ok;
+}
+
+static LONGLONG FileTimeToMs(const FILETIME *ft) {
+	ULARGE_INTEGER li;
+	li.LowPart = ft->dwLowDateTime;
+	li.HighPart = ft->dwHighDateTime;
+	return (LONGLONG)(li.QuadPart / 10000);
+}
+
+static void MsToFileTime(LONGLONG ms, FILETIME *ft) {
+	ULARGE_INTEGER li;
+	li.QuadPart = (ULONGLONG)ms * 10000;
+	ft->dwLowDateTime = li.LowPart;
+	ft->dwHighDateTime = li.HighPart;
+}
+
+LONGLONG GetPlatformUtcTimeMs(void) {
+	FILETIME ft;
+	GetSystemTimeAsFileTime(&ft);
+	return FileTimeToMs(&ft);
+}
+
+LONGLONG GetPlatformMonotonicTimeMs(void) {
+	static LARGE_INTEGER frequency;
+	if (!frequency.QuadPart) {
+		QueryPerformanceFrequency(&frequency);
+	}
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart * 1000 / frequency.QuadPart;
+}
+
+LONGLONG GetPlatformMonotonicTimeUs(void) {
+	static LARGE_INTEGER frequency;
+	if (!frequency.QuadPart) {
+		QueryPerformanceFrequency(&frequency);
+	}
+
+	// Split the conversion so that it does not overflow
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart / frequency.QuadPart * 1000000 +
+		counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart;
+}
+
+BOOL ResolvePlatformZone(PCWSTR name, PPLATFORM_ZONE zone) {
+	DYNAMIC_TIME_ZONE_INFORMATION dtzi;
+	for (DWORD i = 0; EnumDynamicTimeZoneInformation(i, &dtzi) == ERROR_SUCCESS; i++) {
+		if (_wcsicmp(name, dtzi.TimeZoneKeyName) == 0 || _wcsicmp(name, dtzi.StandardName) == 0) {
+			zone->dtzi = dtzi;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+BOOL GetPlatformZoneOffset(const PLATFORM_ZONE *zone, LONGLONG utc, LONGLONG *offset) {
+	FILETIME ftUtc, ftLocal;
+	SYSTEMTIME stUtc, stLocal;
+	BOOL ok;
+
+	MsToFileTime(utc, &ftUtc);
+	if (!FileTimeToSystemTime(&ftUtc, &stUtc)) {
+		return FALSE;
+	}
+
+	if (zone) {
+		ok = SystemTimeToTzSpecificLocalTimeEx(&zone->dtzi, &stUtc, &stLocal);
+	}
+	else {
+		ok = SystemTimeToTzSpecificLocalTime(NULL, &stUtc, &stLocal);
+	}
+
+	if (!ok || !SystemTimeToFileTime(&stLocal, &ftLocal)) {
+		return FALSE;
+	}
+
+	*offset = FileTimeToMs(&ftLocal) - utc;
+	return TRUE;
+}
+
+BOOL StartPlatformThread(PPLATFORM_THREAD thread, PLATFORM_THREAD_PROC proc, PVOID param) {
+	thread->handle = CreateThread(NULL, 0, proc, param, 0, NULL);
+	return thread->handle != NULL;
+}
+
+void JoinPlatformThread(PPLATFORM_THREAD thread) {
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+	thread->handle = NULL;
+}
+
+UINT GetPlatformProcessorCount(void) {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors ? info.dwNumberOfProcessors : 1;
+}
+
+BOOL GetPlatformHostName(PWSTR name, SIZE_T size) {
+	DWORD length = (DWORD)min(size, MAXDWORD);
+	return GetComputerNameW(name, &length);
+}
@@ -0,0 +1,354 @@
+#include "profiles.h"
+
+#include <wctype.h>
+
+#define PREFIX_LENGTH (sizeof(PROFILE_PREFIX) / sizeof(WCHAR) - 1)
+
+// Marks properties that are not part of the set
+#define NO_PROFILE MAXUINT
+// Marks properties outside of any profile
+#define BASE_PROFILE (MAXUINT - 1)
+
+// FNV-1a over the first length characters of a name, ignoring case if fold
+// is TRUE
+static UINT HashName(PCWSTR name, SIZE_T length, BOOL fold) {
+	UINT hash = 2166136261u;
+	for (SIZE_T i = 0; i < length; i++) {
+		hash = (hash ^ (UINT)(fold ? towlower(name[i]) : name[i])) * 16777619u;
+	}
+	return hash;
+}
+
+// Smallest power of two slots that keeps a table at most half full
+static UINT GetTableSlots(UINT count) {
+	UINT slots = 16;
+	while (slots < count * 2) {
+		slots *= 2;
+	}
+	return slots;
+}
+
+// Matches a host name against a pattern in which '*' matches any characters,
+// ignoring case
+static BOOL MatchHost(PCWSTR pattern, PCWSTR host) {
+	PCWSTR star = NULL, resume = NULL;
+	while (*host) {
+		if (*pattern == '*') {
+			star = pattern++;
+			resume = host;
+		}
+		else if (*pattern && towlower(*pattern) == towlower(*host)) {
+			pattern++;
+			host++;
+		}
+		else if (star) {
+			pattern = star + 1;
+			host = ++resume;
+		}
+		else {
+			return FALSE;
+		}
+	}
+	while (*pattern == '*') {
+		pattern++;
+	}
+	return *pattern == '\0';
+}
+
+static BOOL IsExactHost(PCWSTR host) {
+	return host && !wcschr(host, '*');
+}
+
+// Parses a selector into profile. Returns FALSE if the value is invalid, or
+// if key is not a selector, in which case *isSelector is FALSE.
+static BOOL ParseSelector(PPROFILE profile, PCWSTR key, PWSTR value, PBOOL isSelector) {
+	int width, height;
+	WCHAR extra;
+
+	*isSelector = TRUE;
+	if (wcscmp(key, L"host") == 0) {
+		profile->host = value;
+		return value[0] != '\0';
+	}
+	if (wcscmp(key, L"monitor") == 0) {
+		return ParseUIntValue(value, &profile->monitor) && profile->monitor > 0;
+	}
+	if (wcscmp(key, L"resolution") == 0) {
+		if (swscanf(value, L"%dx%d%lc", &width, &height, &extra) != 2 || width <= 0 || height <= 0) {
+			return FALSE;
+		}
+		profile->width = width;
+		profile->height = height;
+		return TRUE;
+	}
+
+	*isSelector = FALSE;
+	return FALSE;
+}
+
+// Finds or adds the profile with the given name in a table of profile
+// indices plus one, which has room for every property.
+static UINT FindProfile(PPROFILE_SET set, PUINT names, UINT slots, PPROPERTIES props, PUINT firstProps,
+	PCWSTR name, SIZE_T length, UINT propIndex) {
+	UINT mask = slots - 1;
+	UINT slot = HashName(name, length, FALSE) & mask;
+	for (; names[slot]; slot = (slot + 1) & mask) {
+		UINT profile = names[slot] - 1;
+		PCWSTR other = props->items[firstProps[profile]].name + PREFIX_LENGTH;
+		if (wcsncmp(other, name, length) == 0 && other[length] == '.') {
+			return profile;
+		}
+	}
+
+	UINT profile = set->nProfiles++;
+	firstProps[profile] = propIndex;
+	names[slot] = profile + 1;
+	return profile;
+}
+
+// Adds a profile with an exact host selector to the host index, after the
+// profiles with the same host.
+static void IndexHost(PPROFILE_SET set, UINT profile) {
+	PCWSTR host = set->profiles[profile].host;
+	UINT mask = set->hostSlots - 1;
+	UINT slot = HashName(host, wcslen(host), TRUE) & mask;
+	for (; set->hostIndex[slot]; slot = (slot + 1) & mask) {
+		UINT first = set->hostIndex[slot] - 1;
+		if (_wcsicmp(set->profiles[first].host, host) == 0) {
+			while (set->profiles[first].nextSameHost) {
+				first = set->profiles[first].nextSameHost - 1;
+			}
+			set->profiles[first].nextSameHost = profile + 1;
+			return;
+		}
+	}
+	set->hostIndex[slot] = profile + 1;
+}
+
+// Returns the first profile, plus one, whose exact host selector is host.
+static UINT FindHost(const PROFILE_SET *set, PCWSTR host) {
+	if (!host || !set->hostSlots) return 0;
+
+	UINT mask = set->hostSlots - 1;
+	UINT slot = HashName(host, wcslen(host), TRUE) & mask;
+	for (; set->hostIndex[slot]; slot = (slot + 1) & mask) {
+		UINT first = set->hostIndex[slot] - 1;
+		if (_wcsicmp(set->profiles[first].host, host) == 0) {
+			return first + 1;
+		}
+	}
+	return 0;
+}
+
+// Scratch space of IndexProfiles: the profile and setting of every property,
+// the first property of every profile and a table of profile names
+typedef struct {
+	PUINT owners;
+	SETTING_ID *ids;
+	PUINT firstProps;
+	PUINT names;
+	UINT nameSlots;
+} INDEX_SCRATCH, *PINDEX_SCRATCH;
+
+// Assigns properties to profiles and parses the selectors
+static void AssignProperties(PPROFILE_SET set, PPROPERTIES props, PINDEX_SCRATCH scratch, PWSTR *rejected,
+	UINT maxRejected, PUINT nRejected) {
+	for (UINT i = 0; i < props->count; i++) {
+		PPROPERTY prop = &props->items[i];
+		scratch->owners[i] = NO_PROFILE;
+
+		if (wcsncmp(prop->name, PROFILE_PREFIX, PREFIX_LENGTH) != 0) {
+			if (FindSetting(prop->name, &scratch->ids[i])) {
+				scratch->owners[i] = BASE_PROFILE;
+				set->nBaseEntries++;
+			}
+			continue;
+		}
+
+		PCWSTR name = prop->name + PREFIX_LENGTH;
+		PCWSTR key = wcschr(name, '.');
+		if (!key || key == name || !key[1]) continue;
+		key++;
+
+		UINT profile = FindProfile(set, scratch->names, scratch->nameSlots, props, scratch->firstProps, name,
+			key - 1 - name, i);
+		BOOL isSelector;
+		if (ParseSelector(&set->profiles[profile], key, prop->value, &isSelector)) continue;
+
+		if (isSelector) {
+			set->profiles[profile].invalid = TRUE;
+			if (*nRejected < maxRejected) {
+				rejected[*nRejected] = prop->name;
+			}
+			(*nRejected)++;
+		}
+		else if (FindSetting(key, &scratch->ids[i])) {
+			scratch->owners[i] = profile;
+			set->profiles[profile].nEntries++;
+		}
+	}
+}
+
+// Lays out the entries of each profile after the base entries, in the order
+// of the properties, and indexes the profiles.
+static BOOL LayOutEntries(PPROFILE_SET set, PPROPERTIES props, PINDEX_SCRATCH scratch) {
+	UINT next = set->nBaseEntries;
+	UINT nExactHosts = 0;
+	for (UINT p = 0; p < set->nProfiles; p++) {
+		set->profiles[p].firstEntry = next;
+		next += set->profiles[p].nEntries;
+		set->profiles[p].nEntries = 0;
+		nExactHosts += IsExactHost(set->profiles[p].host);
+	}
+
+	set->entries = malloc(max(next, 1) * sizeof(PROFILE_ENTRY));
+	set->hostSlots = GetTableSlots(nExactHosts);
+	set->hostIndex = calloc(set->hostSlots, sizeof(UINT));
+	set->others = malloc(max(set->nProfiles, 1) * sizeof(UINT));
+	if (!set->entries || !set->hostIndex || !set->others) {
+		return FALSE;
+	}
+
+	UINT nBase = 0;
+	for (UINT i = 0; i < props->count; i++) {
+		PPROFILE_ENTRY entry;
+		if (scratch->owners[i] == BASE_PROFILE) {
+			entry = &set->entries[nBase++];
+		}
+		else if (scratch->owners[i] != NO_PROFILE) {
+			PPROFILE profile = &set->profiles[scratch->owners[i]];
+			entry = &set->entries[profile->firstEntry + profile->nEntries++];
+		}
+		else {
+			continue;
+		}
+
+		entry->id = scratch->ids[i];
+		entry->value = props->items[i].value;
+		entry->name = props->items[i].name;
+		set->nEntries++;
+	}
+
+	for (UINT p = 0; p < set->nProfiles; p++) {
+		if (IsExactHost(set->profiles[p].host)) {
+			IndexHost(set, p);
+		}
+		else {
+			set->others[set->nOthers++] = p;
+		}
+	}
+	return TRUE;
+}
+
+BOOL IndexProfiles(PPROFILE_SET set, PPROPERTIES props, PWSTR *rejected, UINT maxRejected, PUINT nRejected) {
+	ZeroMemory(set, sizeof(PROFILE_SET));
+	*nRejected = 0;
+
+	SIZE_T count = max(props->count, 1);
+	INDEX_SCRATCH scratch;
+	scratch.nameSlots = GetTableSlots(props->count);
+	scratch.owners = malloc(count * sizeof(UINT));
+	scratch.ids = malloc(count * sizeof(SETTING_ID));
+	scratch.firstProps = malloc(count * sizeof(UINT));
+	scratch.names = calloc(scratch.nameSlots, sizeof(UINT));
+	set->profiles = calloc(count, sizeof(PROFILE));
+
+	BOOL ok = scratch.owners && scratch.ids && scratch.firstProps && scratch.names && set->profiles;
+	if (ok) {
+		AssignProperties(set, props, &scratch, rejected, maxRejected, nRejected);
+		ok = LayOutEntries(set, props, &scratch);
+	}
+
+	free(scratch.owners);
+	free(scratch.ids);
+	free(scratch.firstProps);
+	free(scratch.names);
+
+	if (!ok) {
+		FreeProfiles(set);
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+	}
+	return ok;
+}
+
+void FreeProfiles(PPROFILE_SET set) {
+	free(set->entries);
+	free(set->profiles);
+	free(set->hostIndex);
+	free(set->others);
+	ZeroMemory(set, sizeof(PROFILE_SET));
+}
+
+static BOOL ProfileMatches(const PROFILE *profile, const PROFILE_TARGET *target) {
+	if (profile->invalid) return FALSE;
+
+	if (profile->host && (!target->host || !MatchHost(profile->host, target->host))) return FALSE;
+	if (profile->monitor && profile->monitor != target->monitor) return FALSE;
+	if (profile->width && (profile->width != target->width || profile->height != target->height)) return FALSE;
+	return TRUE;
+}
+
+// Calls proc for each profile that applies to target, in order, and returns
+// how many did.
+static UINT ForEachMatchingProfile(const PROFILE_SET *set, const PROFILE_TARGET *target,
+	void (*proc)(const PROFILE_SET *set, const PROFILE *profile, PVOID context), PVOID context) {
+	// Merge the profiles found by host name with the others, which are both
+	// in ascending order
+	UINT host = FindHost(set, target->host), other = 0, nMatches = 0;
+	while (host || other < set->nOthers) {
+		UINT p;
+		if (host && (other == set->nOthers || host - 1 < set->others[other])) {
+			p = host - 1;
+			host = set->profiles[p].nextSameHost;
+		}
+		else {
+			p = set->others[other++];
+		}
+
+		if (ProfileMatches(&set->profiles[p], target)) {
+			if (proc) {
+				proc(set, &set->profiles[p], context);
+			}
+			nMatches++;
+		}
+	}
+	return nMatches;
+}
+
+typedef struct {
+	PSETTINGS settings;
+	PWSTR *rejected;
+	UINT maxRejected;
+	UINT nRejected;
+} APPLY_CONTEXT, *PAPPLY_CONTEXT;
+
+static void ApplyEntries(PAPPLY_CONTEXT context, const PROFILE_ENTRY *entries, UINT count) {
+	for (UINT i = 0; i < count; i++) {
+		if (!ApplySetting(context->settings, entries[i].id, entries[i].value)) {
+			if (context->nRejected < context->maxRejected) {
+				context->rejected[context->nRejected] = entries[i].name;
+			}
+			context->nRejected++;
+		}
+	}
+}
+
+static void ApplyProfile(const PROFILE_SET *set, const PROFILE *profile, PVOID context) {
+	ApplyEntries(context, set->entries + profile->firstEntry, profile->nEntries);
+}
+
+UINT ResolveProfileSettings(const PROFILE_SET *set, const PROFILE_TARGET *target, PSETTINGS settings,
+	PWSTR *rejected, UINT maxRejected) {
+	APPLY_CONTEXT context = { settings, rejected, maxRejected, 0 };
+
+	RestoreDefaultSettings(settings);
+	ApplyEntries(&context, set->entries, set->nBaseEntries);
+	ForEachMatchingProfile(set, target, ApplyProfile, &context);
+	CompleteSettings(settings);
+
+	return context.nRejected;
+}
+
+UINT CountMatchingProfiles(const PROFILE_SET *set, const PROFILE_TARGET *target) {
+	return ForEachMatchingProfile(set, target, NULL, NULL);
+}
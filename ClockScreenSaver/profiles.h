@@ -0,0 +1,90 @@
+#pragma once
+
+#include "platform.h"
+#include "properties.h"
+#include "settings.h"
+
+// One configuration file for many machines. Properties outside of profiles
+// apply everywhere. The properties of a profile, profile.<name>.<key>, apply
+// on top of them where all selectors of the profile match:
+//
+//   profile.<name>.host=LOBBY-*             host name, '*' matches anything
+//   profile.<name>.monitor=2                one-based index of the monitor, 1 is
+//                                           the primary one
+//   profile.<name>.resolution=3840x2160     size of the monitor in pixels
+//
+// Host names are compared without regard to case. A profile without
+// selectors applies everywhere. Where several profiles apply, they are
+// applied in the order in which they first appear in the file.
+#define PROFILE_PREFIX L"profile."
+
+typedef struct {
+	SETTING_ID id;
+	PWSTR value;
+	PWSTR name;
+} PROFILE_ENTRY, *PPROFILE_ENTRY;
+
+typedef struct {
+	// Selectors, NULL or zero if not given
+	PCWSTR host;
+	UINT monitor;
+	int width;
+	int height;
+
+	// An invalid selector makes the profile never apply
+	BOOL invalid;
+
+	// The profile's settings in entries
+	UINT firstEntry;
+	UINT nEntries;
+
+	// Next profile with the same exact host selector, plus one
+	UINT nextSameHost;
+} PROFILE, *PPROFILE;
+
+// Profiles parsed from properties, with the keys already resolved to
+// settings, so that resolving the settings for a monitor only touches the
+// profiles that apply. Profiles selected by an exact host name are found
+// through a hash index; only the others are checked one by one.
+typedef struct {
+	PPROFILE_ENTRY entries;
+	UINT nEntries;
+	// Entries outside of any profile come first
+	UINT nBaseEntries;
+
+	PPROFILE profiles;
+	UINT nProfiles;
+
+	// Open-addressing table of the first profile, plus one, for each exact
+	// host name
+	PUINT hostIndex;
+	UINT hostSlots;
+
+	// Profiles without an exact host selector, in order
+	PUINT others;
+	UINT nOthers;
+} PROFILE_SET, *PPROFILE_SET;
+
+// What to resolve the settings for. host may be NULL, zeros are unknown
+// values, which selectors never match.
+typedef struct {
+	PCWSTR host;
+	UINT monitor;
+	int width;
+	int height;
+} PROFILE_TARGET, *PPROFILE_TARGET;
+
+// Indexes the properties in props, which must outlive the set. Stores up to
+// maxRejected names of invalid selectors in rejected and their number in
+// nRejected. Fails only if memory runs out.
+BOOL IndexProfiles(PPROFILE_SET set, PPROPERTIES props, PWSTR *rejected, UINT maxRejected, PUINT nRejected);
+
+void FreeProfiles(PPROFILE_SET set);
+
+// Like PropertiesToSettings, for the profiles that apply to target. Returns
+// the number of rejected values.
+UINT ResolveProfileSettings(const PROFILE_SET *set, const PROFILE_TARGET *target, PSETTINGS settings,
+	PWSTR *rejected, UINT maxRejected);
+
+// Returns the number of profiles that apply to target.
+UINT CountMatchingProfiles(const PROFILE_SET *set, const PROFILE_TARGET *target);
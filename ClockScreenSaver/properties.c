@@ -1,4 +1,6 @@
 #include "properties.h"
+#include "memusage.h"
+#include "utf.h"
 
 static BOOL IsKeyChar(WCHAR c) {
 	if (c >= 'A' && c <= 'Z') return TRUE;
@@ -7,9 +9,19 @@ static BOOL IsKeyChar(WCHAR c) {
 	return (c == '_' || c == '.' || c == '-');
 }
 
+// Bytes held for the strings of a property, and for the items and the index
+static LONGLONG StringBytes(PCWSTR str) {
+	return (wcslen(str) + 1) * sizeof(WCHAR);
+}
+
+static LONGLONG CapacityBytes(UINT capacity) {
+	return (LONGLONG)capacity * (sizeof(PROPERTY) + 2 * sizeof(UINT));
+}
+
 void FreeProperties(PPROPERTIES props) {
 	if (props->items) {
 		for (UINT i = 0; i < props->count; i++) {
+			TrackMemory(MEMORY_PROPERTIES, -StringBytes(props->items[i].name) - StringBytes(props->items[i].value));
 			free(props->items[i].name);
 			free(props->items[i].value);
 		}
@@ -17,11 +29,43 @@ void FreeProperties(PPROPERTIES props) {
 		free(props->items);
 		props->items = NULL;
 	}
+	free(props->index);
+	props->index = NULL;
+	TrackMemory(MEMORY_PROPERTIES, -CapacityBytes(props->capacity));
 	props->count = 0;
+	props->capacity = 0;
+}
+
+// FNV-1a over the characters of a property name
+static UINT HashName(PCWSTR name) {
+	UINT hash = 2166136261u;
+	for (; *name; name++) {
+		hash = (hash ^ (UINT)*name) * 16777619u;
+	}
+	return hash;
+}
+
+// The index is an open-addressing hash table of capacity * 2 slots. Each slot
+// holds one plus the position of a property in items, or zero if it is empty.
+static UINT IndexSlots(PPROPERTIES props) {
+	return props->capacity * 2;
 }
 
-static BOOL FindProperty(PPROPERTIES props, PWSTR name, PUINT index) {
-	for (*index = 0; *index < props->count; (*index)++) {
+static void InsertIntoIndex(PPROPERTIES props, UINT itemIndex) {
+	UINT mask = IndexSlots(props) - 1;
+	UINT slot = HashName(props->items[itemIndex].name) & mask;
+	while (props->index[slot]) {
+		slot = (slot + 1) & mask;
+	}
+	props->index[slot] = itemIndex + 1;
+}
+
+static BOOL FindProperty(PPROPERTIES props, PCWSTR name, PUINT index) {
+	if (!props->index) return FALSE;
+
+	UINT mask = IndexSlots(props) - 1;
+	for (UINT slot = HashName(name) & mask; props->index[slot]; slot = (slot + 1) & mask) {
+		*index = props->index[slot] - 1;
 		if (wcscmp(name, props->items[*index].name) == 0) {
 			return TRUE;
 		}
@@ -29,37 +73,68 @@ static BOOL FindProperty(PPROPERTIES props, PWSTR name, PUINT index) {
 	return FALSE;
 }
 
-BOOL SetPropertyInternal(PPROPERTIES props, PWSTR name, PWSTR value) {
+// Makes room for at least one more property.
+static BOOL GrowProperties(PPROPERTIES props) {
+	if (props->count < props->capacity) {
+		return TRUE;
+	}
+
+	// Capacities are powers of two so that the index can use a mask
+	UINT newCapacity = props->capacity ? props->capacity * 2 : 16;
+	PPROPERTY newItems = realloc(props->items, newCapacity * sizeof(PROPERTY));
+	if (!newItems) {
+		return FALSE;
+	}
+	props->items = newItems;
+
+	PUINT newIndex = calloc(newCapacity * 2, sizeof(UINT));
+	if (!newIndex) {
+		return FALSE;
+	}
+	free(props->index);
+	props->index = newIndex;
+	TrackMemory(MEMORY_PROPERTIES, CapacityBytes(newCapacity) - CapacityBytes(props->capacity));
+	props->capacity = newCapacity;
+
+	// Rebuild the index
+	for (UINT i = 0; i < props->count; i++) {
+		InsertIntoIndex(props, i);
+	}
+
+	return TRUE;
+}
+
+// Takes ownership of name and value, even if it fails.
+static BOOL SetPropertyInternal(PPROPERTIES props, PWSTR name, PWSTR value) {
+	if (!name || !value) {
+		free(name);
+		free(value);
+		return FALSE;
+	}
+
 	// If a property with the same name already exists, replace its value
 	UINT propIndex;
 	if (FindProperty(props, name, &propIndex)) {
+		free(name);
+		TrackMemory(MEMORY_PROPERTIES, StringBytes(value) - StringBytes(props->items[propIndex].value));
 		free(props->items[propIndex].value);
 		props->items[propIndex].value = value;
 		return TRUE;
 	}
 
 	// Otherwise, we need to add a new property
-
-	// Allocate new array
-	PPROPERTY newItems = calloc(1 + props->count, sizeof(PROPERTY));
-	if (!newItems) {
+	if (!GrowProperties(props)) {
+		free(name);
+		free(value);
 		return FALSE;
 	}
 
-	// Copy previous properties
-	if (props->items) {
-		memcpy(newItems, props->items, sizeof(PROPERTY) * props->count);
-		free(props->items);
-	}
-
-	// Add new property
-	newItems[props->count].name = name;
-	newItems[props->count].value = value;
+	props->items[props->count].name = name;
+	props->items[props->count].value = value;
+	TrackMemory(MEMORY_PROPERTIES, StringBytes(name) + StringBytes(value));
+	InsertIntoIndex(props, props->count);
 	props->count++;
 
-	// Replace old properties pointer
-	props->items = newItems;
-
 	return TRUE;
 }
 
@@ -75,22 +150,51 @@ PWSTR GetProperty(PPROPERTIES props, PWSTR name) {
 	return NULL;
 }
 
+BOOL RemoveProperty(PPROPERTIES props, PWSTR name) {
+	UINT propIndex;
+	if (!FindProperty(props, name, &propIndex)) {
+		return FALSE;
+	}
+
+	PPROPERTY prop = &props->items[propIndex];
+	TrackMemory(MEMORY_PROPERTIES, -StringBytes(prop->name) - StringBytes(prop->value));
+	free(prop->name);
+	free(prop->value);
+
+	// The properties after it move down, so rebuild the index
+	props->count--;
+	MoveMemory(prop, prop + 1, (props->count - propIndex) * sizeof(PROPERTY));
+	ZeroMemory(props->index, IndexSlots(props) * sizeof(UINT));
+	for (UINT i = 0; i < props->count; i++) {
+		InsertIntoIndex(props, i);
+	}
+
+	return TRUE;
+}
+
 BOOL SetUIntProperty(PPROPERTIES props, PWSTR name, UINT value) {
-	WCHAR val[128];
-	wsprintf(val, L"%u", value);
+	WCHAR val[16];
+	swprintf(val, 16, L"%u", value);
 	return SetProperty(props, name, val);
 }
 
+BOOL ParseUIntValue(PCWSTR str, PUINT value) {
+	if (*str < '0' || *str > '9') return FALSE;
+
+	ULONGLONG v = 0;
+	for (; *str >= '0' && *str <= '9'; str++) {
+		v = v * 10 + (*str - '0');
+		if (v > MAXUINT) return FALSE;
+	}
+	if (*str) return FALSE;
+
+	*value = (UINT)v;
+	return TRUE;
+}
+
 BOOL GetUIntProperty(PPROPERTIES props, PWSTR name, PUINT value) {
 	PWSTR val = GetProperty(props, name);
-	if (val) {
-		PWSTR end;
-		*value = wcstoul(val, &end, 10);
-		if (!*end) {
-			return TRUE;
-		}
-	}
-	return FALSE;
+	return val && ParseUIntValue(val, value);
 }
 
 static void ByteToHex(PWSTR str, BYTE b) {
@@ -99,15 +203,12 @@ static void ByteToHex(PWSTR str, BYTE b) {
 	str[2] = '\0';
 }
 
-static BYTE HexDigitToByte(WCHAR c) {
+// Returns the value of a hex digit or -1 if c is not one
+static int HexDigitToInt(WCHAR c) {
 	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
 	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
 	if (c >= '0' && c <= '9') return c - '0';
-	return 0;
-}
-
-static BYTE HexToByte(PWSTR str) {
-	return (HexDigitToByte(str[0]) << 4) | HexDigitToByte(str[1]);
+	return -1;
 }
 
 BOOL SetRgbProperty(PPROPERTIES props, PWSTR name, COLORREF value) {
@@ -119,32 +220,36 @@ BOOL SetRgbProperty(PPROPERTIES props, PWSTR name, COLORREF value) {
 	return SetProperty(props, name, val);
 }
 
-BOOL GetRgbProperty(PPROPERTIES props, PWSTR name, LPCOLORREF value) {
-	PWSTR val = GetProperty(props, name);
-	if (!val) return FALSE;
-	if (wcslen(val) < 6) return FALSE;
-
-	BYTE r = HexToByte(val + 0);
-	BYTE g = HexToByte(val + 2);
-	BYTE b = HexToByte(val + 4);
-	*value = RGB(r, g, b);
+BOOL ParseRgbValue(PCWSTR str, LPCOLORREF value) {
+	BYTE rgb[3];
+	for (UINT i = 0; i < 3; i++) {
+		int hi = HexDigitToInt(str[2 * i]);
+		if (hi < 0) return FALSE;
+		int lo = HexDigitToInt(str[2 * i + 1]);
+		if (lo < 0) return FALSE;
+		rgb[i] = (BYTE)((hi << 4) | lo);
+	}
+	if (str[6]) return FALSE;
 
+	*value = RGB(rgb[0], rgb[1], rgb[2]);
 	return TRUE;
 }
 
+BOOL GetRgbProperty(PPROPERTIES props, PWSTR name, LPCOLORREF value) {
+	PWSTR val = GetProperty(props, name);
+	return val && ParseRgbValue(val, value);
+}
+
 BOOL SetBoolProperty(PPROPERTIES props, PWSTR name, BOOL value) {
 	return SetProperty(props, name, value ? L"yes" : L"no");
 }
 
-BOOL GetBoolProperty(PPROPERTIES props, PWSTR name, PBOOL value) {
-	PWSTR val = GetProperty(props, name);
-	if (!val) return FALSE;
-
-	if (_wcsicmp(val, L"yes") * _wcsicmp(val, L"true") == 0) {
+BOOL ParseBoolValue(PCWSTR str, PBOOL value) {
+	if (_wcsicmp(str, L"yes") == 0 || _wcsicmp(str, L"true") == 0) {
 		*value = TRUE;
 		return TRUE;
 	}
-	else if (_wcsicmp(val, L"no") * _wcsicmp(val, L"false") == 0) {
+	else if (_wcsicmp(str, L"no") == 0 || _wcsicmp(str, L"false") == 0) {
 		*value = FALSE;
 		return TRUE;
 	}
@@ -153,169 +258,143 @@ BOOL GetBoolProperty(PPROPERTIES props, PWSTR name, PBOOL value) {
 	}
 }
 
-// This function actually null-terminates the result
-static PWSTR ConvertUtf8ToUtf16(const PCHAR str, const int szIn, PUINT charsOut) {
-	int reqSize = MultiByteToWideChar(CP_UTF8, 0, str, szIn, NULL, 0);
-	PWSTR wstr = calloc(reqSize + 1, sizeof(WCHAR));
-	if (!wstr) return NULL;
+BOOL GetBoolProperty(PPROPERTIES props, PWSTR name, PBOOL value) {
+	PWSTR val = GetProperty(props, name);
+	return val && ParseBoolValue(val, value);
+}
 
-	*charsOut = MultiByteToWideChar(CP_UTF8, 0, str, szIn, wstr, reqSize);
-	return wstr;
+static BOOL IsLineSpace(WCHAR c) {
+	return c != '\n' && iswspace(c);
 }
 
-// This function does not necessarily null-terminate the result
-static PSTR ConvertUtf16ToUtf8(const PWSTR wstr, const int szIn, PUINT bytesOut) {
-	int reqSize = WideCharToMultiByte(CP_UTF8, 0, wstr, szIn, NULL, 0, NULL, NULL);
-	PSTR str = calloc(reqSize, sizeof(CHAR));
+static PWSTR CopyRange(PCWSTR start, SIZE_T len) {
+	PWSTR str = malloc((len + 1) * sizeof(WCHAR));
 	if (!str) return NULL;
 
-	*bytesOut = WideCharToMultiByte(CP_UTF8, 0, wstr, szIn, str, reqSize, NULL, NULL);
+	CopyMemory(str, start, len * sizeof(WCHAR));
+	str[len] = '\0';
 	return str;
 }
 
-BOOL ReadProperties(PPROPERTIES props, PWSTR path) {
-	HANDLE hFile = CreateFile(path, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-	if (hFile == INVALID_HANDLE_VALUE) {
-		return FALSE;
-	}
-
-	LARGE_INTEGER fileSize;
-	if (!GetFileSizeEx(hFile, &fileSize)) {
+BOOL ParseProperties(PPROPERTIES props, const BYTE *data, SIZE_T size) {
+	SIZE_T dataLen;
+	PWSTR text = DecodeText(data, size, &dataLen);
+	if (!text) {
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
 		return FALSE;
 	}
 
-	PCHAR dataUtf8 = calloc(fileSize.LowPart + 1, sizeof(CHAR));
-	if (!dataUtf8) {
-		return FALSE;
-	}
-
-	DWORD read;
-	if (!ReadFile(hFile, dataUtf8, fileSize.LowPart, &read, NULL)) {
-		free(dataUtf8);
-		return FALSE;
-	}
-
-	CloseHandle(hFile);
-
-	UINT dataLen;
-	PWSTR data = ConvertUtf8ToUtf16(dataUtf8, fileSize.LowPart, &dataLen);
-	free(dataUtf8);
-
-	UINT i = 0, j, k, l, m;
+	SIZE_T i = 0, j, k, l;
 	while (i < dataLen) {
-		// Skip leading whitespace
-		while (data[i] && iswspace(data[i])) i++;
+		// Skip leading whitespace, including empty lines
+		while (i < dataLen && iswspace(text[i])) i++;
 
-		if (!data[i]) break;
+		if (i == dataLen) break;
 
-		// Read property name
-		j = i + 1;
-		while (data[j] && IsKeyChar(data[j])) j++;
-		if (j == i) {
-			free(data);
-			SetLastError(ERROR_INVALID_DATA);
-			return FALSE;
+		// Skip comments
+		if (text[i] == '#') {
+			while (i < dataLen && text[i] != '\n') i++;
+			continue;
 		}
 
-		if (!data[j]) {
-			SetLastError(ERROR_INVALID_DATA);
-			return FALSE;
-		}
+		// Read property name
+		j = i;
+		while (j < dataLen && IsKeyChar(text[j])) j++;
 
 		// Skip spaces
 		k = j;
-		while (data[k] && iswspace(data[k])) k++;
-
-		if (!data[k]) {
-			SetLastError(ERROR_INVALID_DATA);
-			return FALSE;
-		}
+		while (k < dataLen && IsLineSpace(text[k])) k++;
 
-		// Expect '='
-		if (data[k++] != '=') {
-			free(data);
+		// Expect a non-empty name followed by '='
+		if (j == i || k == dataLen || text[k] != '=') {
+			free(text);
 			SetLastError(ERROR_INVALID_DATA);
 			return FALSE;
 		}
+		k++;
 
 		// Skip spaces
-		while (data[k] && data[k] != '\n' && iswspace(data[k])) k++;
+		while (k < dataLen && IsLineSpace(text[k])) k++;
 
-		if (!data[k]) {
-			SetLastError(ERROR_INVALID_DATA);
-			return FALSE;
-		}
-
-		// Read value
+		// Read value, which may be empty
 		l = k;
-		while (data[l] != '\n' && data[l]) l++;
+		while (l < dataLen && text[l] != '\n') l++;
+
+		// Continue after the end of the line
+		SIZE_T next = l;
 
 		// Remove trailing whitespace from value (including CRLF)
-		m = l;
-		while (iswspace(data[l - 1])) l--;
+		while (l > k && iswspace(text[l - 1])) l--;
 
-		// Copy name into string
-		PWSTR name = calloc(j - i + 1, sizeof(WCHAR));
-		if (!name) {
-			free(data);
+		// Save property
+		if (!SetPropertyInternal(props, CopyRange(text + i, j - i), CopyRange(text + k, l - k))) {
+			free(text);
+			SetLastError(ERROR_NOT_ENOUGH_MEMORY);
 			return FALSE;
 		}
-		wcsncpy_s(name, j - i + 1, data + i, j - i);
 
-		// Copy value into string
-		PWSTR value = calloc(l - k + 1, sizeof(WCHAR));
-		if (!value) {
-			free(data);
-			return FALSE;
-		}
-		wcsncpy_s(value, l - k + 1, data + k, l - k);
+		i = next;
+	}
 
-		// Save property
-		SetPropertyInternal(props, name, value);
+	free(text);
+
+	return TRUE;
+}
 
-		// Skip to end of line
-		i = m;
+// Configuration files are tiny, anything beyond this is not one
+#define MAX_PROPERTIES_FILE_SIZE (16 * 1024 * 1024)
+
+BOOL ReadProperties(PPROPERTIES props, PWSTR path) {
+	PBYTE data;
+	SIZE_T size;
+	if (!ReadFileContents(path, MAX_PROPERTIES_FILE_SIZE, &data, &size)) {
+		return FALSE;
 	}
 
+	BOOL ret = ParseProperties(props, data, size);
 	free(data);
 
-	return TRUE;
+	return ret;
 }
 
 BOOL WriteProperties(PPROPERTIES props, PWSTR path) {
-	HANDLE hFile = CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-	if (hFile == INVALID_HANDLE_VALUE) {
+	// Build the whole file so that it can be written at once
+	SIZE_T textLen = 0;
+	for (UINT i = 0; i < props->count; i++) {
+		textLen += wcslen(props->items[i].name) + 1 + wcslen(props->items[i].value) + 1;
+	}
+
+	PWSTR text = malloc((textLen + 1) * sizeof(WCHAR));
+	if (!text) {
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
 		return FALSE;
 	}
 
+	// Copy each line into place rather than appending, which would rescan
+	// the text for every property
+	SIZE_T pos = 0;
 	for (UINT i = 0; i < props->count; i++) {
 		PPROPERTY prop = &props->items[i];
+		SIZE_T nameLen = wcslen(prop->name), valueLen = wcslen(prop->value);
+		CopyMemory(text + pos, prop->name, nameLen * sizeof(WCHAR));
+		pos += nameLen;
+		text[pos++] = '=';
+		CopyMemory(text + pos, prop->value, valueLen * sizeof(WCHAR));
+		pos += valueLen;
+		text[pos++] = '\n';
+	}
+	text[pos] = '\0';
 
-		SIZE_T szLine = wcslen(prop->name) + 1 + wcslen(prop->value) + 2;
-		PWSTR line = calloc(szLine, sizeof(WCHAR));
-		if (!line) return FALSE;
-
-		wcscpy_s(line, szLine, prop->name);
-		wcscat_s(line, szLine, TEXT("="));
-		wcscat_s(line, szLine, prop->value);
-		wcscat_s(line, szLine, TEXT("\n"));
-
-		UINT dataSize;
-		PCHAR data = ConvertUtf16ToUtf8(line, szLine - 1, &dataSize);
-		free(line);
-
-		DWORD written;
-		BOOL ret = WriteFile(hFile, data, dataSize, &written, NULL);
-
-		free(data);
-
-		if(!ret) {
-			return FALSE;
-		}
+	SIZE_T dataSize;
+	PBYTE data = EncodeUtf8(text, textLen, &dataSize);
+	free(text);
+	if (!data) {
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return FALSE;
 	}
 
-	FlushFileBuffers(hFile);
-	CloseHandle(hFile);
+	BOOL ret = WriteFileContents(path, data, dataSize);
+	free(data);
 
-	return TRUE;
+	return ret;
 }
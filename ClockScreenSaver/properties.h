@@ -1,6 +1,6 @@
 #pragma once
 
-#include <Windows.h>
+#include "platform.h"
 
 typedef struct {
 	PWSTR name;
@@ -9,7 +9,10 @@ typedef struct {
 
 typedef struct {
 	UINT count;
+	UINT capacity;
 	PPROPERTY items;
+	// Hash index into items, see properties.c
+	PUINT index;
 } PROPERTIES, *PPROPERTIES;
 
 void FreeProperties(PPROPERTIES props);
@@ -18,6 +21,19 @@ BOOL SetProperty(PPROPERTIES props, PWSTR name, PWSTR value);
 
 PWSTR GetProperty(PPROPERTIES props, PWSTR name);
 
+// Removes a property, keeping the order of the others. Returns FALSE if there
+// was none with this name.
+BOOL RemoveProperty(PPROPERTIES props, PWSTR name);
+
+// Parses a decimal number without sign or surrounding whitespace.
+BOOL ParseUIntValue(PCWSTR str, PUINT value);
+
+// Parses six hex digits in the order red, green, blue.
+BOOL ParseRgbValue(PCWSTR str, LPCOLORREF value);
+
+// Parses yes, true, no or false, ignoring case.
+BOOL ParseBoolValue(PCWSTR str, PBOOL value);
+
 BOOL SetUIntProperty(PPROPERTIES props, PWSTR name, UINT value);
 
 BOOL GetUIntProperty(PPROPERTIES props, PWSTR name, PUINT value);
@@ -30,6 +46,10 @@ BOOL SetBoolProperty(PPROPERTIES props, PWSTR name, BOOL value);
 
 BOOL GetBoolProperty(PPROPERTIES props, PWSTR name, PBOOL value);
 
+// Parses the contents of a properties file, which are UTF-8 unless there is
+// a UTF-16 byte order mark.
+BOOL ParseProperties(PPROPERTIES props, const BYTE *data, SIZE_T size);
+
 BOOL ReadProperties(PPROPERTIES props, PWSTR path);
 
 BOOL WriteProperties(PPROPERTIES props, PWSTR path);
@@ -0,0 +1,101 @@
+#include "raster.h"
+
+#include <math.h>
+
+BOOL InitRaster(PRASTER raster, int width, int height) {
+	raster->width = width;
+	raster->height = height;
+
+	// One extra cell per row end so that lines touching the right edge do not
+	// need to be clipped
+	raster->area = calloc((SIZE_T)width * height + 2, sizeof(float));
+	return raster->area != NULL;
+}
+
+void FreeRaster(PRASTER raster) {
+	free(raster->area);
+	raster->area = NULL;
+}
+
+void AddRasterLine(PRASTER raster, float x0, float y0, float x1, float y1) {
+	if (y0 == y1) return;
+
+	float dir = 1;
+	if (y0 > y1) {
+		float t;
+		t = x0; x0 = x1; x1 = t;
+		t = y0; y0 = y1; y1 = t;
+		dir = -1;
+	}
+
+	float dxdy = (x1 - x0) / (y1 - y0);
+	float x = x0;
+	int yStart = (int)max(y0, 0);
+	if (y0 < 0) x -= y0 * dxdy;
+
+	int yEnd = min(raster->height, (int)ceilf(y1));
+	for (int y = yStart; y < yEnd; y++) {
+		float *row = raster->area + (SIZE_T)y * raster->width;
+		float dy = min((float)(y + 1), y1) - max((float)y, y0);
+		float xNext = x + dxdy * dy;
+		float d = dy * dir;
+
+		float xa = min(x, xNext), xb = max(x, xNext);
+		float xaFloor = floorf(xa);
+		int xai = (int)xaFloor;
+		float xbCeil = ceilf(xb);
+		int xbi = (int)xbCeil;
+
+		if (xai < 0) {
+			x = xNext;
+			continue;
+		}
+
+		if (xbi <= xai + 1) {
+			// The line stays within one pixel in this row
+			float xm = 0.5f * (x + xNext) - xaFloor;
+			row[xai] += d - d * xm;
+			row[xai + 1] += d * xm;
+		}
+		else {
+			// The line crosses several pixels; distribute the area
+			float s = 1 / (xb - xa);
+			float xaf = xa - xaFloor;
+			float a0 = 0.5f * s * (1 - xaf) * (1 - xaf);
+			float xbf = xb - xbCeil + 1;
+			float am = 0.5f * s * xbf * xbf;
+
+			row[xai] += d * a0;
+			if (xbi == xai + 2) {
+				row[xai + 1] += d * (1 - a0 - am);
+			}
+			else {
+				float a1 = s * (1.5f - xaf);
+				row[xai + 1] += d * (a1 - a0);
+				for (int xi = xai + 2; xi < xbi - 1; xi++) {
+					row[xi] += d * s;
+				}
+				float a2 = a1 + (xbi - xai - 3) * s;
+				row[xbi - 1] += d * (1 - a2 - am);
+			}
+			row[xbi] += d * am;
+		}
+
+		x = xNext;
+	}
+}
+
+void ResolveRaster(const RASTER *raster, PBYTE coverage, SIZE_T stride) {
+	// The accumulation carries over from one row to the next, which is
+	// correct because every row starts and ends outside of all contours
+	float acc = 0;
+	const float *area = raster->area;
+	for (int y = 0; y < raster->height; y++) {
+		PBYTE out = coverage + y * stride;
+		for (int x = 0; x < raster->width; x++) {
+			acc += *area++;
+			float a = fabsf(acc);
+			out[x] = (BYTE)(a >= 1 ? 255 : (int)(a * 255 + 0.5f));
+		}
+	}
+}
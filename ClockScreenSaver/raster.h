@@ -0,0 +1,24 @@
+#pragma once
+
+#include "platform.h"
+
+// Anti-aliased polygon rasterizer. Lines are accumulated as signed area into
+// a float buffer; a prefix sum over each row then yields the exact coverage
+// of every pixel under the non-zero winding rule for non-overlapping contours.
+typedef struct {
+	int width;
+	int height;
+	float *area;
+} RASTER, *PRASTER;
+
+// Prepares an empty raster. Coordinates passed to AddRasterLine must lie
+// within [0, width] x [0, height].
+BOOL InitRaster(PRASTER raster, int width, int height);
+
+void FreeRaster(PRASTER raster);
+
+void AddRasterLine(PRASTER raster, float x0, float y0, float x1, float y1);
+
+// Converts the accumulated area into 8-bit coverage, row by row with the
+// given stride.
+void ResolveRaster(const RASTER *raster, PBYTE coverage, SIZE_T stride);
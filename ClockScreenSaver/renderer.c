@@ -0,0 +1,380 @@
+#include "renderer.h"
+#include "gdicache.h"
+
+void InitClockRenderer(PCLOCK_RENDERER renderer, PCWSTR defaultFontName) {
+	ZeroMemory(renderer, sizeof(CLOCK_RENDERER));
+	wcscpy_s(renderer->defaultFontName, LF_FACESIZE, defaultFontName);
+}
+
+static void FreeBackBuffer(PCLOCK_RENDERER renderer) {
+	if (renderer->memhdc) {
+		SelectObject(renderer->memhdc, renderer->hOldBitmap);
+		DeleteDC(renderer->memhdc);
+		renderer->memhdc = NULL;
+	}
+	if (renderer->membitmap) {
+		DeleteObject(renderer->membitmap);
+		renderer->membitmap = NULL;
+	}
+	if (renderer->bufferBytes) {
+		TrackMemory(MEMORY_SURFACES, -(LONGLONG)renderer->bufferBytes);
+		renderer->bufferBytes = 0;
+	}
+	renderer->bufferSize.cx = renderer->bufferSize.cy = 0;
+}
+
+void FreeClockRenderer(PCLOCK_RENDERER renderer) {
+	FreeBackBuffer(renderer);
+	ReleaseGdiObject(renderer->hFont);
+	ReleaseGdiObject(renderer->hLabelFont);
+	ReleaseGdiObject(renderer->hBgBrush);
+	renderer->hFont = NULL;
+	renderer->hLabelFont = NULL;
+	renderer->hBgBrush = NULL;
+	renderer->valid = FALSE;
+}
+
+// A DIB section with 5 bits per channel, half the size of a 32-bit bitmap
+static HBITMAP CreateLowColorBitmap(HDC hdc, int cx, int cy) {
+	BITMAPINFO bmi;
+	ZeroMemory(&bmi, sizeof(bmi));
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = cx;
+	bmi.bmiHeader.biHeight = -cy;
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 16;
+	bmi.bmiHeader.biCompression = BI_RGB;
+
+	PVOID bits;
+	return CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+}
+
+static BOOL EnsureBackBuffer(PCLOCK_RENDERER renderer, HDC hdc, int cx, int cy, SIZE_T budget) {
+	if (renderer->bufferSize.cx == cx && renderer->bufferSize.cy == cy && renderer->bufferBudget == budget &&
+		(renderer->memhdc || renderer->bufferMode == BACK_BUFFER_NONE)) {
+		return TRUE;
+	}
+
+	// Free the old buffer first so that the budget does not count it
+	FreeBackBuffer(renderer);
+	renderer->bufferMode = ChooseBackBufferMode(budget, cx, cy);
+
+	if (renderer->bufferMode != BACK_BUFFER_NONE) {
+		renderer->memhdc = CreateCompatibleDC(hdc);
+		if (!renderer->memhdc) return FALSE;
+
+		BOOL lowColor = renderer->bufferMode == BACK_BUFFER_LOW_COLOR;
+		renderer->membitmap = lowColor ? CreateLowColorBitmap(hdc, cx, cy) : CreateCompatibleBitmap(hdc, cx, cy);
+		if (!renderer->membitmap) {
+			FreeBackBuffer(renderer);
+			return FALSE;
+		}
+
+		renderer->hOldBitmap = SelectObject(renderer->memhdc, renderer->membitmap);
+		renderer->bufferBytes = (SIZE_T)cx * cy * (lowColor ? 16 : GetDeviceCaps(hdc, BITSPIXEL)) / 8;
+		TrackMemory(MEMORY_SURFACES, renderer->bufferBytes);
+
+		// Ensure that logic units map to pixels
+		SetMapMode(renderer->memhdc, MM_TEXT);
+		SetBkMode(renderer->memhdc, OPAQUE);
+	}
+
+	renderer->bufferSize.cx = cx;
+	renderer->bufferSize.cy = cy;
+	renderer->bufferBudget = budget;
+
+	return TRUE;
+}
+
+static void FillFace(PCLOCK_RENDERER renderer, PSETTINGS settings, PLOGFONT face) {
+	PCWSTR fontName;
+	UINT weight;
+	BOOL italic;
+
+	if (settings->useCustomFont && settings->fontName) {
+		fontName = settings->fontName;
+		weight = settings->fontWeight;
+		italic = settings->fontItalic;
+	}
+	else {
+		fontName = renderer->defaultFontName;
+		weight = FW_DONTCARE;
+		italic = FALSE;
+	}
+
+	ZeroMemory(face, sizeof(LOGFONT));
+	face->lfWeight = weight;
+	face->lfItalic = italic;
+	face->lfCharSet = ANSI_CHARSET;
+	face->lfOutPrecision = OUT_OUTLINE_PRECIS;
+	face->lfClipPrecision = CLIP_DEFAULT_PRECIS;
+	face->lfQuality = CLEARTYPE_QUALITY;
+	face->lfPitchAndFamily = DEFAULT_PITCH | FF_DONTCARE;
+	wcsncpy_s(face->lfFaceName, LF_FACESIZE, fontName, _TRUNCATE);
+}
+
+// Measures "00" with the given face at the given height. Only happens when the
+// face or the window height change, not when the layout changes.
+static void MeasureFace(PCLOCK_RENDERER renderer, HDC dc, int height) {
+	LOGFONT lfont = renderer->face;
+	lfont.lfHeight = height;
+
+	HFONT hFont = AcquireFont(&lfont);
+	HGDIOBJ hOldFont = SelectObject(dc, hFont);
+
+	SIZE textSize;
+	if (!GetTextExtentPoint32(dc, TEXT("00"), 2, &textSize)) {
+		textSize.cx = 0;
+	}
+
+	SelectObject(dc, hOldFont);
+	ReleaseGdiObject(hFont);
+
+	renderer->measuredHeight = height;
+	renderer->measuredWidth = textSize.cx;
+}
+
+static void ReplaceFont(HFONT *phFont, const LOGFONT *face, int height) {
+	LOGFONT lfont = *face;
+	lfont.lfHeight = height;
+
+	HFONT hOld = *phFont;
+	*phFont = AcquireFont(&lfont);
+	ReleaseGdiObject(hOld);
+}
+
+// Brings fonts and layout up to date. Returns TRUE if anything changed.
+static BOOL UpdateLayout(PCLOCK_RENDERER renderer, HDC dc, PSETTINGS settings, const RECT *bufferRect, UINT nUnits) {
+	// The clock face leaves room for the burn-in drift
+	RECT layoutRect;
+	UINT driftRange = GetDriftLayoutRect(bufferRect, settings->driftRange, &layoutRect);
+	const RECT *rc = &layoutRect;
+
+	int height = rc->bottom - rc->top;
+	UINT nClocks = GetClockCount(settings);
+	BOOL labels = HasClockLabels(settings);
+	BOOL measure = FALSE;
+
+	LOGFONT face;
+	FillFace(renderer, settings, &face);
+	if (memcmp(&face, &renderer->face, sizeof(LOGFONT)) != 0) {
+		renderer->face = face;
+		measure = TRUE;
+	}
+
+	if (measure || renderer->measuredHeight != height) {
+		MeasureFace(renderer, dc, height);
+		measure = TRUE;
+	}
+
+	BOOL relayout = measure || !EqualRect(rc, &renderer->layoutRect) || renderer->layoutUnits != nUnits ||
+		renderer->layoutClocks != nClocks || renderer->layoutLabels != labels ||
+		renderer->layoutScale != settings->scale || renderer->layoutSpace != settings->space;
+	if (!relayout) {
+		return FALSE;
+	}
+
+	ComputeClockGrid(&renderer->grid, rc, nClocks, labels, nUnits, settings->scale, settings->space,
+		renderer->measuredHeight, renderer->measuredWidth);
+	renderer->layoutRect = *rc;
+	renderer->driftRange = driftRange;
+	renderer->layoutClocks = nClocks;
+	renderer->layoutLabels = labels;
+	renderer->layoutUnits = nUnits;
+	renderer->layoutScale = settings->scale;
+	renderer->layoutSpace = settings->space;
+
+	if (measure || !renderer->hFont || renderer->grid.fontHeight != renderer->fontHeight) {
+		ReplaceFont(&renderer->hFont, &renderer->face, renderer->grid.fontHeight);
+		renderer->fontHeight = renderer->grid.fontHeight;
+	}
+
+	int labelFontHeight = renderer->grid.labelHeight * 3 / 5;
+	if (labels && (measure || !renderer->hLabelFont || labelFontHeight != renderer->labelFontHeight)) {
+		ReplaceFont(&renderer->hLabelFont, &renderer->face, labelFontHeight);
+		renderer->labelFontHeight = labelFontHeight;
+	}
+
+	return TRUE;
+}
+
+void InvalidateClockRenderer(PCLOCK_RENDERER renderer) {
+	renderer->valid = FALSE;
+}
+
+// Checks whether anything other than the digits differs from the back buffer.
+static BOOL AppearanceChanged(PCLOCK_RENDERER renderer, PSETTINGS settings, DWORD formatFlags) {
+	if (renderer->fgColor != settings->fgColor || renderer->formatFlags != formatFlags) {
+		return TRUE;
+	}
+	for (UINT i = 0; i < settings->nClocks; i++) {
+		if (renderer->labels[i] != settings->clocks[i].label) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+// Copies a part of the back buffer to the window, moved by the drift offset
+static void PresentRect(PCLOCK_RENDERER renderer, HDC hdc, const RECT *rc, const RECT *rect) {
+	RECT bufferRect = { 0, 0, renderer->bufferSize.cx, renderer->bufferSize.cy };
+	RECT dst = *rect;
+	OffsetRect(&dst, renderer->driftOffset.x, renderer->driftOffset.y);
+	if (!IntersectRect(&dst, &dst, &bufferRect)) return;
+
+	BitBlt(hdc, rc->left + dst.left, rc->top + dst.top, dst.right - dst.left, dst.bottom - dst.top,
+		renderer->memhdc, dst.left - renderer->driftOffset.x, dst.top - renderer->driftOffset.y, SRCCOPY);
+}
+
+// Presents the whole back buffer and fills the bands it no longer covers
+// after moving by the drift offset.
+static void PresentAll(PCLOCK_RENDERER renderer, HDC hdc, const RECT *rc) {
+	int cx = renderer->bufferSize.cx, cy = renderer->bufferSize.cy;
+	RECT bufferRect = { 0, 0, cx, cy };
+	PresentRect(renderer, hdc, rc, &bufferRect);
+
+	RECT covered = bufferRect;
+	OffsetRect(&covered, renderer->driftOffset.x, renderer->driftOffset.y);
+	IntersectRect(&covered, &covered, &bufferRect);
+
+	RECT bands[4] = {
+		{ 0, 0, cx, covered.top },
+		{ 0, covered.bottom, cx, cy },
+		{ 0, covered.top, covered.left, covered.bottom },
+		{ covered.right, covered.top, cx, covered.bottom }
+	};
+	for (UINT i = 0; i < 4; i++) {
+		if (IsRectEmpty(&bands[i])) continue;
+		OffsetRect(&bands[i], rc->left, rc->top);
+		FillRect(hdc, &bands[i], renderer->hBgBrush);
+	}
+}
+
+void RenderClock(PCLOCK_RENDERER renderer, HDC hdc, const RECT *rc, PSETTINGS settings, const CLOCK_TIME *times,
+	LONGLONG timeMs) {
+	int cx = rc->right - rc->left;
+	int cy = rc->bottom - rc->top;
+	if (cx <= 0 || cy <= 0) return;
+
+	SIZE_T budget = (SIZE_T)settings->memoryBudget * 1024 * 1024;
+	if (renderer->bufferSize.cx != cx || renderer->bufferSize.cy != cy || renderer->bufferBudget != budget) {
+		renderer->valid = FALSE;
+	}
+
+	if (!EnsureBackBuffer(renderer, hdc, cx, cy, budget)) return;
+
+	// Without a back buffer, everything is drawn into the window
+	HDC dc = renderer->memhdc ? renderer->memhdc : hdc;
+
+	// The back buffer always starts at the origin
+	RECT bufferRect = { 0, 0, cx, cy };
+
+	if (!renderer->hBgBrush || renderer->bgColor != settings->bgColor) {
+		HBRUSH hOld = renderer->hBgBrush;
+		renderer->hBgBrush = AcquireSolidBrush(settings->bgColor);
+		renderer->bgColor = settings->bgColor;
+		ReleaseGdiObject(hOld);
+		renderer->valid = FALSE;
+	}
+
+	// Number of units to display
+	UINT nUnits = settings->showSeconds ? 3 : 2;
+	UINT nClocks = GetClockCount(settings);
+	DWORD formatFlags = settings->use12HourClock ? CLOCK_FORMAT_12H : 0;
+
+	if (UpdateLayout(renderer, dc, settings, &bufferRect, nUnits) ||
+		AppearanceChanged(renderer, settings, formatFlags)) {
+		renderer->valid = FALSE;
+	}
+
+	// Moving the clock face only takes presenting the back buffer again
+	POINT driftOffset;
+	GetDriftOffset(renderer->driftRange, settings->driftPeriod, timeMs, &driftOffset);
+	BOOL presentAll = !renderer->valid || driftOffset.x != renderer->driftOffset.x ||
+		driftOffset.y != renderer->driftOffset.y;
+	renderer->driftOffset = driftOffset;
+
+	// Drawing directly, there is nothing to present, so the whole clock face
+	// is drawn again where it would have been presented
+	POINT oldOrigin;
+	if (dc == hdc) {
+		if (presentAll) {
+			FillRect(hdc, rc, renderer->hBgBrush);
+			renderer->valid = FALSE;
+		}
+		SetViewportOrgEx(hdc, rc->left + driftOffset.x, rc->top + driftOffset.y, &oldOrigin);
+		SetBkMode(hdc, OPAQUE);
+	}
+
+	// Prepare text drawing
+	HGDIOBJ hOldFont = SelectObject(dc, renderer->hFont);
+	SetTextColor(dc, settings->fgColor);
+	SetBkColor(dc, settings->bgColor);
+
+	if (!renderer->valid) {
+		// Start over with an empty background and labels
+		if (dc != hdc) {
+			FillRect(dc, &bufferRect, renderer->hBgBrush);
+		}
+
+		if (renderer->layoutLabels) {
+			SelectObject(dc, renderer->hLabelFont);
+			for (UINT c = 0; c < settings->nClocks; c++) {
+				if (!settings->clocks[c].label) continue;
+
+				RECT rect;
+				GetClockLabelRect(&renderer->grid, c, &rect);
+				DrawText(dc, settings->clocks[c].label, -1, &rect,
+					DT_CENTER | DT_SINGLELINE | DT_VCENTER | DT_NOPREFIX | DT_END_ELLIPSIS);
+			}
+			SelectObject(dc, renderer->hFont);
+		}
+
+		renderer->fgColor = settings->fgColor;
+		renderer->formatFlags = formatFlags;
+		for (UINT c = 0; c < settings->nClocks; c++) {
+			renderer->labels[c] = settings->clocks[c].label;
+		}
+		ZeroMemory(renderer->text, sizeof(renderer->text));
+	}
+
+	// Draw the units that changed. All clocks share one font, so the cost of
+	// a frame depends on how many digits changed, not on the number of clocks.
+	for (UINT c = 0; c < nClocks; c++) {
+		// Generate text blocks, two characters per unit
+		WCHAR text[CLOCK_FORMAT_MAX_CHARS];
+		FormatClockTime(&times[c], nUnits, formatFlags, text);
+
+		POINT offset;
+		GetClockTileOffset(&renderer->grid, c, &offset);
+
+		for (UINT i = 0; i < nUnits; i++) {
+			if (text[2 * i] == renderer->text[c][2 * i] && text[2 * i + 1] == renderer->text[c][2 * i + 1]) {
+				continue;
+			}
+
+			RECT rect = renderer->grid.digits.units[i];
+			OffsetRect(&rect, offset.x, offset.y);
+			FillRect(dc, &rect, renderer->hBgBrush);
+			DrawText(dc, text + 2 * i, 2, &rect, DT_CENTER | DT_SINGLELINE | DT_VCENTER);
+
+			if (!presentAll && dc != hdc) {
+				PresentRect(renderer, hdc, rc, &rect);
+			}
+		}
+
+		CopyMemory(renderer->text[c], text, sizeof(text));
+	}
+
+	SelectObject(dc, hOldFont);
+
+	// Present everything if the window did not show the back buffer before,
+	// or showed it at another offset
+	if (dc == hdc) {
+		SetViewportOrgEx(hdc, oldOrigin.x, oldOrigin.y, NULL);
+	}
+	else if (presentAll) {
+		PresentAll(renderer, hdc, rc);
+	}
+	renderer->valid = TRUE;
+}
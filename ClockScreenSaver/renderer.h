@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Windows.h>
+#include "clocklayout.h"
+#include "memusage.h"
+#include "settings.h"
+#include "timefmt.h"
+
+// Renders one or more clocks into a window, keeping the back buffer, fonts and
+// layout between frames. Only units whose digits changed since the previous
+// frame are redrawn and presented.
+typedef struct {
+	WCHAR defaultFontName[LF_FACESIZE];
+
+	// Back buffer
+	HDC memhdc;
+	HBITMAP membitmap;
+	HGDIOBJ hOldBitmap;
+	SIZE bufferSize;
+
+	// How the back buffer was chosen to fit into the memory budget. Without
+	// one, changes are drawn straight into the window.
+	BACK_BUFFER_MODE bufferMode;
+	SIZE_T bufferBudget;
+	SIZE_T bufferBytes;
+
+	// Cached brush for the background
+	HBRUSH hBgBrush;
+	COLORREF bgColor;
+
+	// Font face currently in use and the width of "00" at measuredHeight
+	LOGFONT face;
+	int measuredHeight;
+	int measuredWidth;
+
+	// Cached layout and the inputs it was computed from
+	RECT layoutRect;
+	UINT layoutClocks;
+	BOOL layoutLabels;
+	UINT layoutUnits;
+	UINT layoutScale;
+	UINT layoutSpace;
+	CLOCK_GRID grid;
+
+	// Burn-in drift that the layout leaves room for, and the offset at which
+	// the back buffer was last presented
+	UINT driftRange;
+	POINT driftOffset;
+
+	// Fonts matching the layout, shared by all clocks
+	HFONT hFont;
+	int fontHeight;
+	HFONT hLabelFont;
+	int labelFontHeight;
+
+	// What the back buffer currently shows
+	BOOL valid;
+	COLORREF fgColor;
+	DWORD formatFlags;
+	PCWSTR labels[MAX_CLOCKS];
+	WCHAR text[MAX_CLOCKS][CLOCK_FORMAT_MAX_CHARS];
+} CLOCK_RENDERER, *PCLOCK_RENDERER;
+
+void InitClockRenderer(PCLOCK_RENDERER renderer, PCWSTR defaultFontName);
+
+void FreeClockRenderer(PCLOCK_RENDERER renderer);
+
+// Makes the next RenderClock call redraw and present everything, e.g. after
+// the window contents were lost.
+void InvalidateClockRenderer(PCLOCK_RENDERER renderer);
+
+// Draws the given times, one per clock, into rc on hdc. timeMs drives the
+// burn-in drift: when the offset changes, the back buffer is presented at the
+// new offset without drawing anything again.
+void RenderClock(PCLOCK_RENDERER renderer, HDC hdc, const RECT *rc, PSETTINGS settings, const CLOCK_TIME *times,
+	LONGLONG timeMs);
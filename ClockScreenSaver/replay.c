@@ -0,0 +1,221 @@
+#include "replay.h"
+#include "swrender.h"
+
+#define DAY_MS (24 * 60 * 60 * 1000LL)
+
+typedef struct {
+	SW_RENDERER renderer;
+	SURFACE drifted;
+	int width;
+	int height;
+	// Time of day in milliseconds, which also drives the drift
+	LONGLONG timeMs;
+
+	PROPERTIES props;
+	SETTINGS settings;
+
+	// Properties replaced by a later set or reset. The renderer recognizes
+	// changed labels by their address, so the strings of the previous frame
+	// must not be freed and reused before the next one.
+	PPROPERTIES retired;
+	UINT nRetired;
+} REPLAY_STATE, *PREPLAY_STATE;
+
+static BOOL AddFrame(PREPLAY replay, const REPLAY_FRAME *frame) {
+	if (replay->nFrames == replay->capacity) {
+		UINT capacity = replay->capacity ? replay->capacity * 2 : 64;
+		PREPLAY_FRAME frames = realloc(replay->frames, capacity * sizeof(REPLAY_FRAME));
+		if (!frames) {
+			SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+			return FALSE;
+		}
+		replay->frames = frames;
+		replay->capacity = capacity;
+	}
+
+	replay->frames[replay->nFrames++] = *frame;
+	return TRUE;
+}
+
+static BOOL RenderFrame(PREPLAY_STATE state, PREPLAY replay, UINT line) {
+	CLOCK_TIME times[MAX_CLOCKS];
+	SplitClockTime(state->timeMs, &times[0]);
+	for (UINT i = 1; i < MAX_CLOCKS; i++) {
+		times[i] = times[0];
+	}
+
+	PSETTINGS settings = &state->settings;
+	LONGLONG start = GetPlatformMonotonicTimeUs();
+	if (!RenderClockToSurface(&state->renderer, state->width, state->height, settings, times) ||
+		(settings->driftRange && !PresentSwRenderer(&state->renderer, &state->drifted, settings, state->timeMs))) {
+		return FALSE;
+	}
+
+	REPLAY_FRAME frame;
+	frame.us = GetPlatformMonotonicTimeUs() - start;
+	frame.hash = HashSurface(settings->driftRange ? &state->drifted : &state->renderer.surface);
+	frame.composedTiles = state->renderer.compositor.composedTiles;
+	frame.line = line;
+	return AddFrame(replay, &frame);
+}
+
+// Keeps the current properties alive and starts over with a copy of them, or
+// with none if copy is FALSE.
+static BOOL RetireProperties(PREPLAY_STATE state, BOOL copy) {
+	PPROPERTIES retired = realloc(state->retired, (state->nRetired + 1) * sizeof(PROPERTIES));
+	if (!retired) {
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return FALSE;
+	}
+	state->retired = retired;
+
+	PROPERTIES props = { 0 };
+	for (UINT i = 0; copy && i < state->props.count; i++) {
+		if (!SetProperty(&props, state->props.items[i].name, state->props.items[i].value)) {
+			FreeProperties(&props);
+			return FALSE;
+		}
+	}
+
+	state->retired[state->nRetired++] = state->props;
+	state->props = props;
+	return TRUE;
+}
+
+static BOOL SetSetting(PREPLAY_STATE state, PWSTR args) {
+	PWSTR value = wcschr(args, '=');
+	if (!value || value == args) {
+		SetLastError(ERROR_INVALID_DATA);
+		return FALSE;
+	}
+	*value++ = '\0';
+
+	if (!RetireProperties(state, TRUE) || !SetProperty(&state->props, args, value)) {
+		return FALSE;
+	}
+
+	PWSTR rejected;
+	if (PropertiesToSettings(&state->settings, &state->props, &rejected, 1) != 0) {
+		SetLastError(ERROR_INVALID_DATA);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL RunCommand(PREPLAY_STATE state, PREPLAY replay, PWSTR command, PWSTR args, UINT line) {
+	int width, height;
+	UINT hour, minute, second, count, step = 1;
+	WCHAR extra;
+
+	if (wcscmp(command, L"frame") == 0 && !*args) {
+		return RenderFrame(state, replay, line);
+	}
+	if (wcscmp(command, L"invalidate") == 0 && !*args) {
+		InvalidateSwRenderer(&state->renderer);
+		return TRUE;
+	}
+	if (wcscmp(command, L"reset") == 0 && !*args) {
+		if (!RetireProperties(state, FALSE)) return FALSE;
+		RestoreDefaultSettings(&state->settings);
+		return TRUE;
+	}
+	if (wcscmp(command, L"set") == 0) {
+		return SetSetting(state, args);
+	}
+	if (wcscmp(command, L"size") == 0 && swscanf(args, L"%dx%d%lc", &width, &height, &extra) == 2 &&
+		width > 0 && height > 0 && width <= 16384 && height <= 16384) {
+		state->width = width;
+		state->height = height;
+		return TRUE;
+	}
+	if (wcscmp(command, L"time") == 0 && swscanf(args, L"%u:%u:%u%lc", &hour, &minute, &second, &extra) == 3 &&
+		hour < 24 && minute < 60 && second < 60) {
+		state->timeMs = ((hour * 60LL + minute) * 60 + second) * 1000;
+		return TRUE;
+	}
+	if (wcscmp(command, L"tick") == 0) {
+		int n = swscanf(args, L"%u %u%lc", &count, &step, &extra);
+		if ((n == 1 || n == 2) && count > 0 && count <= 1000000 && step <= 86400) {
+			for (UINT i = 0; i < count; i++) {
+				state->timeMs = (state->timeMs + step * 1000LL) % DAY_MS;
+				if (!RenderFrame(state, replay, line)) return FALSE;
+			}
+			return TRUE;
+		}
+	}
+
+	SetLastError(ERROR_INVALID_DATA);
+	return FALSE;
+}
+
+static BOOL IsBlank(WCHAR c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+BOOL RunReplay(PREPLAY replay, PCWSTR script, const TTFONT *font) {
+	PWSTR text = _wcsdup(script);
+	PREPLAY_STATE state = calloc(1, sizeof(REPLAY_STATE));
+	if (!text || !state) {
+		free(text);
+		free(state);
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return FALSE;
+	}
+
+	InitSwRenderer(&state->renderer, font, NULL);
+	state->width = REPLAY_DEFAULT_WIDTH;
+	state->height = REPLAY_DEFAULT_HEIGHT;
+	state->timeMs = 12 * 60 * 60 * 1000LL;
+	RestoreDefaultSettings(&state->settings);
+
+	BOOL ok = TRUE;
+	UINT line = 0;
+	for (PWSTR next = text; ok && next; ) {
+		PWSTR start = next;
+		line++;
+
+		// Split off the line and trim it
+		next = wcschr(start, '\n');
+		if (next) {
+			*next++ = '\0';
+		}
+		while (IsBlank(*start)) start++;
+		PWSTR end = start + wcslen(start);
+		while (end > start && IsBlank(end[-1])) end--;
+		*end = '\0';
+		if (!*start || *start == '#') continue;
+
+		// The command is the first word, the rest are its arguments
+		PWSTR args = start;
+		while (*args && !IsBlank(*args)) args++;
+		if (*args) {
+			*args++ = '\0';
+			while (IsBlank(*args)) args++;
+		}
+
+		ok = RunCommand(state, replay, start, args, line);
+	}
+
+	if (!ok) {
+		replay->errorLine = line;
+	}
+
+	DWORD error = GetLastError();
+	FreeSwRenderer(&state->renderer);
+	FreeSurface(&state->drifted);
+	FreeProperties(&state->props);
+	for (UINT i = 0; i < state->nRetired; i++) {
+		FreeProperties(&state->retired[i]);
+	}
+	free(state->retired);
+	free(state);
+	free(text);
+	SetLastError(error);
+
+	return ok;
+}
+
+void FreeReplay(PREPLAY replay) {
+	free(replay->frames);
+	ZeroMemory(replay, sizeof(REPLAY));
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "platform.h"
+#include "ttfont.h"
+
+// Replays a script of frames through the software renderer, so that changes
+// to rendering can be checked against the hashes of known good frames and
+// timed. A script has one command per line, lines starting with '#' are
+// comments:
+//
+//   size 1280x720      size of the frames (default: 640x360)
+//   set key=value      changes a setting, as in the .properties format
+//   reset              restores the default settings
+//   time 23:59:58      time of day shown by every clock (default: 12:00:00)
+//   frame              renders a frame
+//   tick N [SECONDS]   renders N frames, advancing the time by SECONDS
+//                      (default: 1) before each one
+//   invalidate         makes the next frame redraw everything, as after the
+//                      window was uncovered
+//
+// Time zones are not resolved and the time only comes from the script, so
+// that a replay gives the same frames on any machine.
+
+// Default size of the frames
+#define REPLAY_DEFAULT_WIDTH 640
+#define REPLAY_DEFAULT_HEIGHT 360
+
+typedef struct {
+	// HashSurface of the frame as presented, i.e. including the drift
+	ULONGLONG hash;
+	// Number of tiles composed for the frame, which measures the work done
+	// independently of the machine
+	UINT composedTiles;
+	// Time spent rendering and presenting the frame
+	LONGLONG us;
+	// Line of the command that rendered the frame
+	UINT line;
+} REPLAY_FRAME, *PREPLAY_FRAME;
+
+typedef struct {
+	PREPLAY_FRAME frames;
+	UINT nFrames;
+	UINT capacity;
+
+	// Line of the command that failed
+	UINT errorLine;
+} REPLAY, *PREPLAY;
+
+// Runs a script, appending its frames to replay, which must be zeroed or
+// freed before. Fails with ERROR_INVALID_DATA and sets errorLine if a command
+// is invalid; the frames rendered up to that point are kept.
+BOOL RunReplay(PREPLAY replay, PCWSTR script, const TTFONT *font);
+
+void FreeReplay(PREPLAY replay);
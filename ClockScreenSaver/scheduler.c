@@ -0,0 +1,54 @@
+#include "scheduler.h"
+
+// Interval of the wall clock that contains t, also before 1601
+static LONGLONG GetInterval(LONGLONG t, UINT intervalMs) {
+	return (t >= 0 ? t : t - intervalMs + 1) / intervalMs;
+}
+
+void InitFrameScheduler(PFRAME_SCHEDULER scheduler, const TIME_SOURCE *source, UINT intervalMs, UINT slackMs) {
+	ZeroMemory(scheduler, sizeof(FRAME_SCHEDULER));
+	scheduler->source = source;
+	scheduler->intervalMs = max(intervalMs, 1);
+	scheduler->slackMs = min(slackMs, scheduler->intervalMs - 1);
+}
+
+UINT GetFrameDelay(const FRAME_SCHEDULER *scheduler, LONGLONG utcMs) {
+	LONGLONG next = (GetInterval(utcMs, scheduler->intervalMs) + 1) * scheduler->intervalMs;
+	return (UINT)(next - utcMs) + scheduler->slackMs;
+}
+
+void TickFrameScheduler(PFRAME_SCHEDULER scheduler, PFRAME_TICK tick) {
+	LONGLONG utc = GetSourceUtcMs(scheduler->source);
+	LONGLONG monotonic = GetSourceMonotonicUs(scheduler->source);
+	LONGLONG frame = GetInterval(utc, scheduler->intervalMs);
+
+	// Both clocks advance alike unless the wall clock was stepped, or the
+	// monotonic clock stood still during a suspend
+	tick->jumped = FALSE;
+	if (scheduler->started) {
+		LONGLONG elapsedMs = (monotonic - scheduler->lastMonotonicUs) / 1000;
+		LONGLONG drift = utc - scheduler->lastUtcMs - elapsedMs;
+		LONGLONG limit = SCHEDULER_JUMP_MS + elapsedMs * SCHEDULER_JUMP_PPM / 1000000;
+		if (drift > limit || drift < -limit) {
+			tick->jumped = TRUE;
+			scheduler->nJumps++;
+		}
+	}
+	scheduler->lastUtcMs = utc;
+	scheduler->lastMonotonicUs = monotonic;
+
+	// Render whenever the interval changed, in whichever direction, but only
+	// once, however many intervals passed
+	tick->render = !scheduler->started || frame != scheduler->lastFrame || tick->jumped;
+	tick->utcMs = utc;
+	tick->delayMs = GetFrameDelay(scheduler, utc);
+
+	if (tick->render) {
+		scheduler->started = TRUE;
+		scheduler->lastFrame = frame;
+		scheduler->nFrames++;
+	}
+	else {
+		scheduler->nEarly++;
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "timesource.h"
+
+// Schedules frames on the boundaries of the wall clock, e.g. on every second,
+// with a one-shot timer that is armed again on each tick. The wall clock
+// decides what to show and when the next boundary is; the monotonic clock
+// tells steps of the wall clock and suspends apart from timers that are late.
+//
+// - A tick before the boundary, because the timer and the wall clock drift
+//   apart, renders nothing and waits for the boundary, so that no second is
+//   ever skipped.
+// - A late tick, e.g. after a resume, renders a single frame of the current
+//   time. Missed frames are never caught up.
+// - After a step of the wall clock in either direction, or a suspend, the
+//   timer is aligned to the new boundaries at the next tick.
+
+// How far the wall clock may drift from the monotonic clock between ticks
+// before it counts as a jump: a fixed part, plus a part per second elapsed
+// that is twice what NTP slews at most
+#define SCHEDULER_JUMP_MS 100
+#define SCHEDULER_JUMP_PPM 1000
+
+typedef struct {
+	const TIME_SOURCE *source;
+	UINT intervalMs;
+	// How long after a boundary to render, so that a slightly early timer
+	// still lands after it
+	UINT slackMs;
+
+	// Interval of the wall clock shown by the last frame, valid if started
+	BOOL started;
+	LONGLONG lastFrame;
+
+	// Clocks at the last tick
+	LONGLONG lastUtcMs;
+	LONGLONG lastMonotonicUs;
+
+	// Frames rendered, ticks that came too early and jumps of the wall clock
+	UINT nFrames;
+	UINT nEarly;
+	UINT nJumps;
+} FRAME_SCHEDULER, *PFRAME_SCHEDULER;
+
+typedef struct {
+	// Whether to render a frame, and the time it shows
+	BOOL render;
+	LONGLONG utcMs;
+	// Time until the next tick
+	UINT delayMs;
+	// The wall clock stepped or the system was suspended since the last
+	// tick, so what is on screen may be stale
+	BOOL jumped;
+} FRAME_TICK, *PFRAME_TICK;
+
+void InitFrameScheduler(PFRAME_SCHEDULER scheduler, const TIME_SOURCE *source, UINT intervalMs, UINT slackMs);
+
+// Reads the clocks once and decides what to do on this tick. The first tick
+// always renders.
+void TickFrameScheduler(PFRAME_SCHEDULER scheduler, PFRAME_TICK tick);
+
+// Returns the time until the next tick, e.g. to arm the first timer.
+UINT GetFrameDelay(const FRAME_SCHEDULER *scheduler, LONGLONG utcMs);
@@ -3,8 +3,15 @@
 #include <Scrnsave.h>
 #include <ShlObj.h>
 #include "resource.h"
+#include "gdicache.h"
+#include "memusage.h"
+#include "profiles.h"
 #include "properties.h"
+#include "renderer.h"
+#include "scheduler.h"
 #include "settings.h"
+#include "startup.h"
+#include "swrender.h"
 
 #ifdef UNICODE
 #pragma comment(lib, "ScrnSavw.lib")
@@ -16,6 +23,23 @@
 
 extern HINSTANCE hMainInstance;
 
+// Window class of the preview control in the configuration dialog
+#define PREVIEW_CLASS TEXT("ClockPreview")
+
+// Passes a PSETTINGS (lParam) to the preview control
+#define PVM_SETSETTINGS (WM_USER + 1)
+
+// Frames are rendered once per second, just after the second changes, see
+// FRAME_SCHEDULER
+#define FRAME_INTERVAL 1000
+#define FRAME_SLACK USER_TIMER_MINIMUM
+
+// Time from WM_CREATE to the first frame that a preview should not exceed
+#define PREVIEW_STARTUP_TARGET_US 10000
+
+// Room for the host name that selects profiles
+#define MAX_HOST_NAME 256
+
 PWSTR GetConfigPath() {
 	// Get path to AppData/local
 	PWSTR dir;
@@ -29,12 +53,12 @@ PWSTR GetConfigPath() {
 	// Construct full path to config file
 	size_t n = wcslen(dir) + 1 + wcslen(szAppName) + wcslen(ext) + 1;
 	PWSTR path = calloc(n, sizeof(WCHAR));
-	if (!path) return NULL;
-
-	wcscpy_s(path, n, dir);
-	wcscat_s(path, n, TEXT("\\"));
-	wcscat_s(path, n, szAppName);
-	wcscat_s(path, n, ext);
+	if (path) {
+		wcscpy_s(path, n, dir);
+		wcscat_s(path, n, TEXT("\\"));
+		wcscat_s(path, n, szAppName);
+		wcscat_s(path, n, ext);
+	}
 
 	CoTaskMemFree(dir);
 
@@ -47,30 +71,61 @@ static BOOL LoadConfig(PPROPERTIES props) {
 	PWSTR path = GetConfigPath();
 	if (!path) return FALSE;
 
-	return ReadProperties(props, path);
+	BOOL ret = ReadProperties(props, path);
+	free(path);
+
+	return ret;
 }
 
 static BOOL SaveConfig(PPROPERTIES props) {
 	PWSTR path = GetConfigPath();
 	if (!path) return FALSE;
 
-	return WriteProperties(props, path);
+	BOOL ret = WriteProperties(props, path);
+	free(path);
+
+	return ret;
+}
+
+// Invalid values are replaced by defaults, but let the user know
+static void ReportRejected(PWSTR *rejected, UINT nRejected, UINT maxRejected) {
+	for (UINT i = 0; i < min(nRejected, maxRejected); i++) {
+		WCHAR msg[128];
+		wsprintf(msg, TEXT("ClockScreenSaver: ignoring invalid value of %.64s\n"), rejected[i]);
+		OutputDebugString(msg);
+	}
 }
 
-static BOOL LoadSettings(PPROPERTIES props, PSETTINGS settings) {
+// Loads the settings, with the profiles that apply to target on top, or
+// without any profiles if target is NULL, e.g. to edit the base settings.
+static BOOL LoadSettings(PPROPERTIES props, PSETTINGS settings, const PROFILE_TARGET *target) {
 	// Load properties
 	if (!LoadConfig(props)) {
 		return FALSE;
 	}
 
 	// Extract settings
-	PropertiesToSettings(settings, props);
+	PWSTR rejected[8];
+	if (!target) {
+		ReportRejected(rejected, PropertiesToSettings(settings, props, rejected, 8), 8);
+		return TRUE;
+	}
+
+	PROFILE_SET profiles;
+	UINT nRejected;
+	if (!IndexProfiles(&profiles, props, rejected, 8, &nRejected)) {
+		return FALSE;
+	}
+	ReportRejected(rejected, nRejected, 8);
+	ReportRejected(rejected, ResolveProfileSettings(&profiles, target, settings, rejected, 8), 8);
+	FreeProfiles(&profiles);
+
 	return TRUE;
 }
 
 // Loads settings or uses defaults if the configuration file does not exist.
-static BOOL LoadSettingsOrUseDefaults(PPROPERTIES props, PSETTINGS settings) {
-	if (LoadSettings(props, settings)) {
+static BOOL LoadSettingsOrUseDefaults(PPROPERTIES props, PSETTINGS settings, const PROFILE_TARGET *target) {
+	if (LoadSettings(props, settings, target)) {
 		return TRUE;
 	}
 	else if (GetLastError() == ERROR_FILE_NOT_FOUND) {
@@ -82,6 +137,7 @@ static BOOL LoadSettingsOrUseDefaults(PPROPERTIES props, PSETTINGS settings) {
 	}
 }
 
+// String settings point into props before and after, so saving can be retried.
 static BOOL SaveSettings(PPROPERTIES props, PSETTINGS settings) {
 	SettingsToProperties(settings, props);
 	return SaveConfig(props);
@@ -129,7 +185,8 @@ static void InvalidateWindow(HWND hWindow) {
 	InvalidateRect(hWindow, &rect, TRUE);
 }
 
-static BOOL ChooseCustomFont(HWND hDlg, PSETTINGS settings) {
+// The chosen font name is kept in props, which settings->fontName points into.
+static BOOL ChooseCustomFont(HWND hDlg, PPROPERTIES props, PSETTINGS settings) {
 	LOGFONT lFont;
 	CreateLFont(&lFont, settings->fontName, 20, settings->fontWeight, settings->fontItalic);
 
@@ -143,7 +200,10 @@ static BOOL ChooseCustomFont(HWND hDlg, PSETTINGS settings) {
 	cFont.lpfnHook = ChooseFontHook;
 
 	if (ChooseFont(&cFont)) {
-		settings->fontName = _wcsdup(lFont.lfFaceName);
+		if (!SetProperty(props, L"fontName", lFont.lfFaceName)) {
+			return FALSE;
+		}
+		settings->fontName = GetProperty(props, L"fontName");
 		settings->fontWeight = lFont.lfWeight;
 		settings->fontItalic = lFont.lfItalic;
 		return TRUE;
@@ -152,6 +212,13 @@ static BOOL ChooseCustomFont(HWND hDlg, PSETTINGS settings) {
 	return FALSE;
 }
 
+// Points *phBrush at a cached brush of the given color and releases the previous one.
+static void ReplaceBrush(HBRUSH *phBrush, COLORREF color) {
+	HBRUSH hOld = *phBrush;
+	*phBrush = AcquireSolidBrush(color);
+	ReleaseGdiObject(hOld);
+}
+
 static BOOL ChooseCustomColor(HWND hDlg, LPCOLORREF color) {
 	static COLORREF customColors[16];
 	CHOOSECOLOR cColor;
@@ -178,6 +245,12 @@ static int ErrorMessageBox(HWND hWnd, PWSTR caption, UINT btnType) {
 	return MessageBox(hWnd, msg, caption, MB_ICONERROR | btnType);
 }
 
+// Repaints the preview control right away so that it keeps up with track bars.
+static void UpdatePreview(HWND hPreview) {
+	InvalidateRect(hPreview, NULL, FALSE);
+	UpdateWindow(hPreview);
+}
+
 static void CenterWindowOnDesktop(HWND hwnd) {
 	// Obtain rects
 	RECT desktopRect, windowRect;
@@ -197,6 +270,10 @@ static void CenterWindowOnDesktop(HWND hwnd) {
 	SetWindowPos(hwnd, 0, x, y, 0, 0, SWP_NOSIZE | SWP_NOZORDER);
 }
 
+// The bundled font as registered for the preview control by
+// RegisterDialogClasses, released when the dialog ends
+static HANDLE hPreviewFont;
+
 BOOL WINAPI ScreenSaverConfigureDialog(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
 	static PROPERTIES properties;
 	static SETTINGS settings;
@@ -207,6 +284,7 @@ BOOL WINAPI ScreenSaverConfigureDialog(HWND hDlg, UINT message, WPARAM wParam, L
 	static HWND hFontCheck;   // handle to "use custom font" checkbox
 	static HWND hFontButton;  // handle to font button
 	static HWND hCurrentFont; // handle to current font label
+	static HWND hPreview;     // handle to preview control
 
 	// Button brushes
 	static HBRUSH hFgBrush = NULL, hBgBrush = NULL;
@@ -221,8 +299,9 @@ BOOL WINAPI ScreenSaverConfigureDialog(HWND hDlg, UINT message, WPARAM wParam, L
 		// Retrieve the application name from the .rc file.
 		LoadString(hMainInstance, idsAppName, szAppName, APPNAMEBUFFERLEN);
 
-		// Load settings
-		while (!LoadSettingsOrUseDefaults(&properties, &settings)) {
+		// Load settings. Profiles are left out, since saving writes the base
+		// settings.
+		while (!LoadSettingsOrUseDefaults(&properties, &settings, NULL)) {
 			switch (ErrorMessageBox(hDlg, L"Failed to load configuration", MB_ABORTRETRYIGNORE)) {
 			case IDRETRY:
 				continue;
@@ -261,8 +340,12 @@ BOOL WINAPI ScreenSaverConfigureDialog(HWND hDlg, UINT message, WPARAM wParam, L
 
 		UpdateCustomFont(hFontCheck, hFontButton, hCurrentFont, &settings);
 
-		hFgBrush = CreateSolidBrush(settings.fgColor);
-		hBgBrush = CreateSolidBrush(settings.bgColor);
+		ReplaceBrush(&hFgBrush, settings.fgColor);
+		ReplaceBrush(&hBgBrush, settings.bgColor);
+
+		// Let the preview render the settings as they are being edited
+		hPreview = GetDlgItem(hDlg, IDC_PREVIEW);
+		SendMessage(hPreview, PVM_SETSETTINGS, 0, (LPARAM)&settings);
 
 		// If the configuration dialog was not opened relative to another window, center it on the screen
 		if (GetParent(hDlg) == 0) {
@@ -276,34 +359,40 @@ BOOL WINAPI ScreenSaverConfigureDialog(HWND hDlg, UINT message, WPARAM wParam, L
 		switch (buttonId) {
 		case IDC_CHOOSE_FONT:
 			// Show font dialog
-			if (ChooseCustomFont(hDlg, &settings)) {
+			if (ChooseCustomFont(hDlg, &properties, &settings)) {
 				SetWindowText(hCurrentFont, settings.fontName);
+				UpdatePreview(hPreview);
 			}
 			return TRUE;
 		case IDC_FOREGROUND:
 			// Show color picker for foreground
 			if (ChooseCustomColor(hDlg, &settings.fgColor)) {
-				hFgBrush = CreateSolidBrush(settings.fgColor);
+				ReplaceBrush(&hFgBrush, settings.fgColor);
 				InvalidateWindow(hDlg);
+				UpdatePreview(hPreview);
 			}
 			return TRUE;
 		case IDC_BACKGROUND:
 			// Show color picker for background
 			if (ChooseCustomColor(hDlg, &settings.bgColor)) {
-				hBgBrush = CreateSolidBrush(settings.bgColor);
+				ReplaceBrush(&hBgBrush, settings.bgColor);
 				InvalidateWindow(hDlg);
+				UpdatePreview(hPreview);
 			}
 			return TRUE;
 		case IDC_CUSTOM_FONT:
 			// Toggle custom font
 			UpdateCustomFont(hFontCheck, hFontButton, hCurrentFont, &settings);
+			UpdatePreview(hPreview);
 			return TRUE;
 		case IDC_SECONDS:
 			settings.showSeconds = IsDlgButtonChecked(hDlg, IDC_SECONDS);
+			UpdatePreview(hPreview);
 			return TRUE;
 		case IDC_RESTORE_DEFAULTS:
 			// Restore settings
 			RestoreDefaultSettings(&settings);
+			SendMessage(hPreview, PVM_SETSETTINGS, 0, (LPARAM)&settings);
 
 			// Update all controls
 			SendMessage(hScale, TBM_SETPOS, FALSE, settings.scale);
@@ -311,12 +400,13 @@ BOOL WINAPI ScreenSaverConfigureDialog(HWND hDlg, UINT message, WPARAM wParam, L
 			SendMessage(hSeconds, BM_SETCHECK, settings.showSeconds ? BST_CHECKED : BST_UNCHECKED, 0);
 			SendMessage(hFontCheck, BM_SETCHECK, settings.useCustomFont ? BST_CHECKED : BST_UNCHECKED, 0);
 			SetWindowText(hCurrentFont, settings.fontName);
-			hFgBrush = CreateSolidBrush(settings.fgColor);
-			hBgBrush = CreateSolidBrush(settings.bgColor);
+			ReplaceBrush(&hFgBrush, settings.fgColor);
+			ReplaceBrush(&hBgBrush, settings.bgColor);
 
 			// Ensure that all visuals are updated
 			UpdateCustomFont(hFontCheck, hFontButton, hCurrentFont, &settings);
 			InvalidateWindow(hDlg);
+			UpdatePreview(hPreview);
 
 			return TRUE;
 		case IDC_OK:
@@ -340,18 +430,16 @@ BOOL WINAPI ScreenSaverConfigureDialog(HWND hDlg, UINT message, WPARAM wParam, L
 		}
 		break;
 	case WM_HSCROLL:
-		// Track bar notifications
-		switch (LOWORD(wParam)) {
-		case TB_ENDTRACK:
-			switch (GetDlgCtrlID((HWND)lParam)) {
-			case IDC_SCALE:
-				settings.scale = SendMessage(hScale, TBM_GETPOS, 0, 0);
-				return TRUE;
-			case IDC_SPACE:
-				settings.space = SendMessage(hSpace, TBM_GETPOS, 0, 0);
-				return TRUE;
-			}
-			break;
+		// Track bar notifications, including every move while dragging
+		switch (GetDlgCtrlID((HWND)lParam)) {
+		case IDC_SCALE:
+			settings.scale = SendMessage(hScale, TBM_GETPOS, 0, 0);
+			UpdatePreview(hPreview);
+			return TRUE;
+		case IDC_SPACE:
+			settings.space = SendMessage(hSpace, TBM_GETPOS, 0, 0);
+			UpdatePreview(hPreview);
+			return TRUE;
 		}
 		break;
 	case WM_CTLCOLORBTN:
@@ -370,24 +458,39 @@ BOOL WINAPI ScreenSaverConfigureDialog(HWND hDlg, UINT message, WPARAM wParam, L
 			break;
 		}
 		break;
+	case WM_TIMECHANGE:
+		// Only top-level windows receive this, so pass it on to the preview
+		SendMessage(hPreview, WM_TIMECHANGE, wParam, lParam);
+		break;
 	case WM_CLOSE:
 		// Close dialog
 		EndDialog(hDlg, FALSE);
 		return TRUE;
+	case WM_DESTROY:
+		// Release button brushes
+		ReleaseGdiObject(hFgBrush);
+		ReleaseGdiObject(hBgBrush);
+		hFgBrush = hBgBrush = NULL;
+
+		// Settings point into the properties, neither is used after this
+		FreeProperties(&properties);
+		break;
+	case WM_NCDESTROY:
+		// Sent after the preview control was destroyed along with its fonts
+		if (hPreviewFont) {
+			RemoveFontMemResourceEx(hPreviewFont);
+			hPreviewFont = NULL;
+		}
+		break;
 	}
 
 	return FALSE;
 }
 
-BOOL WINAPI RegisterDialogClasses(HANDLE hInst) {
-	return TRUE;
-}
-
-HANDLE AddFontFromResource(PWSTR resID, DWORD *installed) {
+// Retrieves the data of a font resource, which stays loaded with the module.
+static PVOID LockFontResource(PWSTR resID, DWORD *length) {
 	HMODULE hMod = GetModuleHandle(NULL);
 
-	*installed = 0;
-
 	// Locate the resource
 	HRSRC res = FindResource(hMod, resID, RT_FONT);
 	if (!res) {
@@ -395,8 +498,8 @@ HANDLE AddFontFromResource(PWSTR resID, DWORD *installed) {
 	}
 
 	// Retrieve its size
-	DWORD length = SizeofResource(hMod, res);
-	if (length == 0 && GetLastError() != ERROR_SUCCESS) {
+	*length = SizeofResource(hMod, res);
+	if (*length == 0 && GetLastError() != ERROR_SUCCESS) {
 		return NULL;
 	}
 
@@ -407,7 +510,14 @@ HANDLE AddFontFromResource(PWSTR resID, DWORD *installed) {
 	}
 
 	// Retrieve pointer to resource data
-	PVOID resData = LockResource(resAddr);
+	return LockResource(resAddr);
+}
+
+HANDLE AddFontFromResource(PWSTR resID, DWORD *installed) {
+	*installed = 0;
+
+	DWORD length;
+	PVOID resData = LockFontResource(resID, &length);
 	if (!resData) {
 		return NULL;
 	}
@@ -416,32 +526,207 @@ HANDLE AddFontFromResource(PWSTR resID, DWORD *installed) {
 	return AddFontMemResourceEx(resData, length, 0, installed);
 }
 
-static void IntToTwoDigits(WORD w, PWSTR out) {
-	out[0] = '0' + (w / 10);
-	out[1] = '0' + (w % 10);
-	out[2] = '\0';
+// Loads a font resource for the software renderer, which unlike GDI does not
+// need it to be registered.
+static BOOL LoadFontFromResource(PWSTR resID, PTTFONT font) {
+	DWORD length;
+	PVOID resData = LockFontResource(resID, &length);
+	if (!resData) {
+		return FALSE;
+	}
+
+	// The font takes ownership of a copy
+	PBYTE data = malloc(length);
+	if (!data) {
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return FALSE;
+	}
+	CopyMemory(data, resData, length);
+
+	return LoadTrueTypeFontFromMemory(font, data, length);
+}
+
+// Checks whether the renderer draws the bundled font, see FillFace.
+static BOOL UsesBundledFont(PSETTINGS settings) {
+	return !settings->useCustomFont || !settings->fontName;
 }
 
-static HANDLE CreateClockFont(UINT size, PSETTINGS settings, PWSTR defFontName) {
-	PWSTR fontName;
-	UINT weight;
-	BOOL italic;
+// Resolves the time zone of every clock into a time cache. Unknown zones show
+// local time, but let the user know.
+static void InitClockTimeCaches(PSETTINGS settings, PLOCAL_TIME_CACHE caches) {
+	for (UINT i = 0; i < GetClockCount(settings); i++) {
+		CLOCK_ZONE zone;
+		if (!ResolveClockZone(settings->nClocks ? settings->clocks[i].zone : NULL, &zone)) {
+			WCHAR msg[128];
+			wsprintf(msg, TEXT("ClockScreenSaver: unknown time zone %.64s, using local time\n"),
+				settings->clocks[i].zone);
+			OutputDebugString(msg);
+		}
+		InitLocalTimeCache(&caches[i], &zone);
+	}
+}
 
-	if (settings->useCustomFont && settings->fontName) {
-		fontName = settings->fontName;
-		weight = settings->fontWeight;
-		italic = settings->fontItalic;
+static void InvalidateClockTimeCaches(PSETTINGS settings, PLOCAL_TIME_CACHE caches) {
+	for (UINT i = 0; i < GetClockCount(settings); i++) {
+		InvalidateLocalTimeCache(&caches[i]);
 	}
-	else {
-		fontName = defFontName;
-		weight = FW_DONTCARE;
-		italic = FALSE;
+}
+
+// Converts a UTC time into the times of all clocks and renders them.
+static void RenderCurrentTimes(PCLOCK_RENDERER renderer, HDC hdc, const RECT *rc, PSETTINGS settings,
+	PLOCAL_TIME_CACHE caches, LONGLONG utc) {
+	CLOCK_TIME times[MAX_CLOCKS];
+	GetCachedLocalTimesAt(caches, GetClockCount(settings), utc, times);
+	RenderClock(renderer, hdc, rc, settings, times, utc);
+}
+
+// Same with the software renderer. Copies what changed to the window, or the
+// whole surface if all is TRUE. The burn-in drift does not apply.
+static void RenderCurrentTimesToSurface(PSW_RENDERER renderer, HDC hdc, const RECT *rc, PSETTINGS settings,
+	PLOCAL_TIME_CACHE caches, LONGLONG utc, BOOL all) {
+	CLOCK_TIME times[MAX_CLOCKS];
+	GetCachedLocalTimesAt(caches, GetClockCount(settings), utc, times);
+	if (!RenderClockToSurface(renderer, rc->right - rc->left, rc->bottom - rc->top, settings, times)) {
+		return;
+	}
+
+	PSURFACE surface = &renderer->surface;
+	RECT dirty = renderer->compositor.dirtyRect;
+	if (all) {
+		SetRect(&dirty, 0, 0, surface->width, surface->height);
+	}
+	if (IsRectEmpty(&dirty)) {
+		return;
+	}
+
+	// Describe only the dirty rows, top-down, so that their first row is the
+	// origin of the source
+	int height = dirty.bottom - dirty.top;
+	BITMAPINFO bmi;
+	ZeroMemory(&bmi, sizeof(bmi));
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = surface->stride;
+	bmi.bmiHeader.biHeight = -height;
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+
+	SetDIBitsToDevice(hdc, rc->left + dirty.left, rc->top + dirty.top, dirty.right - dirty.left, height,
+		dirty.left, 0, 0, height, surface->pixels + (SIZE_T)dirty.top * surface->stride, &bmi, DIB_RGB_COLORS);
+}
+
+// Logs the time from WM_CREATE to the first frame, once.
+static void ReportStartup(PSTARTUP_PROFILE startup) {
+	if (!EndStartupProfile(startup, TEXT("first frame"))) return;
+
+	WCHAR text[STARTUP_PROFILE_MAX_CHARS], msg[STARTUP_PROFILE_MAX_CHARS + 64];
+	FormatStartupProfile(startup, text, STARTUP_PROFILE_MAX_CHARS);
+	BOOL slow = fChildPreview && GetStartupTime(startup) > PREVIEW_STARTUP_TARGET_US;
+	wsprintf(msg, TEXT("ClockScreenSaver: %s startup %s%s\n"), fChildPreview ? TEXT("preview") : TEXT("full screen"),
+		text, slow ? TEXT(" (over target)") : TEXT(""));
+	OutputDebugString(msg);
+}
+
+// State of a preview control in the configuration dialog
+typedef struct {
+	CLOCK_RENDERER renderer;
+	LOCAL_TIME_CACHE timeCaches[MAX_CLOCKS];
+	PSETTINGS settings;
+	TIME_SOURCE timeSource;
+	FRAME_SCHEDULER scheduler;
+	UINT_PTR uTimer;
+} PREVIEW, *PPREVIEW;
+
+static WCHAR previewFontName[LF_FACESIZE];
+
+// Window procedure of the preview control. It draws the settings passed via
+// PVM_SETSETTINGS with the same renderer as the screen saver itself.
+static LRESULT CALLBACK PreviewProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+	PPREVIEW preview = (PPREVIEW)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+	PAINTSTRUCT ps;
+	HDC hdc;
+	RECT rc;
+	FRAME_TICK tick;
+
+	switch (message) {
+	case WM_CREATE:
+		preview = calloc(1, sizeof(PREVIEW));
+		if (!preview) return -1;
+
+		InitClockRenderer(&preview->renderer, previewFontName);
+		InitSystemTimeSource(&preview->timeSource);
+		InitFrameScheduler(&preview->scheduler, &preview->timeSource, FRAME_INTERVAL, FRAME_SLACK);
+		preview->uTimer = SetTimer(hwnd, 1, GetFrameDelay(&preview->scheduler, GetSourceUtcMs(&preview->timeSource)),
+			NULL);
+		SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)preview);
+		return 0;
+	case PVM_SETSETTINGS:
+		if (!preview) return 0;
+		preview->settings = (PSETTINGS)lParam;
+		InitClockTimeCaches(preview->settings, preview->timeCaches);
+		InvalidateRect(hwnd, NULL, FALSE);
+		return 0;
+	case WM_TIMER:
+		if (!preview) return 0;
+
+		// Only draw what changed since the last frame
+		TickFrameScheduler(&preview->scheduler, &tick);
+		if (tick.render && preview->settings) {
+			hdc = GetDC(hwnd);
+			GetClientRect(hwnd, &rc);
+			RenderCurrentTimes(&preview->renderer, hdc, &rc, preview->settings, preview->timeCaches, tick.utcMs);
+			ReleaseDC(hwnd, hdc);
+		}
+		preview->uTimer = SetTimer(hwnd, 1, tick.delayMs, NULL);
+		return 0;
+	case WM_TIMECHANGE:
+		if (preview && preview->settings) {
+			InvalidateClockTimeCaches(preview->settings, preview->timeCaches);
+		}
+		return 0;
+	case WM_ERASEBKGND:
+		// The renderer covers the whole client area
+		return TRUE;
+	case WM_PAINT:
+		BeginPaint(hwnd, &ps);
+		if (preview && preview->settings) {
+			GetClientRect(hwnd, &rc);
+			InvalidateClockRenderer(&preview->renderer);
+			RenderCurrentTimes(&preview->renderer, ps.hdc, &rc, preview->settings, preview->timeCaches,
+				GetSourceUtcMs(&preview->timeSource));
+		}
+		EndPaint(hwnd, &ps);
+		return 0;
+	case WM_DESTROY:
+		if (preview) {
+			if (preview->uTimer) {
+				KillTimer(hwnd, preview->uTimer);
+			}
+			FreeClockRenderer(&preview->renderer);
+			free(preview);
+			SetWindowLongPtr(hwnd, GWLP_USERDATA, 0);
+		}
+		return 0;
 	}
 
-	LOGFONT lfont;
-	CreateLFont(&lfont, fontName, size, weight, italic);
+	return DefWindowProc(hwnd, message, wParam, lParam);
+}
 
-	return CreateFontIndirect(&lfont);
+BOOL WINAPI RegisterDialogClasses(HANDLE hInst) {
+	// The preview uses the bundled font just like the screen saver
+	DWORD nFontsInstalled;
+	hPreviewFont = AddFontFromResource(MAKEINTRESOURCE(ID_DEFAULT_FONT_FILE), &nFontsInstalled);
+	LoadString(hInst, IDS_DEFAULT_FONT_NAME, previewFontName, LF_FACESIZE);
+
+	WNDCLASS wc;
+	ZeroMemory(&wc, sizeof(wc));
+	wc.style = CS_HREDRAW | CS_VREDRAW;
+	wc.lpfnWndProc = PreviewProc;
+	wc.hInstance = hInst;
+	wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+	wc.lpszClassName = PREVIEW_CLASS;
+
+	return RegisterClass(&wc) != 0;
 }
 
 LRESULT WINAPI ScreenSaverProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
@@ -452,32 +737,78 @@ LRESULT WINAPI ScreenSaverProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lP
 	static PROPERTIES   properties;
 	static SETTINGS     settings;
 	static HBRUSH       hBgBrush;
+	static CLOCK_RENDERER renderer;
+	static LOCAL_TIME_CACHE timeCaches[MAX_CLOCKS];
+	static STARTUP_PROFILE startup;
+	static TIME_SOURCE  timeSource;
+	static FRAME_SCHEDULER scheduler;
+
+	// The preview in Display Settings uses the software renderer when it draws
+	// the bundled font
+	static BOOL         useSwRenderer;
+	static TTFONT       bundledFont;
+	static SW_RENDERER  swRenderer;
+	static BOOL         presentAll;
 
 	// Other local variables which do not need to be preserved
 	HDC                 hdc;
 	RECT                rc;
+	PAINTSTRUCT         ps;
+	PROFILE_TARGET      target;
+	WCHAR               hostName[MAX_HOST_NAME];
+	FRAME_TICK          tick;
 
 	switch (message) {
 	case WM_CREATE:
+		BeginStartupProfile(&startup);
+
 		// Retrieve the application name from the .rc file.
 		LoadString(hMainInstance, idsAppName, szAppName, APPNAMEBUFFERLEN);
 
-		// Load settings
-		if (!LoadSettingsOrUseDefaults(&properties, &settings)) {
+		// Load settings. One window covers all monitors, so the profiles
+		// are resolved for the primary monitor and the size of the window.
+		GetClientRect(hwnd, &rc);
+		target.host = GetPlatformHostName(hostName, MAX_HOST_NAME) ? hostName : NULL;
+		target.monitor = 1;
+		target.width = rc.right - rc.left;
+		target.height = rc.bottom - rc.top;
+		if (!LoadSettingsOrUseDefaults(&properties, &settings, &target)) {
 			ErrorMessageBox(hwnd, L"Failed to load configuration", MB_OK);
 			DestroyWindow(hwnd);
 			return TRUE;
 		}
 
-		DWORD nFontsInstalled;
-		hDefaultFont = AddFontFromResource(MAKEINTRESOURCE(ID_DEFAULT_FONT_FILE), &nFontsInstalled);
+		MarkStartupPhase(&startup, TEXT("settings"));
+
+		// A preview is started every time Display Settings shows it, and
+		// registering the bundled font with GDI is the largest part of that.
+		// Custom fonts are installed, so the bundled one is only registered
+		// when GDI actually draws it.
+		if (UsesBundledFont(&settings)) {
+			if (fChildPreview && LoadFontFromResource(MAKEINTRESOURCE(ID_DEFAULT_FONT_FILE), &bundledFont)) {
+				InitSwRenderer(&swRenderer, &bundledFont, NULL);
+				useSwRenderer = TRUE;
+			}
+			else {
+				DWORD nFontsInstalled;
+				hDefaultFont = AddFontFromResource(MAKEINTRESOURCE(ID_DEFAULT_FONT_FILE), &nFontsInstalled);
+			}
+		}
 		LoadString(hMainInstance, IDS_DEFAULT_FONT_NAME, defaultFontName, 32);
+		MarkStartupPhase(&startup, TEXT("font"));
 
 		// Background brush
-		hBgBrush = CreateSolidBrush(settings.bgColor);
+		hBgBrush = AcquireSolidBrush(settings.bgColor);
+
+		InitClockRenderer(&renderer, defaultFontName);
+		InitClockTimeCaches(&settings, timeCaches);
+		MarkStartupPhase(&startup, TEXT("time zones"));
 
-		// Set a timer for the screen saver window.
-		uTimer = SetTimer(hwnd, 1, 200, NULL);
+		// Set a timer for the screen saver window. Every tick sets it again
+		// to fire just after the next second.
+		InitSystemTimeSource(&timeSource);
+		InitFrameScheduler(&scheduler, &timeSource, FRAME_INTERVAL, FRAME_SLACK);
+		uTimer = SetTimer(hwnd, 1, GetFrameDelay(&scheduler, GetSourceUtcMs(&timeSource)), NULL);
 
 		break;
 	case WM_ERASEBKGND:
@@ -489,96 +820,103 @@ LRESULT WINAPI ScreenSaverProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lP
 		FillRect(hdc, &rc, hBgBrush);
 		ReleaseDC(hwnd, hdc);
 
+		// The next frame needs to be presented in full
+		InvalidateClockRenderer(&renderer);
+		presentAll = TRUE;
+
 		return TRUE;
+	case WM_PAINT:
+		// Draw the first frame as soon as the window is shown rather than at
+		// the first tick, and redraw whatever was uncovered later on
+		hdc = BeginPaint(hwnd, &ps);
+		GetClientRect(hwnd, &rc);
+		if (useSwRenderer) {
+			RenderCurrentTimesToSurface(&swRenderer, hdc, &rc, &settings, timeCaches, GetSourceUtcMs(&timeSource),
+				TRUE);
+		}
+		else {
+			InvalidateClockRenderer(&renderer);
+			RenderCurrentTimes(&renderer, hdc, &rc, &settings, timeCaches, GetSourceUtcMs(&timeSource));
+		}
+		presentAll = FALSE;
+		EndPaint(hwnd, &ps);
+
+		ReportStartup(&startup);
+		return 0;
 	case WM_TIMER:
+		// A timer that fired early renders nothing, a late one renders once
+		TickFrameScheduler(&scheduler, &tick);
+		uTimer = SetTimer(hwnd, 1, tick.delayMs, NULL);
+		if (!tick.render) {
+			return TRUE;
+		}
+
+		// After a resume or a step of the clock, start over as after
+		// WM_TIMECHANGE and present in full
+		if (tick.jumped) {
+			InvalidateClockTimeCaches(&settings, timeCaches);
+			InvalidateClockRenderer(&renderer);
+			presentAll = TRUE;
+		}
+
 		// First, retrieve the device context
 		hdc = GetDC(hwnd);
 		// and the associated client area
 		GetClientRect(hwnd, &rc);
 
-		// Obtain the size of the client area
-		SIZE szrc;
-		RectToSize(&rc, &szrc);
-
-		// Start double-buffering
-		HDC memhdc = CreateCompatibleDC(hdc);
-		HBITMAP membitmap = CreateCompatibleBitmap(hdc, szrc.cx, szrc.cy);
-		SelectObject(memhdc, membitmap);
-
-		// Paint background
-		FillRect(memhdc, &rc, hBgBrush);
-
-		// Retrieve the current time
-		SYSTEMTIME time;
-		GetLocalTime(&time);
-
-		// Number of units to display
-		UINT nUnits = settings.showSeconds ? 3 : 2;
-
-		// Generate text blocks
-		WCHAR units[3][3];
-		IntToTwoDigits(time.wHour, units[0]);
-		IntToTwoDigits(time.wMinute, units[1]);
-		IntToTwoDigits(time.wSecond, units[2]);
-
-		// Layout parameters
-		int availableWidth = szrc.cx * settings.scale / 100;
-		int widthPerUnit = availableWidth / nUnits;
-		int textWidthPerUnit = widthPerUnit * (100 - settings.space) / 100;
-		LONG marginX = szrc.cx * (100 - settings.scale) / 2 / 100;
-		LONG offsetX = rc.left + marginX;
-
-		// Ensure that logic units map to pixels
-		SetMapMode(memhdc, MM_TEXT);
-
-		// Create a font with maximal height
-		HANDLE hFont = CreateClockFont(szrc.cy, &settings, defaultFontName);
-		SelectObject(memhdc, hFont);
-
-		// Measure how big the text will be
-		SIZE textSize;
-		GetTextExtentPoint32(memhdc, TEXT("00"), 2, &textSize);
-
-		// Calculate how to scale the text
-		float f = max((float)textSize.cx / textWidthPerUnit, 1);
-		int newTextSize = (int)(szrc.cy / f);
-
-		// Replace the font with a new object with the correct size
-		DeleteObject(hFont);
-		hFont = CreateClockFont(newTextSize, &settings, defaultFontName);
-		SelectObject(memhdc, hFont);
-
-		// Prepare text drawing
-		SetTextColor(memhdc, settings.fgColor);
-		SetBkColor(memhdc, settings.bgColor);
-		SetBkMode(memhdc, OPAQUE);
-
-		// Draw all units
-		for (UINT i = 0; i < nUnits; i++) {
-			RECT rect = {
-				.left = offsetX + widthPerUnit * i,
-				.right = offsetX + widthPerUnit * (i + 1),
-				.top = rc.top,
-				.bottom = rc.bottom
-			};
-			DrawText(memhdc, units[i], 2, &rect, DT_CENTER | DT_SINGLELINE | DT_VCENTER);
+		if (useSwRenderer) {
+			RenderCurrentTimesToSurface(&swRenderer, hdc, &rc, &settings, timeCaches, tick.utcMs, presentAll);
 		}
-
-		// End double-buffering
-		BitBlt(hdc, rc.left, rc.top, szrc.cx, szrc.cy, memhdc, 0, 0, SRCCOPY);
-		DeleteObject(membitmap);
-		DeleteDC(memhdc);
+		else {
+			RenderCurrentTimes(&renderer, hdc, &rc, &settings, timeCaches, tick.utcMs);
+		}
+		presentAll = FALSE;
 
 		// End drawing
 		ReleaseDC(hwnd, hdc);
+		ReportStartup(&startup);
 
 		return TRUE;
+	case WM_TIMECHANGE:
+		// The system time or the time zone changed
+		InvalidateClockTimeCaches(&settings, timeCaches);
+		break;
 	case WM_DESTROY:
 		// Destroy our timer
 		if (uTimer) {
 			KillTimer(hwnd, uTimer);
 		}
 
+		// Release cached GDI objects
+		FreeClockRenderer(&renderer);
+		if (useSwRenderer) {
+			FreeSwRenderer(&swRenderer);
+			FreeTrueTypeFont(&bundledFont);
+			useSwRenderer = FALSE;
+		}
+		ReleaseGdiObject(hBgBrush);
+		hBgBrush = NULL;
+
+		FreeProperties(&properties);
+		if (hDefaultFont) {
+			RemoveFontMemResourceEx(hDefaultFont);
+			hDefaultFont = NULL;
+		}
+
+		// Report the peak, and what is still held after releasing everything
+		MEMORY_USAGE usage;
+		GetMemoryUsage(&usage);
+		WCHAR usageText[MEMORY_USAGE_MAX_CHARS], msg[MEMORY_USAGE_MAX_CHARS + 32];
+		FormatMemoryUsage(&usage, usageText, MEMORY_USAGE_MAX_CHARS);
+		wsprintf(msg, TEXT("ClockScreenSaver: memory %s\n"), usageText);
+		OutputDebugString(msg);
+
+		// Anything still held at this point has leaked
+		if (GetLiveGdiObjectCount() != 0) {
+			wsprintf(msg, TEXT("ClockScreenSaver: %u GDI objects leaked\n"), GetLiveGdiObjectCount());
+			OutputDebugString(msg);
+		}
+
 		break;
 	}
 
@@ -1,68 +1,251 @@
 #include "settings.h"
 
-SETTINGS defaultSettings = {
-	.scale = 80,
-	.space = 20,
-	.showSeconds = TRUE,
-	.useCustomFont = FALSE,
-	.fontName = L"",
-	.fontWeight = FW_DONTCARE,
-	.fontItalic = FALSE,
-	.fgColor = RGB(255, 255, 255),
-	.bgColor = RGB(0, 0, 0)
+typedef enum {
+	SETTING_UINT,
+	SETTING_BOOL,
+	SETTING_RGB,
+	SETTING_STRING
+} SETTING_TYPE;
+
+// Describes how a property maps to a field of SETTINGS. A '#' in the key
+// stands for a one-based index into an array of count elements that are
+// stride bytes apart.
+typedef struct {
+	PCWSTR key;
+	SETTING_TYPE type;
+	SIZE_T offset;
+	UINT min;
+	UINT max;
+	union {
+		UINT u;
+		BOOL b;
+		COLORREF rgb;
+		PCWSTR str;
+	} def;
+	UINT count;
+	SIZE_T stride;
+} SETTING_DESCRIPTOR;
+
+#define UINT_SETTING(key, field, min, max, def) \
+	{ key, SETTING_UINT, FIELD_OFFSET(SETTINGS, field), min, max, { .u = def }, 1, 0 }
+#define BOOL_SETTING(key, field, def) \
+	{ key, SETTING_BOOL, FIELD_OFFSET(SETTINGS, field), 0, 0, { .b = def }, 1, 0 }
+#define RGB_SETTING(key, field, def) \
+	{ key, SETTING_RGB, FIELD_OFFSET(SETTINGS, field), 0, 0, { .rgb = def }, 1, 0 }
+#define STRING_SETTING(key, field, def) \
+	{ key, SETTING_STRING, FIELD_OFFSET(SETTINGS, field), 0, 0, { .str = def }, 1, 0 }
+#define CLOCK_STRING_SETTING(key, field) \
+	{ key, SETTING_STRING, FIELD_OFFSET(SETTINGS, clocks[0].field), 0, 0, { .str = NULL }, MAX_CLOCKS, sizeof(CLOCK_SPEC) }
+
+static const SETTING_DESCRIPTOR schema[] = {
+	UINT_SETTING(L"scale", scale, 0, 100, 80),
+	UINT_SETTING(L"space", space, 0, 100, 20),
+	BOOL_SETTING(L"showSeconds", showSeconds, TRUE),
+	BOOL_SETTING(L"use12HourClock", use12HourClock, FALSE),
+	BOOL_SETTING(L"useCustomFont", useCustomFont, FALSE),
+	STRING_SETTING(L"fontName", fontName, L""),
+	UINT_SETTING(L"fontWeight", fontWeight, 0, 1000, FW_DONTCARE),
+	BOOL_SETTING(L"fontItalic", fontItalic, FALSE),
+	RGB_SETTING(L"bgColor", bgColor, RGB(0, 0, 0)),
+	RGB_SETTING(L"fgColor", fgColor, RGB(255, 255, 255)),
+	UINT_SETTING(L"driftRange", driftRange, 0, 64, 0),
+	UINT_SETTING(L"driftPeriod", driftPeriod, 10, 86400, 600),
+	UINT_SETTING(L"memoryBudget", memoryBudget, 0, 4096, 0),
+	CLOCK_STRING_SETTING(L"clock.#.zone", zone),
+	CLOCK_STRING_SETTING(L"clock.#.label", label)
 };
 
-void PropertiesToSettings(PSETTINGS settings, PPROPERTIES props) {
-	if (!GetUIntProperty(props, L"scale", &settings->scale)) {
-		settings->scale = defaultSettings.scale;
-	}
+#define SCHEMA_SIZE (sizeof(schema) / sizeof(schema[0]))
 
-	if (!GetUIntProperty(props, L"space", &settings->space)) {
-		settings->space = defaultSettings.space;
+static PVOID GetField(PSETTINGS settings, const SETTING_DESCRIPTOR *desc, UINT index) {
+	return (PBYTE)settings + desc->offset + index * desc->stride;
+}
+
+// Matches key against the key of desc and extracts the zero-based index.
+static BOOL MatchKey(const SETTING_DESCRIPTOR *desc, PCWSTR key, PUINT index) {
+	PCWSTR pattern = desc->key;
+	*index = 0;
+
+	for (; *pattern; pattern++, key++) {
+		if (*pattern != '#') {
+			if (*pattern != *key) return FALSE;
+			continue;
+		}
+
+		// Parse a one-based index without leading zeros
+		if (*key < '1' || *key > '9') return FALSE;
+		UINT n = 0;
+		while (*key >= '0' && *key <= '9' && n <= desc->count) {
+			n = n * 10 + (*key++ - '0');
+		}
+		if (n > desc->count) return FALSE;
+		*index = n - 1;
+		key--;
 	}
 
-	if (!GetBoolProperty(props, L"showSeconds", &settings->showSeconds)) {
-		settings->showSeconds = defaultSettings.showSeconds;
+	return *key == '\0';
+}
+
+static BOOL ParseSetting(const SETTING_DESCRIPTOR *desc, PWSTR value, PVOID field) {
+	UINT u;
+
+	switch (desc->type) {
+	case SETTING_UINT:
+		if (!ParseUIntValue(value, &u) || u < desc->min || u > desc->max) return FALSE;
+		*(PUINT)field = u;
+		return TRUE;
+	case SETTING_BOOL:
+		return ParseBoolValue(value, (PBOOL)field);
+	case SETTING_RGB:
+		return ParseRgbValue(value, (LPCOLORREF)field);
+	case SETTING_STRING:
+		*(PWSTR *)field = value;
+		return TRUE;
 	}
 
-	if (!GetBoolProperty(props, L"useCustomFont", &settings->useCustomFont)) {
-		settings->useCustomFont = defaultSettings.useCustomFont;
+	return FALSE;
+}
+
+static void SetDefault(const SETTING_DESCRIPTOR *desc, PVOID field) {
+	switch (desc->type) {
+	case SETTING_UINT:
+		*(PUINT)field = desc->def.u;
+		break;
+	case SETTING_BOOL:
+		*(PBOOL)field = desc->def.b;
+		break;
+	case SETTING_RGB:
+		*(LPCOLORREF)field = desc->def.rgb;
+		break;
+	case SETTING_STRING:
+		*(PWSTR *)field = (PWSTR)desc->def.str;
+		break;
 	}
+}
 
-	settings->fontName = GetProperty(props, L"fontName");
-	if (!settings->fontName) {
-		settings->fontName = defaultSettings.fontName;
+static void SerializeSetting(const SETTING_DESCRIPTOR *desc, PVOID field, PWSTR key, PPROPERTIES props) {
+	switch (desc->type) {
+	case SETTING_UINT:
+		SetUIntProperty(props, key, *(PUINT)field);
+		break;
+	case SETTING_BOOL:
+		SetBoolProperty(props, key, *(PBOOL)field);
+		break;
+	case SETTING_RGB:
+		SetRgbProperty(props, key, *(LPCOLORREF)field);
+		break;
+	case SETTING_STRING:
+		// A string that is not set is removed, e.g. the zones of clocks
+		// dropped by restoring the defaults, so that its default applies again
+		if (!*(PWSTR *)field) {
+			RemoveProperty(props, key);
+		}
+		// The setting may point at the value that this replaces and frees,
+		// so point it at the new copy
+		else if (SetProperty(props, key, *(PWSTR *)field)) {
+			*(PWSTR *)field = GetProperty(props, key);
+		}
+		break;
 	}
+}
 
-	if (!GetUIntProperty(props, L"fontWeight", &settings->fontWeight)) {
-		settings->fontWeight = defaultSettings.fontWeight;
+// Counts the clocks up to the first one without a zone.
+static void CountClocks(PSETTINGS settings) {
+	settings->nClocks = 0;
+	while (settings->nClocks < MAX_CLOCKS && settings->clocks[settings->nClocks].zone) {
+		settings->nClocks++;
 	}
 
-	if (!GetBoolProperty(props, L"fontItalic", &settings->fontItalic)) {
-		settings->fontItalic = defaultSettings.fontItalic;
+	for (UINT i = settings->nClocks; i < MAX_CLOCKS; i++) {
+		settings->clocks[i].zone = NULL;
+		settings->clocks[i].label = NULL;
 	}
+}
 
-	if (!GetRgbProperty(props, L"bgColor", &settings->bgColor)) {
-		settings->bgColor = defaultSettings.bgColor;
+BOOL FindSetting(PCWSTR key, SETTING_ID *id) {
+	for (UINT j = 0; j < SCHEMA_SIZE; j++) {
+		UINT index;
+		if (MatchKey(&schema[j], key, &index)) {
+			*id = j * MAX_CLOCKS + index;
+			return TRUE;
+		}
 	}
+	return FALSE;
+}
+
+BOOL ApplySetting(PSETTINGS settings, SETTING_ID id, PWSTR value) {
+	const SETTING_DESCRIPTOR *desc = &schema[id / MAX_CLOCKS];
+	return ParseSetting(desc, value, GetField(settings, desc, id % MAX_CLOCKS));
+}
+
+void CompleteSettings(PSETTINGS settings) {
+	CountClocks(settings);
+}
+
+UINT PropertiesToSettings(PSETTINGS settings, PPROPERTIES props, PWSTR *rejected, UINT maxRejected) {
+	RestoreDefaultSettings(settings);
+
+	UINT nRejected = 0;
+	for (UINT i = 0; i < props->count; i++) {
+		PPROPERTY prop = &props->items[i];
 
-	if (!GetRgbProperty(props, L"fgColor", &settings->fgColor)) {
-		settings->fgColor = defaultSettings.fgColor;
+		SETTING_ID id;
+		if (FindSetting(prop->name, &id) && !ApplySetting(settings, id, prop->value)) {
+			if (nRejected < maxRejected) {
+				rejected[nRejected] = prop->name;
+			}
+			nRejected++;
+		}
 	}
+
+	CompleteSettings(settings);
+
+	return nRejected;
 }
 
 void SettingsToProperties(PSETTINGS settings, PPROPERTIES props) {
-	SetUIntProperty(props, L"scale", settings->scale);
-	SetUIntProperty(props, L"space", settings->space);
-	SetBoolProperty(props, L"showSeconds", settings->showSeconds);
-	SetBoolProperty(props, L"useCustomFont", settings->useCustomFont);
-	SetProperty(props, L"fontName", settings->fontName);
-	SetUIntProperty(props, L"fontWeight", settings->fontWeight);
-	SetBoolProperty(props, L"fontItalic", settings->fontItalic);
-	SetRgbProperty(props, L"bgColor", settings->bgColor);
-	SetRgbProperty(props, L"fgColor", settings->fgColor);
+	for (UINT j = 0; j < SCHEMA_SIZE; j++) {
+		const SETTING_DESCRIPTOR *desc = &schema[j];
+
+		if (desc->count == 1) {
+			SerializeSetting(desc, GetField(settings, desc, 0), (PWSTR)desc->key, props);
+			continue;
+		}
+
+		// Replace '#' by the index
+		WCHAR key[64];
+		PCWSTR hash = wcschr(desc->key, '#');
+		for (UINT i = 0; i < desc->count; i++) {
+			SIZE_T prefixLen = hash - desc->key;
+			wcsncpy_s(key, 64, desc->key, prefixLen);
+			swprintf(key + prefixLen, 64 - prefixLen, L"%u", i + 1);
+			wcscat_s(key, 64, hash + 1);
+			SerializeSetting(desc, GetField(settings, desc, i), key, props);
+		}
+	}
 }
 
 void RestoreDefaultSettings(PSETTINGS settings) {
-	CopyMemory(settings, &defaultSettings, sizeof(SETTINGS));
+	ZeroMemory(settings, sizeof(SETTINGS));
+
+	for (UINT j = 0; j < SCHEMA_SIZE; j++) {
+		for (UINT i = 0; i < schema[j].count; i++) {
+			SetDefault(&schema[j], GetField(settings, &schema[j], i));
+		}
+	}
+
+	CountClocks(settings);
+}
+
+UINT GetClockCount(PSETTINGS settings) {
+	return settings->nClocks ? settings->nClocks : 1;
+}
+
+BOOL HasClockLabels(PSETTINGS settings) {
+	for (UINT i = 0; i < settings->nClocks; i++) {
+		if (settings->clocks[i].label && settings->clocks[i].label[0]) {
+			return TRUE;
+		}
+	}
+	return FALSE;
 }
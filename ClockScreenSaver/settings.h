@@ -1,22 +1,66 @@
 #pragma once
 
-#include <Windows.h>
+#include "platform.h"
 #include "properties.h"
 
+// Maximum number of clocks shown side by side
+#define MAX_CLOCKS 12
+
+typedef struct {
+	PWSTR zone;
+	PWSTR label;
+} CLOCK_SPEC, *PCLOCK_SPEC;
+
 typedef struct {
 	UINT scale;
 	UINT space;
 	BOOL showSeconds;
+	BOOL use12HourClock;
 	BOOL useCustomFont;
 	PWSTR fontName;
 	UINT fontWeight;
 	BOOL fontItalic;
 	COLORREF fgColor;
 	COLORREF bgColor;
+	// Burn-in protection: the clock face moves by up to driftRange pixels in
+	// each direction, crossing the range twice every driftPeriod seconds
+	UINT driftRange;
+	UINT driftPeriod;
+	// Megabytes that surfaces, glyphs, fonts and properties should fit into.
+	// Cheaper strategies are used when they would not, zero means no limit.
+	UINT memoryBudget;
+	// If nClocks is zero, a single clock shows the local time
+	UINT nClocks;
+	CLOCK_SPEC clocks[MAX_CLOCKS];
 } SETTINGS, *PSETTINGS;
 
-void PropertiesToSettings(PSETTINGS settings, PPROPERTIES props);
+// Extracts settings from properties in a single pass, using defaults for
+// missing or invalid values. Returns the number of properties whose values
+// were rejected and stores up to maxRejected of their names in rejected.
+UINT PropertiesToSettings(PSETTINGS settings, PPROPERTIES props, PWSTR *rejected, UINT maxRejected);
+
+// Identifies a setting, including the index of a clock
+typedef UINT SETTING_ID;
+
+// The steps of PropertiesToSettings, e.g. to look up keys once and apply
+// values from several sources. FindSetting fails for unknown keys.
+// ApplySetting returns FALSE if the value is invalid, in which case the
+// setting keeps its value. CompleteSettings must follow the last value.
+BOOL FindSetting(PCWSTR key, SETTING_ID *id);
 
+BOOL ApplySetting(PSETTINGS settings, SETTING_ID id, PWSTR value);
+
+void CompleteSettings(PSETTINGS settings);
+
+// Stores settings in props, and removes string settings that are not set.
+// String settings are pointed at their values in props afterwards, so they
+// stay valid when the values they pointed to are replaced.
 void SettingsToProperties(PSETTINGS settings, PPROPERTIES props);
 
 void RestoreDefaultSettings(PSETTINGS settings);
+
+// Returns the number of clocks to render for the given settings.
+UINT GetClockCount(PSETTINGS settings);
+
+// Checks whether any clock has a non-empty label.
+BOOL HasClockLabels(PSETTINGS settings);
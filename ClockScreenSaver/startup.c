@@ -0,0 +1,54 @@
+#include "startup.h"
+
+void BeginStartupProfile(PSTARTUP_PROFILE profile) {
+	ZeroMemory(profile, sizeof(STARTUP_PROFILE));
+	profile->start = profile->last = GetPlatformMonotonicTimeUs();
+}
+
+void MarkStartupPhase(PSTARTUP_PROFILE profile, PCWSTR name) {
+	if (profile->finished) return;
+
+	LONGLONG now = GetPlatformMonotonicTimeUs();
+	if (profile->nPhases < STARTUP_MAX_PHASES) {
+		profile->phases[profile->nPhases].name = name;
+		profile->phases[profile->nPhases].us = now - profile->last;
+		profile->nPhases++;
+	}
+	profile->last = now;
+}
+
+BOOL EndStartupProfile(PSTARTUP_PROFILE profile, PCWSTR name) {
+	if (profile->finished) return FALSE;
+
+	MarkStartupPhase(profile, name);
+	profile->finished = TRUE;
+	return TRUE;
+}
+
+LONGLONG GetStartupTime(const STARTUP_PROFILE *profile) {
+	return profile->last - profile->start;
+}
+
+static SIZE_T AppendMilliseconds(PWSTR out, SIZE_T size, SIZE_T used, PCWSTR name, LONGLONG us) {
+	if (used >= size) return used;
+
+	int n = swprintf(out + used, size - used, L"%ls%ls %lld.%02lld ms", used ? L", " : L"", name,
+		(long long)(us / 1000), (long long)(us % 1000 / 10));
+	if (n < 0) {
+		// Truncated, and not necessarily terminated
+		out[size - 1] = '\0';
+		return size;
+	}
+	return used + n;
+}
+
+void FormatStartupProfile(const STARTUP_PROFILE *profile, PWSTR out, SIZE_T size) {
+	if (size == 0) return;
+	out[0] = '\0';
+
+	SIZE_T used = 0;
+	for (UINT i = 0; i < profile->nPhases; i++) {
+		used = AppendMilliseconds(out, size, used, profile->phases[i].name, profile->phases[i].us);
+	}
+	AppendMilliseconds(out, size, used, L"total", GetStartupTime(profile));
+}
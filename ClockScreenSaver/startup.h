@@ -0,0 +1,42 @@
+#pragma once
+
+#include "platform.h"
+
+// Phases beyond this are folded into the total
+#define STARTUP_MAX_PHASES 12
+
+// Maximum number of characters written by FormatStartupProfile, including the terminator
+#define STARTUP_PROFILE_MAX_CHARS 320
+
+typedef struct {
+	PCWSTR name;
+	LONGLONG us;
+} STARTUP_PHASE;
+
+// Times consecutive phases of starting up, e.g. from WM_CREATE to the first
+// presented frame. Each phase lasts from the end of the previous one.
+typedef struct {
+	LONGLONG start;
+	LONGLONG last;
+	UINT nPhases;
+	STARTUP_PHASE phases[STARTUP_MAX_PHASES];
+	// Set by EndStartupProfile, after which phases are no longer recorded
+	BOOL finished;
+} STARTUP_PROFILE, *PSTARTUP_PROFILE;
+
+void BeginStartupProfile(PSTARTUP_PROFILE profile);
+
+// Ends the current phase and names it. name must be a string literal or
+// outlive the profile.
+void MarkStartupPhase(PSTARTUP_PROFILE profile, PCWSTR name);
+
+// Ends the last phase. Returns FALSE if the profile was already finished, so
+// that callers report it only once.
+BOOL EndStartupProfile(PSTARTUP_PROFILE profile, PCWSTR name);
+
+// Returns the microseconds from BeginStartupProfile to the last phase.
+LONGLONG GetStartupTime(const STARTUP_PROFILE *profile);
+
+// Describes the phases and the total in a single line, e.g.
+// "settings 0.42 ms, font 0.10 ms, first frame 3.05 ms, total 3.57 ms".
+void FormatStartupProfile(const STARTUP_PROFILE *profile, PWSTR out, SIZE_T size);
@@ -0,0 +1,165 @@
+#include "surface.h"
+#include "memusage.h"
+
+BOOL CreateSurface(PSURFACE surface, int width, int height) {
+	ZeroMemory(surface, sizeof(SURFACE));
+	if (width <= 0 || height <= 0) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+
+	surface->pixels = calloc((SIZE_T)width * height, sizeof(DWORD));
+	if (!surface->pixels) {
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return FALSE;
+	}
+
+	surface->width = width;
+	surface->height = height;
+	surface->stride = width;
+	TrackMemory(MEMORY_SURFACES, (LONGLONG)width * height * sizeof(DWORD));
+	return TRUE;
+}
+
+void FreeSurface(PSURFACE surface) {
+	if (surface->pixels) {
+		TrackMemory(MEMORY_SURFACES, -(LONGLONG)surface->width * surface->height * sizeof(DWORD));
+	}
+	free(surface->pixels);
+	ZeroMemory(surface, sizeof(SURFACE));
+}
+
+BOOL CreateCoverageSurface(PCOVERAGE_SURFACE surface, int width, int height) {
+	ZeroMemory(surface, sizeof(COVERAGE_SURFACE));
+	if (width <= 0 || height <= 0) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+
+	surface->coverage = calloc((SIZE_T)width * height, 1);
+	if (!surface->coverage) {
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return FALSE;
+	}
+
+	surface->width = width;
+	surface->height = height;
+	surface->stride = width;
+	TrackMemory(MEMORY_SURFACES, (LONGLONG)width * height);
+	return TRUE;
+}
+
+void FreeCoverageSurface(PCOVERAGE_SURFACE surface) {
+	if (surface->coverage) {
+		TrackMemory(MEMORY_SURFACES, -(LONGLONG)surface->width * surface->height);
+	}
+	free(surface->coverage);
+	ZeroMemory(surface, sizeof(COVERAGE_SURFACE));
+}
+
+DWORD ColorToPixel(COLORREF color) {
+	return ((DWORD)GetRValue(color) << 16) | ((DWORD)GetGValue(color) << 8) | GetBValue(color);
+}
+
+static ULONGLONG HashDword(ULONGLONG hash, DWORD value) {
+	for (int shift = 0; shift < 32; shift += 8) {
+		hash = (hash ^ ((value >> shift) & 0xFF)) * 1099511628211ull;
+	}
+	return hash;
+}
+
+ULONGLONG HashSurface(const SURFACE *surface) {
+	ULONGLONG hash = HashDword(HashDword(14695981039346656037ull, surface->width), surface->height);
+	for (int y = 0; y < surface->height; y++) {
+		const DWORD *row = surface->pixels + (SIZE_T)y * surface->stride;
+		for (int x = 0; x < surface->width; x++) {
+			hash = HashDword(hash, row[x]);
+		}
+	}
+	return hash;
+}
+
+// Intersects rect with the surface and an optional clip rect
+static BOOL ClipRect(const SURFACE *surface, const RECT *rect, const RECT *clip, PRECT out) {
+	out->left = max(rect->left, 0);
+	out->top = max(rect->top, 0);
+	out->right = min(rect->right, surface->width);
+	out->bottom = min(rect->bottom, surface->height);
+	if (clip) {
+		out->left = max(out->left, clip->left);
+		out->top = max(out->top, clip->top);
+		out->right = min(out->right, clip->right);
+		out->bottom = min(out->bottom, clip->bottom);
+	}
+	return out->left < out->right && out->top < out->bottom;
+}
+
+void FillSurfaceRect(PSURFACE surface, const RECT *rect, COLORREF color) {
+	RECT r;
+	if (!ClipRect(surface, rect, NULL, &r)) return;
+
+	DWORD pixel = ColorToPixel(color);
+	for (LONG y = r.top; y < r.bottom; y++) {
+		PDWORD row = surface->pixels + (SIZE_T)y * surface->stride;
+		for (LONG x = r.left; x < r.right; x++) {
+			row[x] = pixel;
+		}
+	}
+}
+
+// Moves one 8-bit channel of dst toward src by alpha / 255
+static DWORD BlendChannel(DWORD dst, DWORD src, DWORD alpha) {
+	DWORD v = dst * (255 - alpha) + src * alpha + 128;
+	return (v + (v >> 8)) >> 8;
+}
+
+void BlendSurfaceMask(PSURFACE surface, int x, int y, const BYTE *mask, int width, int height, SIZE_T stride,
+	COLORREF color, const RECT *clip) {
+	RECT rect = { x, y, x + width, y + height }, r;
+	if (!ClipRect(surface, &rect, clip, &r)) return;
+
+	DWORD red = GetRValue(color), green = GetGValue(color), blue = GetBValue(color);
+	DWORD pixel = ColorToPixel(color);
+
+	for (LONG py = r.top; py < r.bottom; py++) {
+		PDWORD row = surface->pixels + (SIZE_T)py * surface->stride;
+		const BYTE *src = mask + (SIZE_T)(py - y) * stride;
+		for (LONG px = r.left; px < r.right; px++) {
+			DWORD alpha = src[px - x];
+			if (alpha == 0) continue;
+			if (alpha == 255) {
+				row[px] = pixel;
+				continue;
+			}
+
+			DWORD d = row[px];
+			row[px] = (BlendChannel((d >> 16) & 0xFF, red, alpha) << 16) |
+				(BlendChannel((d >> 8) & 0xFF, green, alpha) << 8) |
+				BlendChannel(d & 0xFF, blue, alpha);
+		}
+	}
+}
+
+void CopySurfaceOffset(PSURFACE dst, const SURFACE *src, int dx, int dy, COLORREF fill) {
+	RECT all = { 0, 0, dst->width, dst->height };
+	RECT covered = { dx, dy, src->width + dx, src->height + dy }, r;
+	if (!ClipRect(dst, &covered, NULL, &r)) {
+		FillSurfaceRect(dst, &all, fill);
+		return;
+	}
+
+	// The uncovered bands above, below, left and right of the copy
+	RECT above = { 0, 0, dst->width, r.top };
+	RECT below = { 0, r.bottom, dst->width, dst->height };
+	RECT left = { 0, r.top, r.left, r.bottom };
+	RECT right = { r.right, r.top, dst->width, r.bottom };
+	FillSurfaceRect(dst, &above, fill);
+	FillSurfaceRect(dst, &below, fill);
+	FillSurfaceRect(dst, &left, fill);
+	FillSurfaceRect(dst, &right, fill);
+
+	for (LONG y = r.top; y < r.bottom; y++) {
+		CopyMemory(dst->pixels + (SIZE_T)y * dst->stride + r.left,
+			src->pixels + (SIZE_T)(y - dy) * src->stride + (r.left - dx), (r.right - r.left) * sizeof(DWORD));
+	}
+}
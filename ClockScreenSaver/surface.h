@@ -0,0 +1,51 @@
+#pragma once
+
+#include "platform.h"
+
+// A 32-bit image in memory, the portable counterpart of a GDI bitmap. Pixels
+// are stored row by row as 0x00RRGGBB.
+typedef struct {
+	int width;
+	int height;
+	int stride;
+	PDWORD pixels;
+} SURFACE, *PSURFACE;
+
+// An 8-bit image of how much each pixel is covered by a single foreground
+// color, a quarter of the size of a SURFACE. Content in one color over one
+// background, such as the clock face, is kept in this form and only turned
+// into colors when it is presented.
+typedef struct {
+	int width;
+	int height;
+	int stride;
+	PBYTE coverage;
+} COVERAGE_SURFACE, *PCOVERAGE_SURFACE;
+
+BOOL CreateSurface(PSURFACE surface, int width, int height);
+
+void FreeSurface(PSURFACE surface);
+
+// Creates a coverage surface with nothing covered.
+BOOL CreateCoverageSurface(PCOVERAGE_SURFACE surface, int width, int height);
+
+void FreeCoverageSurface(PCOVERAGE_SURFACE surface);
+
+// Converts a COLORREF (0x00BBGGRR) into the pixel format of a surface.
+DWORD ColorToPixel(COLORREF color);
+
+// FNV-1a over the size and pixels of a surface, e.g. to compare frames with
+// known good ones. Does not depend on the byte order.
+ULONGLONG HashSurface(const SURFACE *surface);
+
+// Fills a rectangle, clipped to the surface, with a solid color.
+void FillSurfaceRect(PSURFACE surface, const RECT *rect, COLORREF color);
+
+// Blends color into the surface at (x, y) using an 8-bit coverage mask with
+// the given dimensions and stride. Pixels outside of clip are not touched.
+void BlendSurfaceMask(PSURFACE surface, int x, int y, const BYTE *mask, int width, int height, SIZE_T stride,
+	COLORREF color, const RECT *clip);
+
+// Copies src into dst, which has the same size, moved by (dx, dy). The parts
+// of dst that src does not cover are filled with fill.
+void CopySurfaceOffset(PSURFACE dst, const SURFACE *src, int dx, int dy, COLORREF fill);
@@ -0,0 +1,273 @@
+#include "swrender.h"
+
+#include <math.h>
+
+void InitSwRenderer(PSW_RENDERER renderer, const TTFONT *font, PGLYPH_CACHE glyphCache) {
+	ZeroMemory(renderer, sizeof(SW_RENDERER));
+	renderer->font = font;
+	renderer->format = COMPOSITOR_COVERAGE;
+	InitCompositor(&renderer->compositor);
+
+	if (glyphCache) {
+		renderer->glyphCache = glyphCache;
+	}
+	else {
+		InitGlyphCache(&renderer->ownGlyphCache, DEFAULT_GLYPH_CACHE_SIZE);
+		renderer->glyphCache = &renderer->ownGlyphCache;
+	}
+}
+
+void FreeSwRenderer(PSW_RENDERER renderer) {
+	FreeCompositor(&renderer->compositor);
+	FreeSurface(&renderer->surface);
+	FreeCoverageSurface(&renderer->backBuffer);
+	if (renderer->glyphCache == &renderer->ownGlyphCache) {
+		FreeGlyphCache(&renderer->ownGlyphCache);
+	}
+	renderer->valid = FALSE;
+}
+
+void InvalidateSwRenderer(PSW_RENDERER renderer) {
+	renderer->valid = FALSE;
+}
+
+// Draws a single line of text centered in a layer and clipped to it, like
+// DrawText with DT_CENTER | DT_VCENTER | DT_SINGLELINE.
+static void DrawCenteredText(PSW_RENDERER renderer, UINT layer, int height, PCWSTR text, SIZE_T len,
+	COLORREF color) {
+	const TTFONT *font = renderer->font;
+	float scale = GetFontScale(font, height);
+
+	float textWidth = 0;
+	for (SIZE_T i = 0; i < len; i++) {
+		textWidth += GetGlyphAdvance(font, GetGlyphIndex(font, text[i])) * scale;
+	}
+
+	const RECT *rect = &renderer->compositor.layers[layer].rect;
+	float x = (rect->right - rect->left - textWidth) / 2;
+	int baseline = (rect->bottom - rect->top - height) / 2 + (int)lroundf(font->ascent * scale);
+
+	for (SIZE_T i = 0; i < len; i++) {
+		UINT glyph = GetGlyphIndex(font, text[i]);
+
+		// Split the pen position into whole pixels and a subpixel bucket
+		float pixel = floorf(x);
+		int px = (int)pixel;
+		int subpixel = (int)lroundf((x - pixel) * GLYPH_SUBPIXEL_BUCKETS);
+		if (subpixel == GLYPH_SUBPIXEL_BUCKETS) {
+			px++;
+			subpixel = 0;
+		}
+
+		const GLYPH_MASK *mask = GetCachedGlyph(renderer->glyphCache, font, glyph, height, subpixel);
+		if (mask->coverage) {
+			DrawLayerMask(&renderer->compositor, layer, px + mask->left, baseline + mask->top, mask->coverage,
+				mask->width, mask->height, mask->width, color);
+		}
+		x += GetGlyphAdvance(font, glyph) * scale;
+	}
+}
+
+// Brings the layout up to date. Returns TRUE if anything changed.
+static BOOL UpdateLayout(PSW_RENDERER renderer, PSETTINGS settings, UINT nUnits) {
+	const RECT surfaceRect = { 0, 0, renderer->surface.width, renderer->surface.height };
+	UINT nClocks = GetClockCount(settings);
+	BOOL labels = HasClockLabels(settings);
+
+	RECT rc;
+	UINT driftRange = GetDriftLayoutRect(&surfaceRect, settings->driftRange, &rc);
+	int height = rc.bottom - rc.top;
+	BOOL measure = renderer->measuredHeight != height;
+
+	if (measure) {
+		float scale = GetFontScale(renderer->font, height);
+		UINT zero = GetGlyphIndex(renderer->font, '0');
+		renderer->measuredHeight = height;
+		renderer->measuredWidth = (int)lroundf(2 * GetGlyphAdvance(renderer->font, zero) * scale);
+	}
+
+	BOOL relayout = measure || !EqualRect(&rc, &renderer->grid.rect) || renderer->layoutUnits != nUnits ||
+		renderer->layoutClocks != nClocks || renderer->layoutLabels != labels ||
+		renderer->layoutScale != settings->scale || renderer->layoutSpace != settings->space;
+	if (!relayout) {
+		return FALSE;
+	}
+
+	renderer->driftRange = driftRange;
+	ComputeClockGrid(&renderer->grid, &rc, nClocks, labels, nUnits, settings->scale, settings->space,
+		renderer->measuredHeight, renderer->measuredWidth);
+	renderer->layoutClocks = nClocks;
+	renderer->layoutLabels = labels;
+	renderer->layoutUnits = nUnits;
+	renderer->layoutScale = settings->scale;
+	renderer->layoutSpace = settings->space;
+
+	renderer->digitHeight = renderer->grid.fontHeight;
+	renderer->labelHeight = renderer->grid.labelHeight * 3 / 5;
+
+	return TRUE;
+}
+
+// Checks whether anything other than the digits differs from the surface.
+static BOOL AppearanceChanged(PSW_RENDERER renderer, PSETTINGS settings, DWORD formatFlags) {
+	if (renderer->fgColor != settings->fgColor || renderer->bgColor != settings->bgColor ||
+		renderer->formatFlags != formatFlags) {
+		return TRUE;
+	}
+	for (UINT i = 0; i < settings->nClocks; i++) {
+		if (renderer->labels[i] != settings->clocks[i].label) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+// Creates a layer for every unit and label of the layout.
+static BOOL CreateLayers(PSW_RENDERER renderer, UINT nClocks, UINT nUnits) {
+	PCOMPOSITOR compositor = &renderer->compositor;
+	RemoveAllLayers(compositor);
+
+	for (UINT c = 0; c < nClocks; c++) {
+		POINT offset;
+		GetClockTileOffset(&renderer->grid, c, &offset);
+
+		for (UINT i = 0; i < nUnits; i++) {
+			RECT rect = renderer->grid.digits.units[i];
+			OffsetRect(&rect, offset.x, offset.y);
+			if (!AddLayer(compositor, &rect, &renderer->unitLayers[c][i])) {
+				return FALSE;
+			}
+		}
+
+		if (renderer->layoutLabels) {
+			RECT rect;
+			GetClockLabelRect(&renderer->grid, c, &rect);
+			if (!AddLayer(compositor, &rect, &renderer->labelLayers[c])) {
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+// (Re)creates the surface, and the back buffer for COMPOSITOR_COVERAGE.
+static BOOL CreateTargets(PSW_RENDERER renderer, int width, int height) {
+	RemoveAllLayers(&renderer->compositor);
+	FreeSurface(&renderer->surface);
+	FreeCoverageSurface(&renderer->backBuffer);
+
+	BOOL created = CreateSurface(&renderer->surface, width, height);
+	if (created && renderer->format == COMPOSITOR_COVERAGE) {
+		created = CreateCoverageSurface(&renderer->backBuffer, width, height) &&
+			SetCompositorCoverageTarget(&renderer->compositor, &renderer->surface, &renderer->backBuffer);
+	}
+	else if (created) {
+		created = SetCompositorTarget(&renderer->compositor, &renderer->surface);
+	}
+
+	// Try again with the next frame
+	if (!created) {
+		FreeSurface(&renderer->surface);
+		FreeCoverageSurface(&renderer->backBuffer);
+	}
+	return created;
+}
+
+BOOL RenderClockToSurface(PSW_RENDERER renderer, int width, int height, PSETTINGS settings, const CLOCK_TIME *times) {
+	if (renderer->surface.width != width || renderer->surface.height != height ||
+		renderer->compositor.format != renderer->format) {
+		if (!CreateTargets(renderer, width, height)) {
+			return FALSE;
+		}
+		renderer->valid = FALSE;
+		renderer->layersValid = FALSE;
+	}
+
+	// Number of units to display
+	UINT nUnits = settings->showSeconds ? 3 : 2;
+	UINT nClocks = GetClockCount(settings);
+	DWORD formatFlags = settings->use12HourClock ? CLOCK_FORMAT_12H : 0;
+
+	if (UpdateLayout(renderer, settings, nUnits)) {
+		renderer->valid = FALSE;
+		renderer->layersValid = FALSE;
+	}
+	if (AppearanceChanged(renderer, settings, formatFlags)) {
+		renderer->valid = FALSE;
+	}
+
+	if (!renderer->valid) {
+		// Start over with empty layers and labels
+		PCOMPOSITOR compositor = &renderer->compositor;
+		if (!renderer->layersValid) {
+			if (!CreateLayers(renderer, nClocks, nUnits)) {
+				RemoveAllLayers(compositor);
+				return FALSE;
+			}
+			renderer->layersValid = TRUE;
+		}
+		else {
+			for (UINT i = 0; i < compositor->nLayers; i++) {
+				ClearLayer(compositor, i);
+			}
+		}
+
+		if (renderer->layoutLabels) {
+			for (UINT c = 0; c < nClocks; c++) {
+				if (!settings->clocks[c].label) continue;
+
+				DrawCenteredText(renderer, renderer->labelLayers[c], renderer->labelHeight, settings->clocks[c].label,
+					wcslen(settings->clocks[c].label), settings->fgColor);
+			}
+		}
+
+		SetCompositorForeground(compositor, settings->fgColor);
+		SetCompositorBackground(compositor, settings->bgColor);
+		InvalidateCompositor(compositor, NULL);
+
+		renderer->fgColor = settings->fgColor;
+		renderer->bgColor = settings->bgColor;
+		renderer->formatFlags = formatFlags;
+		for (UINT c = 0; c < settings->nClocks; c++) {
+			renderer->labels[c] = settings->clocks[c].label;
+		}
+		ZeroMemory(renderer->text, sizeof(renderer->text));
+		renderer->valid = TRUE;
+	}
+
+	// Draw the units that changed
+	for (UINT c = 0; c < nClocks; c++) {
+		WCHAR text[CLOCK_FORMAT_MAX_CHARS];
+		FormatClockTime(&times[c], nUnits, formatFlags, text);
+
+		for (UINT i = 0; i < nUnits; i++) {
+			if (text[2 * i] == renderer->text[c][2 * i] && text[2 * i + 1] == renderer->text[c][2 * i + 1]) {
+				continue;
+			}
+
+			ClearLayer(&renderer->compositor, renderer->unitLayers[c][i]);
+			DrawCenteredText(renderer, renderer->unitLayers[c][i], renderer->digitHeight, text + 2 * i, 2,
+				settings->fgColor);
+		}
+
+		CopyMemory(renderer->text[c], text, sizeof(text));
+	}
+
+	ComposeLayers(&renderer->compositor);
+	return TRUE;
+}
+
+BOOL PresentSwRenderer(PSW_RENDERER renderer, PSURFACE target, PSETTINGS settings, LONGLONG timeMs) {
+	if (target->width != renderer->surface.width || target->height != renderer->surface.height) {
+		FreeSurface(target);
+		if (!CreateSurface(target, renderer->surface.width, renderer->surface.height)) {
+			return FALSE;
+		}
+	}
+
+	POINT offset;
+	GetDriftOffset(renderer->driftRange, settings->driftPeriod, timeMs, &offset);
+	CopySurfaceOffset(target, &renderer->surface, offset.x, offset.y, renderer->bgColor);
+	return TRUE;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "platform.h"
+#include "clocklayout.h"
+#include "compositor.h"
+#include "settings.h"
+#include "surface.h"
+#include "glyphcache.h"
+#include "timefmt.h"
+#include "ttfont.h"
+
+// Renders clocks into a surface without any system graphics library. It
+// mirrors the GDI renderer: layout and glyphs are kept between frames and only
+// units whose digits changed are redrawn. The font is set by the caller, the
+// font settings are ignored. Glyphs are positioned with subpixel precision.
+//
+// Each unit and label is a layer of its own, so that only the tiles of the
+// units that changed are composed into the surface. The renderer must not be
+// moved in memory after InitSwRenderer.
+//
+// Everything is drawn in the foreground color, so by default, layers and the
+// back buffer only hold coverage, which takes a quarter of the memory and
+// bandwidth of colors. The composed tiles are expanded into the surface.
+typedef struct {
+	const TTFONT *font;
+	SURFACE surface;
+	COVERAGE_SURFACE backBuffer;
+	COMPOSITOR compositor;
+
+	// COMPOSITOR_COVERAGE unless changed after InitSwRenderer, e.g. to
+	// compare with COMPOSITOR_COLOR. Takes effect with the next frame.
+	COMPOSITOR_FORMAT format;
+
+	// Layers for the current layout, which are kept when only the appearance
+	// changes
+	BOOL layersValid;
+	UINT unitLayers[MAX_CLOCKS][3];
+	UINT labelLayers[MAX_CLOCKS];
+
+	// Either ownGlyphCache or one shared with other renderers
+	PGLYPH_CACHE glyphCache;
+	GLYPH_CACHE ownGlyphCache;
+
+	// Width of "00" at measuredHeight
+	int measuredHeight;
+	int measuredWidth;
+
+	// Cached layout and the inputs it was computed from
+	UINT layoutClocks;
+	BOOL layoutLabels;
+	UINT layoutUnits;
+	UINT layoutScale;
+	UINT layoutSpace;
+	CLOCK_GRID grid;
+
+	// Range of the burn-in drift that the layout leaves room for
+	UINT driftRange;
+
+	// Cell heights of the digits and the labels
+	int digitHeight;
+	int labelHeight;
+
+	// What the surface currently shows
+	BOOL valid;
+	COLORREF fgColor;
+	COLORREF bgColor;
+	DWORD formatFlags;
+	PCWSTR labels[MAX_CLOCKS];
+	WCHAR text[MAX_CLOCKS][CLOCK_FORMAT_MAX_CHARS];
+} SW_RENDERER, *PSW_RENDERER;
+
+// Uses glyphCache if it is not NULL, otherwise a cache of its own with a
+// size of DEFAULT_GLYPH_CACHE_SIZE.
+void InitSwRenderer(PSW_RENDERER renderer, const TTFONT *font, PGLYPH_CACHE glyphCache);
+
+void FreeSwRenderer(PSW_RENDERER renderer);
+
+// Makes the next RenderClockToSurface call redraw everything.
+void InvalidateSwRenderer(PSW_RENDERER renderer);
+
+// Draws the given times, one per clock, into renderer->surface, which is
+// (re)created with the given size if necessary. Afterwards,
+// renderer->compositor.dirtyRect contains the part of the surface that changed.
+BOOL RenderClockToSurface(PSW_RENDERER renderer, int width, int height, PSETTINGS settings, const CLOCK_TIME *times);
+
+// Copies renderer->surface into target, which is (re)created with the same
+// size if necessary, moved by the burn-in drift at timeMs. This is how frames
+// are presented when settings->driftRange is not zero: the clock face is not
+// drawn again when it moves.
+BOOL PresentSwRenderer(PSW_RENDERER renderer, PSURFACE target, PSETTINGS settings, LONGLONG timeMs);
@@ -0,0 +1,212 @@
+#include "timefmt.h"
+
+#define MS_PER_SECOND 1000LL
+#define MS_PER_MINUTE (60 * MS_PER_SECOND)
+#define MS_PER_HOUR   (60 * MS_PER_MINUTE)
+#define MS_PER_DAY    (24 * MS_PER_HOUR)
+
+// How far ahead an offset is assumed to be valid unless a transition is found
+#define OFFSET_LOOKAHEAD MS_PER_DAY
+
+// All DST transitions happen at a whole minute
+#define OFFSET_RESOLUTION MS_PER_MINUTE
+
+#define TWO_DIGITS_ROW(t) \
+	{ t, '0' }, { t, '1' }, { t, '2' }, { t, '3' }, { t, '4' }, \
+	{ t, '5' }, { t, '6' }, { t, '7' }, { t, '8' }, { t, '9' }
+
+// twoDigits[n] holds the decimal digits of n for 0 <= n < 100
+static const WCHAR twoDigits[100][2] = {
+	TWO_DIGITS_ROW('0'), TWO_DIGITS_ROW('1'), TWO_DIGITS_ROW('2'), TWO_DIGITS_ROW('3'), TWO_DIGITS_ROW('4'),
+	TWO_DIGITS_ROW('5'), TWO_DIGITS_ROW('6'), TWO_DIGITS_ROW('7'), TWO_DIGITS_ROW('8'), TWO_DIGITS_ROW('9')
+};
+
+LONGLONG GetUtcTimeMs(void) {
+	return GetPlatformUtcTimeMs();
+}
+
+// Days between 1601-01-01 and 1970-01-01
+#define DAYS_TO_UNIX_EPOCH 134774
+
+LONGLONG MakeUtcTimeMs(int year, UINT month, UINT day, UINT hour, UINT minute, UINT second) {
+	// Count days from 1970-01-01 in a calendar whose years start in March,
+	// which puts leap days at the end of each year
+	LONGLONG y = (LONGLONG)year - (month <= 2);
+	LONGLONG era = (y >= 0 ? y : y - 399) / 400;
+	LONGLONG yoe = y - era * 400;
+	LONGLONG doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	LONGLONG doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	LONGLONG days = era * 146097 + doe - 719468 + DAYS_TO_UNIX_EPOCH;
+
+	return days * MS_PER_DAY + hour * MS_PER_HOUR + minute * MS_PER_MINUTE + second * MS_PER_SECOND;
+}
+
+// Parses "", "+h", "-hh" or "+hh:mm" into milliseconds.
+static BOOL ParseFixedOffset(PCWSTR str, LONGLONG *offset) {
+	*offset = 0;
+	if (!*str) return TRUE;
+
+	LONGLONG sign;
+	if (*str == '+') sign = 1;
+	else if (*str == '-') sign = -1;
+	else return FALSE;
+	str++;
+
+	UINT hours = 0, minutes = 0, nDigits = 0;
+	while (*str >= '0' && *str <= '9' && nDigits < 2) {
+		hours = hours * 10 + (*str++ - '0');
+		nDigits++;
+	}
+	if (nDigits == 0 || hours > 14) return FALSE;
+
+	if (*str == ':') {
+		str++;
+		for (nDigits = 0; nDigits < 2; nDigits++) {
+			if (*str < '0' || *str > '9') return FALSE;
+			minutes = minutes * 10 + (*str++ - '0');
+		}
+		if (minutes >= 60) return FALSE;
+	}
+	if (*str) return FALSE;
+
+	*offset = sign * (hours * MS_PER_HOUR + minutes * MS_PER_MINUTE);
+	return TRUE;
+}
+
+BOOL ResolveClockZone(PCWSTR name, PCLOCK_ZONE zone) {
+	ZeroMemory(zone, sizeof(CLOCK_ZONE));
+	zone->kind = CLOCK_ZONE_LOCAL;
+
+	if (!name || !*name || _wcsicmp(name, L"local") == 0) {
+		return TRUE;
+	}
+
+	if (_wcsnicmp(name, L"UTC", 3) == 0 && ParseFixedOffset(name + 3, &zone->fixedOffset)) {
+		zone->kind = CLOCK_ZONE_FIXED;
+		return TRUE;
+	}
+
+	if (ResolvePlatformZone(name, &zone->named)) {
+		zone->kind = CLOCK_ZONE_NAMED;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+void InitLocalTimeCache(PLOCAL_TIME_CACHE cache, const CLOCK_ZONE *zone) {
+	ZeroMemory(cache, sizeof(LOCAL_TIME_CACHE));
+	cache->zone = *zone;
+}
+
+// The expensive conversion that the cache avoids: time in the zone minus UTC at utc.
+static LONGLONG LookUpZoneOffset(const CLOCK_ZONE *zone, LONGLONG utc) {
+	if (zone->kind == CLOCK_ZONE_FIXED) {
+		return zone->fixedOffset;
+	}
+
+	LONGLONG offset;
+	if (!GetPlatformZoneOffset(zone->kind == CLOCK_ZONE_NAMED ? &zone->named : NULL, utc, &offset)) {
+		return 0;
+	}
+	return offset;
+}
+
+static void RefreshLocalTimeCache(PLOCAL_TIME_CACHE cache, LONGLONG utc) {
+	const CLOCK_ZONE *zone = &cache->zone;
+
+	// Fixed offsets never change
+	if (zone->kind == CLOCK_ZONE_FIXED) {
+		cache->offset = zone->fixedOffset;
+		cache->validFrom = MINLONGLONG;
+		cache->validUntil = MAXLONGLONG;
+		return;
+	}
+
+	// Start at a whole minute so that the transition search below stays aligned
+	LONGLONG from = utc - utc % OFFSET_RESOLUTION;
+	LONGLONG offset = LookUpZoneOffset(zone, from);
+
+	// If the offset still holds at the end of the lookahead window, assume
+	// that there is no transition in between. Otherwise, binary search for
+	// the first minute at which the new offset applies.
+	LONGLONG lo = from, hi = from + OFFSET_LOOKAHEAD;
+	if (LookUpZoneOffset(zone, hi) != offset) {
+		while (hi - lo > OFFSET_RESOLUTION) {
+			LONGLONG mid = lo + (hi - lo) / 2;
+			mid -= mid % OFFSET_RESOLUTION;
+			if (LookUpZoneOffset(zone, mid) == offset) {
+				lo = mid;
+			}
+			else {
+				hi = mid;
+			}
+		}
+	}
+
+	cache->offset = offset;
+	cache->validFrom = from;
+	cache->validUntil = hi;
+}
+
+void InvalidateLocalTimeCache(PLOCAL_TIME_CACHE cache) {
+	cache->offset = 0;
+	cache->validFrom = 0;
+	cache->validUntil = 0;
+}
+
+LONGLONG UtcToCachedLocalTimeMs(PLOCAL_TIME_CACHE cache, LONGLONG utc) {
+	if (utc < cache->validFrom || utc >= cache->validUntil) {
+		RefreshLocalTimeCache(cache, utc);
+	}
+	return utc + cache->offset;
+}
+
+void SplitClockTime(LONGLONG t, PCLOCK_TIME time) {
+	LONG ms = (LONG)(t % MS_PER_DAY);
+	if (ms < 0) ms += (LONG)MS_PER_DAY;
+
+	time->hour = (WORD)(ms / MS_PER_HOUR);
+	ms -= time->hour * (LONG)MS_PER_HOUR;
+	time->minute = (WORD)(ms / MS_PER_MINUTE);
+	ms -= time->minute * (LONG)MS_PER_MINUTE;
+	time->second = (WORD)(ms / MS_PER_SECOND);
+	time->milliseconds = (WORD)(ms - time->second * (LONG)MS_PER_SECOND);
+}
+
+void GetCachedLocalTime(PLOCAL_TIME_CACHE cache, PCLOCK_TIME time) {
+	SplitClockTime(UtcToCachedLocalTimeMs(cache, GetUtcTimeMs()), time);
+}
+
+void GetCachedLocalTimes(PLOCAL_TIME_CACHE caches, UINT n, PCLOCK_TIME times) {
+	GetCachedLocalTimesAt(caches, n, GetUtcTimeMs(), times);
+}
+
+void GetCachedLocalTimesAt(PLOCAL_TIME_CACHE caches, UINT n, LONGLONG utc, PCLOCK_TIME times) {
+	for (UINT i = 0; i < n; i++) {
+		SplitClockTime(UtcToCachedLocalTimeMs(&caches[i], utc), &times[i]);
+	}
+}
+
+UINT FormatClockTime(const CLOCK_TIME *time, UINT nUnits, DWORD flags, PWSTR out) {
+	WORD hour = time->hour;
+	if (flags & CLOCK_FORMAT_12H) {
+		hour %= 12;
+		if (hour == 0) hour = 12;
+	}
+
+	WORD fields[3] = { hour, time->minute, time->second };
+	if (nUnits > 3) nUnits = 3;
+
+	UINT n = 0;
+	for (UINT i = 0; i < nUnits; i++) {
+		if (i != 0 && (flags & CLOCK_FORMAT_SEPARATORS)) {
+			out[n++] = ':';
+		}
+		out[n++] = twoDigits[fields[i]][0];
+		out[n++] = twoDigits[fields[i]][1];
+	}
+	out[n] = '\0';
+
+	return n;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "platform.h"
+
+// Time of day as displayed by the clock
+typedef struct {
+	WORD hour;
+	WORD minute;
+	WORD second;
+	WORD milliseconds;
+} CLOCK_TIME, *PCLOCK_TIME;
+
+typedef enum {
+	CLOCK_ZONE_LOCAL,   // the time zone of the system
+	CLOCK_ZONE_FIXED,   // UTC or a fixed offset from it, e.g. "UTC+05:30"
+	CLOCK_ZONE_NAMED    // a time zone known to the system, see ResolvePlatformZone
+} CLOCK_ZONE_KIND;
+
+typedef struct {
+	CLOCK_ZONE_KIND kind;
+	LONGLONG fixedOffset;
+	PLATFORM_ZONE named;
+} CLOCK_ZONE, *PCLOCK_ZONE;
+
+// Caches the offset between UTC and the time in a zone so that each tick only
+// needs to read the system time and add the offset. The offset is valid for
+// the UTC interval [validFrom, validUntil), which ends at the next DST
+// transition or after a day at the latest. All times are milliseconds since
+// 1601-01-01. A zeroed cache refers to the local time zone.
+typedef struct {
+	CLOCK_ZONE zone;
+	LONGLONG offset;
+	LONGLONG validFrom;
+	LONGLONG validUntil;
+} LOCAL_TIME_CACHE, *PLOCAL_TIME_CACHE;
+
+// Use a 12-hour clock instead of a 24-hour clock
+#define CLOCK_FORMAT_12H        0x0001
+// Separate units with colons
+#define CLOCK_FORMAT_SEPARATORS 0x0002
+
+// Maximum number of characters written by FormatClockTime, including the terminator
+#define CLOCK_FORMAT_MAX_CHARS  9
+
+// Resolves a zone name: NULL, "" or "local" for the system time zone, "UTC"
+// optionally followed by an offset such as "+9" or "-03:30", or the name of a
+// time zone known to the system. Returns FALSE if the name is not recognized,
+// in which case the zone refers to the system time zone.
+BOOL ResolveClockZone(PCWSTR name, PCLOCK_ZONE zone);
+
+// Prepares a cache for the given zone.
+void InitLocalTimeCache(PLOCAL_TIME_CACHE cache, const CLOCK_ZONE *zone);
+
+// Forces the next GetCachedLocalTime call to look up the offset again, e.g.
+// in response to WM_TIMECHANGE.
+void InvalidateLocalTimeCache(PLOCAL_TIME_CACHE cache);
+
+// Returns the current UTC time in milliseconds since 1601-01-01.
+LONGLONG GetUtcTimeMs(void);
+
+// Returns the given UTC date and time in milliseconds since 1601-01-01.
+LONGLONG MakeUtcTimeMs(int year, UINT month, UINT day, UINT hour, UINT minute, UINT second);
+
+// Converts the given UTC time to local time, refreshing the cache if needed.
+LONGLONG UtcToCachedLocalTimeMs(PLOCAL_TIME_CACHE cache, LONGLONG utc);
+
+// Breaks a time in milliseconds since 1601-01-01 down into the time of day.
+void SplitClockTime(LONGLONG t, PCLOCK_TIME time);
+
+// Retrieves the current local time of day.
+void GetCachedLocalTime(PLOCAL_TIME_CACHE cache, PCLOCK_TIME time);
+
+// Retrieves the current time of day for several zones from a single reading
+// of the system time.
+void GetCachedLocalTimes(PLOCAL_TIME_CACHE caches, UINT n, PCLOCK_TIME times);
+
+// Same for a given UTC time, e.g. from a TIME_SOURCE.
+void GetCachedLocalTimesAt(PLOCAL_TIME_CACHE caches, UINT n, LONGLONG utc, PCLOCK_TIME times);
+
+// Writes hours, minutes and (if nUnits is 3) seconds as two digits each, e.g.
+// "235959" or "23:59:59" with CLOCK_FORMAT_SEPARATORS. Returns the number of
+// characters written, excluding the terminator.
+UINT FormatClockTime(const CLOCK_TIME *time, UINT nUnits, DWORD flags, PWSTR out);
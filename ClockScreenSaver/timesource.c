@@ -0,0 +1,51 @@
+#include "timesource.h"
+#include "timefmt.h"
+
+static LONGLONG GetSystemMonotonicUs(PVOID context) {
+	return GetPlatformMonotonicTimeUs();
+}
+
+static LONGLONG GetSystemUtcMs(PVOID context) {
+	return GetUtcTimeMs();
+}
+
+void InitSystemTimeSource(PTIME_SOURCE source) {
+	source->getMonotonicUs = GetSystemMonotonicUs;
+	source->getUtcMs = GetSystemUtcMs;
+	source->context = NULL;
+}
+
+static LONGLONG GetFakeMonotonicUs(PVOID context) {
+	return ((PFAKE_CLOCK)context)->monotonicUs;
+}
+
+static LONGLONG GetFakeUtcMs(PVOID context) {
+	// Round towards the past like the system clock
+	LONGLONG us = ((PFAKE_CLOCK)context)->utcUs;
+	return (us >= 0 ? us : us - 999) / 1000;
+}
+
+void InitFakeTimeSource(PTIME_SOURCE source, PFAKE_CLOCK clock, LONGLONG utcMs) {
+	clock->monotonicUs = 0;
+	clock->utcUs = utcMs * 1000;
+	source->getMonotonicUs = GetFakeMonotonicUs;
+	source->getUtcMs = GetFakeUtcMs;
+	source->context = clock;
+}
+
+void AdvanceFakeClock(PFAKE_CLOCK clock, LONGLONG us) {
+	clock->monotonicUs += us;
+	clock->utcUs += us;
+}
+
+void StepFakeClock(PFAKE_CLOCK clock, LONGLONG ms) {
+	clock->utcUs += ms * 1000;
+}
+
+LONGLONG GetSourceMonotonicUs(const TIME_SOURCE *source) {
+	return source->getMonotonicUs(source->context);
+}
+
+LONGLONG GetSourceUtcMs(const TIME_SOURCE *source) {
+	return source->getUtcMs(source->context);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "platform.h"
+
+// Where the screen saver gets the time from: a monotonic clock to schedule
+// frames and the wall clock to display. Tests and benchmarks substitute a fake
+// clock that only moves when told to.
+typedef LONGLONG (*TIME_SOURCE_PROC)(PVOID context);
+
+typedef struct {
+	// Microseconds since an arbitrary point, never going backwards
+	TIME_SOURCE_PROC getMonotonicUs;
+	// UTC in milliseconds since 1601-01-01, which may be stepped either way
+	TIME_SOURCE_PROC getUtcMs;
+	PVOID context;
+} TIME_SOURCE, *PTIME_SOURCE;
+
+// A clock that stands still until advanced or stepped. Both clocks are kept
+// in microseconds, so that advancing by less than a millisecond adds up.
+typedef struct {
+	LONGLONG monotonicUs;
+	LONGLONG utcUs;
+} FAKE_CLOCK, *PFAKE_CLOCK;
+
+// Reads the clocks of the system.
+void InitSystemTimeSource(PTIME_SOURCE source);
+
+// Reads clock, starting at the given UTC time in milliseconds.
+void InitFakeTimeSource(PTIME_SOURCE source, PFAKE_CLOCK clock, LONGLONG utcMs);
+
+// Lets time pass: both clocks advance. This is also a suspend on Windows, where
+// the monotonic clock keeps counting while the system sleeps.
+void AdvanceFakeClock(PFAKE_CLOCK clock, LONGLONG us);
+
+// Steps the wall clock only, like NTP or the user setting the time. This is
+// also a suspend on Linux, where the monotonic clock stops while the system
+// sleeps.
+void StepFakeClock(PFAKE_CLOCK clock, LONGLONG ms);
+
+LONGLONG GetSourceMonotonicUs(const TIME_SOURCE *source);
+
+LONGLONG GetSourceUtcMs(const TIME_SOURCE *source);
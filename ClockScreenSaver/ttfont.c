@@ -0,0 +1,493 @@
+#include "ttfont.h"
+#include "memusage.h"
+#include "raster.h"
+
+#include <math.h>
+
+// Fonts from untrusted sources may nest composite glyphs arbitrarily deep
+#define MAX_COMPOSITE_DEPTH 8
+
+// Flattening tolerance in pixels
+#define CURVE_TOLERANCE 0.2f
+
+static UINT ReadU16(const TTFONT *font, SIZE_T offset) {
+	if (offset + 2 > font->size) return 0;
+	return (font->data[offset] << 8) | font->data[offset + 1];
+}
+
+static int ReadI16(const TTFONT *font, SIZE_T offset) {
+	return (int)(short)ReadU16(font, offset);
+}
+
+static DWORD ReadU32(const TTFONT *font, SIZE_T offset) {
+	if (offset + 4 > font->size) return 0;
+	return ((DWORD)font->data[offset] << 24) | ((DWORD)font->data[offset + 1] << 16) |
+		((DWORD)font->data[offset + 2] << 8) | font->data[offset + 3];
+}
+
+static BOOL FindTable(const TTFONT *font, const char *tag, SIZE_T *offset, SIZE_T *length) {
+	UINT numTables = ReadU16(font, 4);
+	for (UINT i = 0; i < numTables; i++) {
+		SIZE_T entry = 12 + 16 * (SIZE_T)i;
+		if (entry + 16 > font->size) break;
+		if (memcmp(font->data + entry, tag, 4) == 0) {
+			*offset = ReadU32(font, entry + 8);
+			*length = ReadU32(font, entry + 12);
+			return *offset + *length <= font->size;
+		}
+	}
+	return FALSE;
+}
+
+// Finds a Unicode format 4 subtable in the cmap table.
+static SIZE_T FindCharacterMap(const TTFONT *font, SIZE_T cmap) {
+	UINT numTables = ReadU16(font, cmap + 2);
+	for (UINT i = 0; i < numTables; i++) {
+		SIZE_T record = cmap + 4 + 8 * (SIZE_T)i;
+		UINT platform = ReadU16(font, record);
+		UINT encoding = ReadU16(font, record + 2);
+		SIZE_T subtable = cmap + ReadU32(font, record + 4);
+
+		BOOL unicode = platform == 0 || (platform == 3 && encoding == 1);
+		if (unicode && ReadU16(font, subtable) == 4) {
+			return subtable;
+		}
+	}
+	return 0;
+}
+
+BOOL LoadTrueTypeFontFromMemory(PTTFONT font, PBYTE data, SIZE_T size) {
+	ZeroMemory(font, sizeof(TTFONT));
+	font->data = data;
+	font->size = size;
+	TrackMemory(MEMORY_FONTS, size);
+
+	SIZE_T head, hhea, maxp, os2, cmap, length;
+	if (!FindTable(font, "head", &head, &length) || !FindTable(font, "hhea", &hhea, &length) ||
+		!FindTable(font, "maxp", &maxp, &length) || !FindTable(font, "cmap", &cmap, &length) ||
+		!FindTable(font, "loca", &font->loca, &length) || !FindTable(font, "hmtx", &font->hmtx, &length) ||
+		!FindTable(font, "glyf", &font->glyf, &font->glyfSize)) {
+		FreeTrueTypeFont(font);
+		SetLastError(ERROR_INVALID_DATA);
+		return FALSE;
+	}
+
+	font->unitsPerEm = ReadU16(font, head + 18);
+	font->longLoca = ReadI16(font, head + 50) != 0;
+	font->numGlyphs = ReadU16(font, maxp + 4);
+	font->numHMetrics = ReadU16(font, hhea + 34);
+	font->cmap = FindCharacterMap(font, cmap);
+
+	// GDI sizes fonts by the Windows ascent and descent, prefer those
+	if (FindTable(font, "OS/2", &os2, &length) && length >= 78) {
+		font->ascent = ReadU16(font, os2 + 74);
+		font->descent = ReadU16(font, os2 + 76);
+	}
+	else {
+		font->ascent = ReadI16(font, hhea + 4);
+		font->descent = -ReadI16(font, hhea + 6);
+	}
+
+	if (!font->unitsPerEm || !font->numHMetrics || !font->cmap || font->ascent + font->descent <= 0) {
+		FreeTrueTypeFont(font);
+		SetLastError(ERROR_INVALID_DATA);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+BOOL LoadTrueTypeFont(PTTFONT font, PCWSTR path) {
+	PBYTE data;
+	SIZE_T size;
+	if (!ReadFileContents(path, 64 * 1024 * 1024, &data, &size)) {
+		return FALSE;
+	}
+	return LoadTrueTypeFontFromMemory(font, data, size);
+}
+
+void FreeTrueTypeFont(PTTFONT font) {
+	if (font->data) {
+		TrackMemory(MEMORY_FONTS, -(LONGLONG)font->size);
+	}
+	free(font->data);
+	ZeroMemory(font, sizeof(TTFONT));
+}
+
+UINT GetGlyphIndex(const TTFONT *font, UINT codePoint) {
+	if (codePoint > 0xFFFF) return 0;
+
+	SIZE_T map = font->cmap;
+	UINT segCount = ReadU16(font, map + 6) / 2;
+	SIZE_T endCodes = map + 14;
+	SIZE_T startCodes = endCodes + 2 * (SIZE_T)segCount + 2;
+	SIZE_T idDeltas = startCodes + 2 * (SIZE_T)segCount;
+	SIZE_T idRangeOffsets = idDeltas + 2 * (SIZE_T)segCount;
+
+	// Binary search for the first segment whose end is not below codePoint
+	UINT lo = 0, hi = segCount;
+	while (lo < hi) {
+		UINT mid = (lo + hi) / 2;
+		if (ReadU16(font, endCodes + 2 * (SIZE_T)mid) < codePoint) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	if (lo == segCount) return 0;
+
+	UINT start = ReadU16(font, startCodes + 2 * (SIZE_T)lo);
+	if (codePoint < start) return 0;
+
+	UINT delta = ReadU16(font, idDeltas + 2 * (SIZE_T)lo);
+	SIZE_T rangeOffsetPos = idRangeOffsets + 2 * (SIZE_T)lo;
+	UINT rangeOffset = ReadU16(font, rangeOffsetPos);
+	if (rangeOffset == 0) {
+		return (codePoint + delta) & 0xFFFF;
+	}
+
+	UINT glyph = ReadU16(font, rangeOffsetPos + rangeOffset + 2 * (SIZE_T)(codePoint - start));
+	return glyph ? (glyph + delta) & 0xFFFF : 0;
+}
+
+UINT GetGlyphAdvance(const TTFONT *font, UINT glyph) {
+	if (glyph >= font->numHMetrics) glyph = font->numHMetrics - 1;
+	return ReadU16(font, font->hmtx + 4 * (SIZE_T)glyph);
+}
+
+float GetFontScale(const TTFONT *font, int cellHeight) {
+	return (float)cellHeight / (font->ascent + font->descent);
+}
+
+// Returns the offset and length of a glyph within the glyf table
+static BOOL GetGlyphData(const TTFONT *font, UINT glyph, SIZE_T *offset, SIZE_T *length) {
+	if (glyph >= font->numGlyphs) return FALSE;
+
+	SIZE_T start, end;
+	if (font->longLoca) {
+		start = ReadU32(font, font->loca + 4 * (SIZE_T)glyph);
+		end = ReadU32(font, font->loca + 4 * (SIZE_T)glyph + 4);
+	}
+	else {
+		start = 2 * (SIZE_T)ReadU16(font, font->loca + 2 * (SIZE_T)glyph);
+		end = 2 * (SIZE_T)ReadU16(font, font->loca + 2 * (SIZE_T)glyph + 2);
+	}
+
+	if (end < start || end > font->glyfSize) return FALSE;
+	*offset = font->glyf + start;
+	*length = end - start;
+	return TRUE;
+}
+
+// Maps font units to raster coordinates
+typedef struct {
+	float xx, xy, yx, yy;
+	float dx, dy;
+} TRANSFORM;
+
+static void ApplyTransform(const TRANSFORM *t, float x, float y, float *outX, float *outY) {
+	*outX = t->xx * x + t->xy * y + t->dx;
+	*outY = t->yx * x + t->yy * y + t->dy;
+}
+
+static void AddCurve(PRASTER raster, float x0, float y0, float cx, float cy, float x1, float y1) {
+	// The deviation of a quadratic curve from its chord determines how many
+	// segments are needed to stay within the tolerance
+	float ddx = x0 - 2 * cx + x1, ddy = y0 - 2 * cy + y1;
+	float dd = sqrtf(ddx * ddx + ddy * ddy);
+	int n = 1 + (int)sqrtf(dd / (4 * CURVE_TOLERANCE));
+	if (n > 64) n = 64;
+
+	float px = x0, py = y0;
+	for (int i = 1; i <= n; i++) {
+		float t = (float)i / n, mt = 1 - t;
+		float x = mt * mt * x0 + 2 * mt * t * cx + t * t * x1;
+		float y = mt * mt * y0 + 2 * mt * t * cy + t * t * y1;
+		AddRasterLine(raster, px, py, x, y);
+		px = x;
+		py = y;
+	}
+}
+
+static BOOL AddSimpleGlyph(const TTFONT *font, SIZE_T offset, SIZE_T length, int numContours,
+	const TRANSFORM *t, PRASTER raster) {
+	SIZE_T end = offset + length;
+	SIZE_T pos = offset + 10;
+
+	UINT numPoints = numContours ? ReadU16(font, pos + 2 * (SIZE_T)(numContours - 1)) + 1 : 0;
+	SIZE_T endPts = pos;
+	pos += 2 * (SIZE_T)numContours;
+	pos += 2 + ReadU16(font, pos);
+	if (pos > end) return FALSE;
+
+	// Decode flags and coordinates
+	PBYTE flags = malloc(numPoints ? numPoints : 1);
+	float *xs = malloc((numPoints ? numPoints : 1) * sizeof(float));
+	float *ys = malloc((numPoints ? numPoints : 1) * sizeof(float));
+	if (!flags || !xs || !ys) {
+		free(flags);
+		free(xs);
+		free(ys);
+		return FALSE;
+	}
+
+	for (UINT i = 0; i < numPoints && pos < end;) {
+		BYTE f = font->data[pos++];
+		UINT repeat = (f & 8) && pos < end ? font->data[pos++] : 0;
+		for (UINT r = 0; r <= repeat && i < numPoints; r++) {
+			flags[i++] = f;
+		}
+	}
+
+	int v = 0;
+	for (UINT i = 0; i < numPoints; i++) {
+		if (flags[i] & 2) {
+			int d = pos < end ? font->data[pos++] : 0;
+			v += (flags[i] & 16) ? d : -d;
+		}
+		else if (!(flags[i] & 16)) {
+			v += ReadI16(font, pos);
+			pos += 2;
+		}
+		xs[i] = (float)v;
+	}
+
+	v = 0;
+	for (UINT i = 0; i < numPoints; i++) {
+		if (flags[i] & 4) {
+			int d = pos < end ? font->data[pos++] : 0;
+			v += (flags[i] & 32) ? d : -d;
+		}
+		else if (!(flags[i] & 32)) {
+			v += ReadI16(font, pos);
+			pos += 2;
+		}
+		ys[i] = (float)v;
+	}
+
+	for (UINT i = 0; i < numPoints; i++) {
+		ApplyTransform(t, xs[i], ys[i], &xs[i], &ys[i]);
+	}
+
+	// Walk the contours, inserting implied on-curve points between
+	// consecutive off-curve points
+	UINT first = 0;
+	for (int c = 0; c < numContours; c++) {
+		UINT last = ReadU16(font, endPts + 2 * (SIZE_T)c);
+		if (last >= numPoints || last < first) break;
+		UINT n = last - first + 1;
+
+		// Find a starting point that is on the curve, or use the midpoint
+		// between the first two points if there is none
+		float sx, sy;
+		UINT start;
+		if (flags[first] & 1) {
+			sx = xs[first];
+			sy = ys[first];
+			start = 1;
+		}
+		else if (flags[last] & 1) {
+			sx = xs[last];
+			sy = ys[last];
+			start = 0;
+		}
+		else {
+			sx = (xs[first] + xs[last]) / 2;
+			sy = (ys[first] + ys[last]) / 2;
+			start = 0;
+		}
+
+		float px = sx, py = sy;
+		BOOL haveControl = FALSE;
+		float cx = 0, cy = 0;
+		for (UINT k = start; k <= n; k++) {
+			// Wrap around to close the contour at the starting point
+			UINT i = first + (k % n);
+			BOOL closing = k == n;
+			float x = closing ? sx : xs[i];
+			float y = closing ? sy : ys[i];
+			BOOL onCurve = closing || (flags[i] & 1);
+
+			if (onCurve) {
+				if (haveControl) {
+					AddCurve(raster, px, py, cx, cy, x, y);
+				}
+				else {
+					AddRasterLine(raster, px, py, x, y);
+				}
+				px = x;
+				py = y;
+				haveControl = FALSE;
+			}
+			else if (haveControl) {
+				float mx = (cx + x) / 2, my = (cy + y) / 2;
+				AddCurve(raster, px, py, cx, cy, mx, my);
+				px = mx;
+				py = my;
+				cx = x;
+				cy = y;
+			}
+			else {
+				cx = x;
+				cy = y;
+				haveControl = TRUE;
+			}
+		}
+
+		first = last + 1;
+	}
+
+	free(flags);
+	free(xs);
+	free(ys);
+	return TRUE;
+}
+
+static BOOL AddGlyph(const TTFONT *font, UINT glyph, const TRANSFORM *t, PRASTER raster, UINT depth);
+
+static float ReadF2Dot14(const TTFONT *font, SIZE_T offset) {
+	return ReadI16(font, offset) / 16384.0f;
+}
+
+static BOOL AddCompositeGlyph(const TTFONT *font, SIZE_T offset, SIZE_T length, const TRANSFORM *t,
+	PRASTER raster, UINT depth) {
+	SIZE_T end = offset + length;
+	SIZE_T pos = offset + 10;
+
+	UINT flags;
+	do {
+		if (pos + 4 > end) return FALSE;
+		flags = ReadU16(font, pos);
+		UINT component = ReadU16(font, pos + 2);
+		pos += 4;
+
+		int dx, dy;
+		if (flags & 1) {
+			dx = ReadI16(font, pos);
+			dy = ReadI16(font, pos + 2);
+			pos += 4;
+		}
+		else {
+			dx = (signed char)font->data[pos];
+			dy = (signed char)font->data[pos + 1];
+			pos += 2;
+		}
+
+		// Only offsets are supported as positioning, not point matching
+		if (!(flags & 2)) {
+			dx = dy = 0;
+		}
+
+		float a = 1, b = 0, c = 0, d = 1;
+		if (flags & 8) {
+			a = d = ReadF2Dot14(font, pos);
+			pos += 2;
+		}
+		else if (flags & 0x40) {
+			a = ReadF2Dot14(font, pos);
+			d = ReadF2Dot14(font, pos + 2);
+			pos += 4;
+		}
+		else if (flags & 0x80) {
+			a = ReadF2Dot14(font, pos);
+			b = ReadF2Dot14(font, pos + 2);
+			c = ReadF2Dot14(font, pos + 4);
+			d = ReadF2Dot14(font, pos + 6);
+			pos += 8;
+		}
+
+		// Combine the component transform with ours
+		TRANSFORM ct = {
+			.xx = t->xx * a + t->xy * b,
+			.xy = t->xx * c + t->xy * d,
+			.yx = t->yx * a + t->yy * b,
+			.yy = t->yx * c + t->yy * d
+		};
+		ApplyTransform(t, (float)dx, (float)dy, &ct.dx, &ct.dy);
+
+		if (!AddGlyph(font, component, &ct, raster, depth + 1)) {
+			return FALSE;
+		}
+	} while (flags & 0x20);
+
+	return TRUE;
+}
+
+static BOOL AddGlyph(const TTFONT *font, UINT glyph, const TRANSFORM *t, PRASTER raster, UINT depth) {
+	if (depth > MAX_COMPOSITE_DEPTH) return FALSE;
+
+	SIZE_T offset, length;
+	if (!GetGlyphData(font, glyph, &offset, &length)) return FALSE;
+
+	// Empty glyphs such as the space have no outline
+	if (length < 10) return TRUE;
+
+	int numContours = ReadI16(font, offset);
+	if (numContours >= 0) {
+		return AddSimpleGlyph(font, offset, length, numContours, t, raster);
+	}
+	return AddCompositeGlyph(font, offset, length, t, raster, depth);
+}
+
+BOOL MeasureGlyph(const TTFONT *font, UINT glyph, float scale, float subpixelX, PGLYPH_MASK mask) {
+	ZeroMemory(mask, sizeof(GLYPH_MASK));
+
+	SIZE_T offset, length;
+	if (!GetGlyphData(font, glyph, &offset, &length)) return FALSE;
+	if (length < 10) return TRUE;
+
+	// The bounding box in the glyph header also covers composite glyphs
+	float xMin = ReadI16(font, offset + 2) * scale + subpixelX;
+	float yMin = ReadI16(font, offset + 4) * scale;
+	float xMax = ReadI16(font, offset + 6) * scale + subpixelX;
+	float yMax = ReadI16(font, offset + 8) * scale;
+
+	// Leave a pixel of room on every side for rounding and anti-aliasing
+	mask->left = (int)floorf(xMin) - 1;
+	mask->top = -(int)ceilf(yMax) - 1;
+	mask->width = (int)ceilf(xMax) + 1 - mask->left + 1;
+	mask->height = -(int)floorf(yMin) + 1 - mask->top + 1;
+	return TRUE;
+}
+
+BOOL RasterizeGlyphInto(const TTFONT *font, UINT glyph, float scale, float subpixelX, PGLYPH_MASK mask) {
+	RASTER raster;
+	if (!InitRaster(&raster, mask->width, mask->height)) return FALSE;
+
+	// Glyph coordinates point up, raster coordinates point down
+	TRANSFORM t = {
+		.xx = scale, .xy = 0,
+		.yx = 0, .yy = -scale,
+		.dx = subpixelX - mask->left,
+		.dy = (float)-mask->top
+	};
+
+	if (!AddGlyph(font, glyph, &t, &raster, 0)) {
+		FreeRaster(&raster);
+		return FALSE;
+	}
+
+	ResolveRaster(&raster, mask->coverage, mask->width);
+	FreeRaster(&raster);
+	return TRUE;
+}
+
+BOOL RasterizeGlyph(const TTFONT *font, UINT glyph, float scale, float subpixelX, PGLYPH_MASK mask) {
+	if (!MeasureGlyph(font, glyph, scale, subpixelX, mask)) return FALSE;
+	if (mask->width == 0) return TRUE;
+
+	mask->coverage = malloc((SIZE_T)mask->width * mask->height);
+	if (!mask->coverage) return FALSE;
+
+	if (!RasterizeGlyphInto(font, glyph, scale, subpixelX, mask)) {
+		FreeGlyphMask(mask);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void FreeGlyphMask(PGLYPH_MASK mask) {
+	free(mask->coverage);
+	ZeroMemory(mask, sizeof(GLYPH_MASK));
+}
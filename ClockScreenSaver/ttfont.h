@@ -0,0 +1,67 @@
+#pragma once
+
+#include "platform.h"
+
+// Minimal reader for TrueType (glyf) fonts, sufficient to render the clock
+// without a system font engine.
+typedef struct {
+	PBYTE data;
+	SIZE_T size;
+
+	UINT unitsPerEm;
+	UINT numGlyphs;
+	UINT numHMetrics;
+	BOOL longLoca;
+	// Cell height as used by GDI, in font units
+	int ascent;
+	int descent;
+
+	// Offsets of the tables that are needed to render glyphs
+	SIZE_T cmap;
+	SIZE_T glyf;
+	SIZE_T glyfSize;
+	SIZE_T loca;
+	SIZE_T hmtx;
+} TTFONT, *PTTFONT;
+
+// Coverage of a rasterized glyph. (left, top) is the position of the first
+// pixel relative to the pen position on the baseline.
+typedef struct {
+	int width;
+	int height;
+	int left;
+	int top;
+	PBYTE coverage;
+} GLYPH_MASK, *PGLYPH_MASK;
+
+// Loads a font from a file.
+BOOL LoadTrueTypeFont(PTTFONT font, PCWSTR path);
+
+// Takes ownership of data, which must have been allocated with malloc().
+BOOL LoadTrueTypeFontFromMemory(PTTFONT font, PBYTE data, SIZE_T size);
+
+void FreeTrueTypeFont(PTTFONT font);
+
+// Returns the glyph for a Unicode code point, or 0 (.notdef) if there is none.
+UINT GetGlyphIndex(const TTFONT *font, UINT codePoint);
+
+// Returns the advance width of a glyph in font units.
+UINT GetGlyphAdvance(const TTFONT *font, UINT glyph);
+
+// Returns the factor that converts font units to pixels for a font of the
+// given cell height, which matches the meaning of a positive LOGFONT lfHeight.
+float GetFontScale(const TTFONT *font, int cellHeight);
+
+// Computes the position and size of the mask of a glyph without rasterizing
+// it. Empty glyphs have a width of zero.
+BOOL MeasureGlyph(const TTFONT *font, UINT glyph, float scale, float subpixelX, PGLYPH_MASK mask);
+
+// Rasterizes a glyph into a mask prepared by MeasureGlyph, whose coverage
+// points to width * height bytes provided by the caller.
+BOOL RasterizeGlyphInto(const TTFONT *font, UINT glyph, float scale, float subpixelX, PGLYPH_MASK mask);
+
+// Rasterizes a glyph at the given scale, shifted right by subpixelX (in
+// pixels, usually within [0, 1)). The mask must be freed with FreeGlyphMask.
+BOOL RasterizeGlyph(const TTFONT *font, UINT glyph, float scale, float subpixelX, PGLYPH_MASK mask);
+
+void FreeGlyphMask(PGLYPH_MASK mask);
@@ -0,0 +1,150 @@
+#include "utf.h"
+
+// Appends the code point cp to out as one or two WCHARs
+static UINT PutCodePoint(PWSTR out, UINT cp) {
+	if (sizeof(WCHAR) == 2 && cp >= 0x10000) {
+		cp -= 0x10000;
+		out[0] = (WCHAR)(0xD800 + (cp >> 10));
+		out[1] = (WCHAR)(0xDC00 + (cp & 0x3FF));
+		return 2;
+	}
+	out[0] = (WCHAR)cp;
+	return 1;
+}
+
+// Decodes one UTF-8 sequence starting at data[*i]. Invalid sequences decode
+// to U+FFFD, just like MultiByteToWideChar does.
+static UINT DecodeUtf8(const BYTE *data, SIZE_T size, SIZE_T *i) {
+	BYTE b = data[(*i)++];
+	if (b < 0x80) return b;
+
+	UINT cp, n, min;
+	if ((b & 0xE0) == 0xC0) { cp = b & 0x1F; n = 1; min = 0x80; }
+	else if ((b & 0xF0) == 0xE0) { cp = b & 0x0F; n = 2; min = 0x800; }
+	else if ((b & 0xF8) == 0xF0) { cp = b & 0x07; n = 3; min = 0x10000; }
+	else return 0xFFFD;
+
+	for (; n > 0; n--) {
+		if (*i >= size || (data[*i] & 0xC0) != 0x80) return 0xFFFD;
+		cp = (cp << 6) | (data[(*i)++] & 0x3F);
+	}
+
+	if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return 0xFFFD;
+	return cp;
+}
+
+// Decodes one UTF-16 code point starting at data[*i], which must be followed
+// by at least one more byte.
+static UINT DecodeUtf16(const BYTE *data, SIZE_T size, SIZE_T *i, BOOL bigEndian) {
+	#define UNIT(j) (bigEndian ? (data[j] << 8) | data[(j) + 1] : data[j] | (data[(j) + 1] << 8))
+
+	UINT unit = UNIT(*i);
+	*i += 2;
+	if (unit < 0xD800 || unit > 0xDFFF) return unit;
+	if (unit > 0xDBFF || *i + 1 >= size) return 0xFFFD;
+
+	UINT low = UNIT(*i);
+	if (low < 0xDC00 || low > 0xDFFF) return 0xFFFD;
+	*i += 2;
+
+	return 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+
+	#undef UNIT
+}
+
+PWSTR DecodeText(const BYTE *data, SIZE_T size, PSIZE_T charsOut) {
+	BOOL utf16 = FALSE, bigEndian = FALSE;
+	SIZE_T i = 0;
+
+	if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+		i = 3;
+	}
+	else if (size >= 2 && data[0] == 0xFF && data[1] == 0xFE) {
+		utf16 = TRUE;
+		i = 2;
+	}
+	else if (size >= 2 && data[0] == 0xFE && data[1] == 0xFF) {
+		utf16 = bigEndian = TRUE;
+		i = 2;
+	}
+
+	// Neither encoding needs more than one WCHAR per byte
+	PWSTR text = calloc(size + 1, sizeof(WCHAR));
+	if (!text) return NULL;
+
+	SIZE_T n = 0;
+	while (i < size) {
+		UINT cp;
+		if (!utf16) {
+			cp = DecodeUtf8(data, size, &i);
+		}
+		else if (i + 1 < size) {
+			cp = DecodeUtf16(data, size, &i, bigEndian);
+		}
+		else {
+			// Odd trailing byte
+			cp = 0xFFFD;
+			i++;
+		}
+
+		n += PutCodePoint(text + n, cp ? cp : 0xFFFD);
+	}
+
+	text[n] = '\0';
+	*charsOut = n;
+	return text;
+}
+
+PBYTE EncodeUtf8(PCWSTR text, SIZE_T len, PSIZE_T bytesOut) {
+	PBYTE out = malloc(len * 4 + 1);
+	if (!out) return NULL;
+
+	SIZE_T n = 0;
+	for (SIZE_T i = 0; i < len; i++) {
+		UINT cp = text[i];
+		if (sizeof(WCHAR) == 2 && cp >= 0xD800 && cp <= 0xDBFF && i + 1 < len &&
+			text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF) {
+			cp = 0x10000 + ((cp - 0xD800) << 10) + (text[++i] - 0xDC00);
+		}
+		else if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF) {
+			cp = 0xFFFD;
+		}
+
+		if (cp < 0x80) {
+			out[n++] = (BYTE)cp;
+		}
+		else if (cp < 0x800) {
+			out[n++] = (BYTE)(0xC0 | (cp >> 6));
+			out[n++] = (BYTE)(0x80 | (cp & 0x3F));
+		}
+		else if (cp < 0x10000) {
+			out[n++] = (BYTE)(0xE0 | (cp >> 12));
+			out[n++] = (BYTE)(0x80 | ((cp >> 6) & 0x3F));
+			out[n++] = (BYTE)(0x80 | (cp & 0x3F));
+		}
+		else {
+			out[n++] = (BYTE)(0xF0 | (cp >> 18));
+			out[n++] = (BYTE)(0x80 | ((cp >> 12) & 0x3F));
+			out[n++] = (BYTE)(0x80 | ((cp >> 6) & 0x3F));
+			out[n++] = (BYTE)(0x80 | (cp & 0x3F));
+		}
+	}
+
+	*bytesOut = n;
+	return out;
+}
+
+PSTR WideToUtf8String(PCWSTR str) {
+	SIZE_T size;
+	PBYTE data = EncodeUtf8(str, wcslen(str), &size);
+	if (!data) return NULL;
+
+	// EncodeUtf8 always leaves room for a terminator
+	data[size] = '\0';
+	return (PSTR)data;
+}
+
+PWSTR Utf8ToWideString(PCSTR str) {
+	SIZE_T len;
+	return DecodeText((const BYTE *)str, strlen(str), &len);
+}
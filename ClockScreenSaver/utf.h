@@ -0,0 +1,17 @@
+#pragma once
+
+#include "platform.h"
+
+// Decodes UTF-8 or, if there is a byte order mark, UTF-16 text. The result is
+// null-terminated and also does not contain any null characters, which would
+// otherwise end the text early. Invalid sequences decode to U+FFFD.
+PWSTR DecodeText(const BYTE *data, SIZE_T size, PSIZE_T charsOut);
+
+// Encodes WCHAR text (UTF-16 on Windows, UTF-32 elsewhere) as UTF-8. The
+// result is not null-terminated, but has room for a terminator.
+PBYTE EncodeUtf8(PCWSTR text, SIZE_T len, PSIZE_T bytesOut);
+
+// Null-terminated conversions, the results must be freed with free().
+PSTR WideToUtf8String(PCWSTR str);
+
+PWSTR Utf8ToWideString(PCSTR str);
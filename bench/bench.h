@@ -0,0 +1,22 @@
+#pragma once
+
+// Minimal benchmark support: BENCH_RUN repeats a block in growing batches
+// until at least BENCH_MIN_MS have passed and reports the time per iteration.
+
+#include <stdio.h>
+
+#define BENCH_MIN_MS 300
+
+#define BENCH_RUN(name, units, unitName, body) \
+	do { \
+		LONGLONG start_ = GetPlatformMonotonicTimeMs(), elapsed_; \
+		ULONGLONG iterations_ = 0, batch_ = 1; \
+		do { \
+			for (ULONGLONG i_ = 0; i_ < batch_; i_++) { body; } \
+			iterations_ += batch_; \
+			batch_ *= 2; \
+			elapsed_ = GetPlatformMonotonicTimeMs() - start_; \
+		} while (elapsed_ < BENCH_MIN_MS); \
+		double ns_ = elapsed_ * 1e6 / iterations_; \
+		printf("%-40s %12.1f ns/op %12.1f %s/s\n", name, ns_, (double)(units) * 1e9 / ns_, unitName); \
+	} while (0)
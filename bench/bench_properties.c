@@ -0,0 +1,137 @@
+#include "profiles.h"
+#include "properties.h"
+#include "settings.h"
+#include "bench.h"
+
+#ifdef BENCH_WRAP_MALLOC
+// Counts heap allocations made by the library, see bench/CMakeLists.txt
+static ULONGLONG allocations;
+
+void *__real_malloc(SIZE_T size);
+void *__real_calloc(SIZE_T n, SIZE_T size);
+void *__real_realloc(PVOID p, SIZE_T size);
+
+void *__wrap_malloc(SIZE_T size) {
+	allocations++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(SIZE_T n, SIZE_T size) {
+	allocations++;
+	return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(PVOID p, SIZE_T size) {
+	allocations++;
+	return __real_realloc(p, size);
+}
+#endif
+
+// A configuration file as written by the screen saver, with every clock set
+static PSTR MakeTypicalConfig(PSIZE_T size) {
+	static const char header[] =
+		"scale=80\nspace=20\nshowSeconds=yes\nuse12HourClock=no\nuseCustomFont=yes\nfontName=Segoe UI Light\n"
+		"fontWeight=300\nfontItalic=no\nbgColor=000000\nfgColor=FFFFFF\n";
+	PSTR text = malloc(4096);
+	if (!text) abort();
+
+	SIZE_T len = strlen(header);
+	memcpy(text, header, len);
+	for (UINT i = 1; i <= MAX_CLOCKS; i++) {
+		len += snprintf(text + len, 4096 - len, "clock.%u.zone=UTC+%u\r\nclock.%u.label=Clock %u\r\n", i, i, i, i);
+	}
+
+	*size = len;
+	return text;
+}
+
+// Many distinct keys, which stresses the index
+static PSTR MakeLargeConfig(UINT nKeys, PSIZE_T size) {
+	PSTR text = malloc((SIZE_T)nKeys * 32);
+	if (!text) abort();
+
+	SIZE_T len = 0;
+	for (UINT i = 0; i < nKeys; i++) {
+		len += snprintf(text + len, 32, "section%u.key%u=%u\n", i % 97, i, i);
+	}
+
+	*size = len;
+	return text;
+}
+
+// One file for a fleet, with a profile for each monitor of every host
+static PSTR MakeFleetConfig(UINT nHosts, PSIZE_T size) {
+	SIZE_T capacity = (SIZE_T)nHosts * 2 * 160;
+	PSTR text = malloc(capacity);
+	if (!text) abort();
+
+	SIZE_T len = 0;
+	for (UINT i = 0; i < nHosts; i++) {
+		for (UINT m = 1; m <= 2; m++) {
+			len += snprintf(text + len, capacity - len, "profile.h%u-%u.host=HOST-%u\nprofile.h%u-%u.monitor=%u\n"
+				"profile.h%u-%u.scale=%u\nprofile.h%u-%u.clock.1.zone=UTC+%u\n", i, m, i, i, m, m, i, m, 50 + m, i, m,
+				i % 12);
+		}
+	}
+
+	*size = len;
+	return text;
+}
+
+static void BenchParse(const char *name, PCSTR text, SIZE_T size) {
+	BENCH_RUN(name, size / 1e6, "MB", {
+		PROPERTIES props = { 0 };
+		ParseProperties(&props, (const BYTE *)text, size);
+		FreeProperties(&props);
+	});
+
+#ifdef BENCH_WRAP_MALLOC
+	ULONGLONG before = allocations;
+	PROPERTIES props = { 0 };
+	ParseProperties(&props, (const BYTE *)text, size);
+	FreeProperties(&props);
+	printf("%-40s %12.1f allocations/KB\n", "", (allocations - before) * 1024.0 / size);
+#endif
+}
+
+int main(void) {
+	SIZE_T size;
+	PSTR typical = MakeTypicalConfig(&size);
+	BenchParse("parse typical config", typical, size);
+
+	PROPERTIES props = { 0 };
+	ParseProperties(&props, (const BYTE *)typical, size);
+	BENCH_RUN("properties to settings", 1, "op", {
+		SETTINGS settings;
+		PropertiesToSettings(&settings, &props, NULL, 0);
+	});
+	FreeProperties(&props);
+	free(typical);
+
+	PSTR fleet = MakeFleetConfig(5000, &size);
+	ParseProperties(&props, (const BYTE *)fleet, size);
+	BENCH_RUN("index 10000 profiles", 1, "op", {
+		PROFILE_SET set;
+		UINT nRejected;
+		IndexProfiles(&set, &props, NULL, 0, &nRejected);
+		FreeProfiles(&set);
+	});
+
+	PROFILE_SET set;
+	UINT nRejected;
+	IndexProfiles(&set, &props, NULL, 0, &nRejected);
+	PROFILE_TARGET target = { L"host-4321", 2, 1920, 1080 };
+	BENCH_RUN("resolve profile settings", 1, "op", {
+		SETTINGS settings;
+		ResolveProfileSettings(&set, &target, &settings, NULL, 0);
+	});
+	FreeProfiles(&set);
+	FreeProperties(&props);
+	free(fleet);
+
+	PSTR large = MakeLargeConfig(100000, &size);
+	BenchParse("parse 100000 keys", large, size);
+	free(large);
+
+	return 0;
+}
@@ -0,0 +1,117 @@
+#include "swrender.h"
+#include "imagefile.h"
+#include "bench.h"
+
+int main(void) {
+	TTFONT font;
+	if (!LoadTrueTypeFont(&font, BENCH_FONT_PATH)) {
+		fprintf(stderr, "cannot load font\n");
+		return 1;
+	}
+
+	SETTINGS settings;
+	RestoreDefaultSettings(&settings);
+
+	SW_RENDERER renderer;
+	InitSwRenderer(&renderer, &font, NULL);
+	CLOCK_TIME time = { 12, 34, 56, 0 };
+	RenderClockToSurface(&renderer, 1920, 1080, &settings, &time);
+
+	BENCH_RUN("full frame 1920x1080", 1, "frame", {
+		InvalidateSwRenderer(&renderer);
+		RenderClockToSurface(&renderer, 1920, 1080, &settings, &time);
+	});
+
+	// The common case of a tick: only the seconds change
+	BENCH_RUN("seconds tick 1920x1080", 1, "frame", {
+		time.second = (time.second + 1) % 60;
+		RenderClockToSurface(&renderer, 1920, 1080, &settings, &time);
+	});
+
+	// Composing every layer again, as after a change of the background,
+	// including the expansion of coverage into colors
+	BENCH_RUN("compose layers 1920x1080", 1, "frame", {
+		InvalidateCompositor(&renderer.compositor, NULL);
+		ComposeLayers(&renderer.compositor);
+	});
+
+	PDWORD row = renderer.surface.pixels;
+	const BYTE *coverage = renderer.backBuffer.coverage;
+	BENCH_RUN("expand coverage 1920x1080", 1920 * 1080 / 1e6, "Mpixel", {
+		for (int y = 0; y < 1080; y++) {
+			ExpandCoverageRow(row + y * 1920, coverage + y * 1920, 1920, settings.fgColor, settings.bgColor);
+		}
+	});
+
+	// The same with layers of premultiplied colors, for comparison
+	SW_RENDERER color;
+	InitSwRenderer(&color, &font, NULL);
+	color.format = COMPOSITOR_COLOR;
+	RenderClockToSurface(&color, 1920, 1080, &settings, &time);
+
+	BENCH_RUN("full frame 1920x1080, color layers", 1, "frame", {
+		InvalidateSwRenderer(&color);
+		RenderClockToSurface(&color, 1920, 1080, &settings, &time);
+	});
+
+	BENCH_RUN("compose layers 1920x1080, color layers", 1, "frame", {
+		InvalidateCompositor(&color.compositor, NULL);
+		ComposeLayers(&color.compositor);
+	});
+	FreeSwRenderer(&color);
+
+	BENCH_RUN("glyph rasterization", 1, "glyph", {
+		GLYPH_MASK mask;
+		RasterizeGlyph(&font, GetGlyphIndex(&font, '8'), GetFontScale(&font, 400), 0, &mask);
+		FreeGlyphMask(&mask);
+	});
+
+	GLYPH_CACHE cache;
+	InitGlyphCache(&cache, DEFAULT_GLYPH_CACHE_SIZE);
+	UINT eight = GetGlyphIndex(&font, '8');
+	GetCachedGlyph(&cache, &font, eight, 400, 0);
+	BENCH_RUN("cached glyph lookup", 1, "glyph", {
+		GetCachedGlyph(&cache, &font, eight, 400, 0);
+	});
+
+	// Switching between two window sizes, e.g. preview and full screen,
+	// finds the glyphs of both in the cache
+	SW_RENDERER resized;
+	InitSwRenderer(&resized, &font, &cache);
+	UINT frame = 0;
+	BENCH_RUN("alternating sizes", 1, "frame", {
+		int width = frame++ % 2 ? 1920 : 1280;
+		RenderClockToSurface(&resized, width, width * 9 / 16, &settings, &time);
+	});
+	FreeSwRenderer(&resized);
+
+	GLYPH_CACHE_STATS stats;
+	GetGlyphCacheStats(&cache, &stats);
+	printf("%-40s %12.2f %% hits, %u entries, %zu KB in use, %zu KB reserved\n", "glyph cache",
+		stats.hits * 100.0 / (stats.hits + stats.misses), stats.entries, stats.bytesInUse / 1024,
+		stats.bytesReserved / 1024);
+	FreeGlyphCache(&cache);
+
+	// What a preview in Display Settings does before its first frame: load
+	// the bundled font from memory and draw everything with empty caches
+	BENCH_RUN("preview first frame 152x112", 1, "frame", {
+		TTFONT copy;
+		PBYTE data = malloc(font.size);
+		memcpy(data, font.data, font.size);
+		LoadTrueTypeFontFromMemory(&copy, data, font.size);
+		SW_RENDERER preview;
+		InitSwRenderer(&preview, &copy, NULL);
+		RenderClockToSurface(&preview, 152, 112, &settings, &time);
+		FreeSwRenderer(&preview);
+		FreeTrueTypeFont(&copy);
+	});
+
+	SIZE_T size;
+	BENCH_RUN("encode png 1920x1080", 1920 * 1080 * 3 / 1e6, "MB", {
+		free(EncodePng(&renderer.surface, &size));
+	});
+
+	FreeSwRenderer(&renderer);
+	FreeTrueTypeFont(&font);
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include "scheduler.h"
+#include "timefmt.h"
+#include "bench.h"
+
+int main(void) {
+	CLOCK_ZONE zone;
+	LOCAL_TIME_CACHE cache;
+	CLOCK_TIME time;
+	WCHAR text[CLOCK_FORMAT_MAX_CHARS];
+
+	BENCH_RUN("read system time", 1, "op", {
+		volatile LONGLONG t = GetUtcTimeMs();
+		(void)t;
+	});
+
+	ResolveClockZone(L"local", &zone);
+	InitLocalTimeCache(&cache, &zone);
+	BENCH_RUN("local time, cached", 1, "op", {
+		GetCachedLocalTime(&cache, &time);
+	});
+
+	// What every tick cost before the offset was cached
+	BENCH_RUN("local time, uncached", 1, "op", {
+		InvalidateLocalTimeCache(&cache);
+		GetCachedLocalTime(&cache, &time);
+	});
+
+	if (ResolveClockZone(L"Europe/Berlin", &zone)) {
+		InitLocalTimeCache(&cache, &zone);
+		BENCH_RUN("named zone, uncached", 1, "op", {
+			InvalidateLocalTimeCache(&cache);
+			GetCachedLocalTime(&cache, &time);
+		});
+	}
+
+	LOCAL_TIME_CACHE caches[12];
+	CLOCK_TIME times[12];
+	for (UINT i = 0; i < 12; i++) {
+		ZeroMemory(&zone, sizeof(zone));
+		zone.kind = CLOCK_ZONE_FIXED;
+		zone.fixedOffset = i * 3600000LL;
+		InitLocalTimeCache(&caches[i], &zone);
+	}
+	BENCH_RUN("12 clocks, cached", 12, "clock", {
+		GetCachedLocalTimes(caches, 12, times);
+	});
+
+	time.hour = 23;
+	time.minute = 59;
+	time.second = 58;
+	BENCH_RUN("format time", 1, "op", {
+		FormatClockTime(&time, 3, CLOCK_FORMAT_SEPARATORS, text);
+		time.second ^= 1;
+	});
+
+	// A tick of the screen saver on a fake clock, which moves a second each
+	// time, and the same on the system clocks
+	TIME_SOURCE source;
+	FAKE_CLOCK clock;
+	FRAME_SCHEDULER scheduler;
+	FRAME_TICK tick;
+	InitFakeTimeSource(&source, &clock, MakeUtcTimeMs(2024, 3, 10, 12, 0, 0));
+	InitFrameScheduler(&scheduler, &source, 1000, 10);
+	BENCH_RUN("scheduler tick, fake clock", 1, "op", {
+		AdvanceFakeClock(&clock, 1000000);
+		TickFrameScheduler(&scheduler, &tick);
+	});
+
+	InitSystemTimeSource(&source);
+	InitFrameScheduler(&scheduler, &source, 1000, 10);
+	BENCH_RUN("scheduler tick, system clock", 1, "op", {
+		TickFrameScheduler(&scheduler, &tick);
+	});
+
+	return 0;
+}
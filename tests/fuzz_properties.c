@@ -0,0 +1,174 @@
+// Fuzz target for the properties parser and the settings schema. Built with
+// CLOCK_FUZZ, it is a libFuzzer target. Otherwise, main() runs it on a
+// generated corpus of valid, malformed and oversized inputs, which is what
+// CTest runs under the sanitizers of the build.
+
+#include "properties.h"
+#include "settings.h"
+#include "test.h"
+
+int LLVMFuzzerTestOneInput(const BYTE *data, SIZE_T size) {
+	PROPERTIES props = { 0 };
+	if (ParseProperties(&props, data, size)) {
+		// Every parsed property can be found by its name
+		for (UINT i = 0; i < props.count; i++) {
+			CHECK(props.items[i].name[0] != '\0');
+			CHECK(GetProperty(&props, props.items[i].name) == props.items[i].value);
+		}
+
+		SETTINGS settings;
+		PWSTR rejected[4];
+		UINT nRejected = PropertiesToSettings(&settings, &props, rejected, 4);
+		CHECK(nRejected <= props.count);
+		CHECK(settings.nClocks <= MAX_CLOCKS);
+		CHECK(settings.scale <= 100 && settings.space <= 100);
+
+		PROPERTIES out = { 0 };
+		SettingsToProperties(&settings, &out);
+		FreeProperties(&out);
+	}
+	FreeProperties(&props);
+
+	if (testFailures) abort();
+	return 0;
+}
+
+#ifndef CLOCK_FUZZ
+
+// Deterministic generator so that failures are reproducible
+static UINT seed = 12345;
+
+static UINT Random(UINT n) {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 16) % n;
+}
+
+typedef struct {
+	PBYTE data;
+	SIZE_T size;
+	SIZE_T capacity;
+} BUFFER;
+
+static void Append(BUFFER *buf, const void *data, SIZE_T len) {
+	if (buf->size + len > buf->capacity) {
+		buf->capacity = (buf->size + len) * 2;
+		buf->data = realloc(buf->data, buf->capacity);
+		if (!buf->data) abort();
+	}
+	memcpy(buf->data + buf->size, data, len);
+	buf->size += len;
+}
+
+static void AppendString(BUFFER *buf, const char *str) {
+	Append(buf, str, strlen(str));
+}
+
+static const char *const keys[] = {
+	"scale", "space", "showSeconds", "use12HourClock", "useCustomFont", "fontName", "fontWeight",
+	"fontItalic", "bgColor", "fgColor", "clock.1.zone", "clock.12.label", "clock.13.zone", "clock.0.zone",
+	"clock.01.zone", "clock.4294967296.zone", "clock..zone", "unknown", "a-b_c.d"
+};
+
+static const char *const values[] = {
+	"", "0", "100", "101", "4294967295", "4294967296", "yes", "No", "TRUE", "ff00FF", "ff00f", "ff00ff0",
+	"UTC+05:30", "local", " spaced value ", "\xC3\xBC\xE2\x82\xAC\xF0\x9F\x95\x90", "\xFF\xFE\xC0\x80", "=="
+};
+
+static const char *const separators[] = { "=", " = ", "\t=", "= \t" };
+static const char *const lineEnds[] = { "\n", "\r\n", "\r", "\n\n", " \n# comment\n" };
+
+// Builds a file from known keys and values with random formatting
+static void GenerateStructured(BUFFER *buf) {
+	if (Random(4) == 0) AppendString(buf, "\xEF\xBB\xBF");
+
+	UINT lines = Random(40);
+	for (UINT i = 0; i < lines; i++) {
+		AppendString(buf, keys[Random(sizeof(keys) / sizeof(keys[0]))]);
+		AppendString(buf, separators[Random(sizeof(separators) / sizeof(separators[0]))]);
+		AppendString(buf, values[Random(sizeof(values) / sizeof(values[0]))]);
+		AppendString(buf, lineEnds[Random(sizeof(lineEnds) / sizeof(lineEnds[0]))]);
+	}
+}
+
+// Re-encodes a buffer as UTF-16 with a byte order mark of either endianness
+static void ConvertToUtf16(BUFFER *buf) {
+	BOOL bigEndian = Random(2);
+	BUFFER out = { 0 };
+	AppendString(&out, bigEndian ? "\xFE\xFF" : "\xFF\xFE");
+	for (SIZE_T i = 0; i < buf->size; i++) {
+		BYTE unit[2] = { bigEndian ? 0 : buf->data[i], bigEndian ? buf->data[i] : 0 };
+		Append(&out, unit, 2);
+	}
+	free(buf->data);
+	*buf = out;
+}
+
+static void Mutate(BUFFER *buf) {
+	UINT n = Random(8);
+	for (UINT i = 0; i < n && buf->size; i++) {
+		SIZE_T pos = Random((UINT)buf->size);
+		switch (Random(3)) {
+		case 0:
+			buf->data[pos] = (BYTE)Random(256);
+			break;
+		case 1:
+			buf->data[pos] ^= 1 << Random(8);
+			break;
+		case 2:
+			// Truncate, possibly in the middle of a multibyte sequence
+			buf->size = pos;
+			break;
+		}
+	}
+}
+
+static void RunInput(const BUFFER *buf) {
+	// Copy into an exactly sized allocation so that overreads are caught
+	PBYTE copy = malloc(buf->size ? buf->size : 1);
+	if (!copy) abort();
+	memcpy(copy, buf->data, buf->size);
+	LLVMFuzzerTestOneInput(copy, buf->size);
+	free(copy);
+}
+
+int main(void) {
+	BUFFER buf = { 0 };
+
+	for (UINT i = 0; i < 20000; i++) {
+		buf.size = 0;
+		GenerateStructured(&buf);
+		if (Random(5) == 0) ConvertToUtf16(&buf);
+		if (Random(2) == 0) Mutate(&buf);
+		RunInput(&buf);
+	}
+
+	// Random bytes
+	for (UINT i = 0; i < 2000; i++) {
+		buf.size = 0;
+		UINT len = Random(256);
+		for (UINT j = 0; j < len; j++) {
+			BYTE b = (BYTE)Random(256);
+			Append(&buf, &b, 1);
+		}
+		RunInput(&buf);
+	}
+
+	// A huge value and many distinct keys
+	buf.size = 0;
+	AppendString(&buf, "fontName=");
+	for (UINT i = 0; i < 1 << 20; i++) {
+		AppendString(&buf, "x");
+	}
+	AppendString(&buf, "\n");
+	for (UINT i = 0; i < 50000; i++) {
+		char line[32];
+		snprintf(line, sizeof(line), "key%u=%u\r\n", i, i);
+		AppendString(&buf, line);
+	}
+	RunInput(&buf);
+
+	free(buf.data);
+	return TEST_RESULT();
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+// Minimal test support: CHECK records failures and keeps going, so that one
+// run reports every broken expectation. Each test program returns
+// TEST_RESULT() from main.
+
+#include <stdio.h>
+
+static int testFailures;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			testFailures++; \
+		} \
+	} while (0)
+
+#define CHECK_EQ_INT(actual, expected) \
+	do { \
+		long long a_ = (long long)(actual), e_ = (long long)(expected); \
+		if (a_ != e_) { \
+			fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+			testFailures++; \
+		} \
+	} while (0)
+
+#define CHECK_EQ_WSTR(actual, expected) \
+	do { \
+		const wchar_t *a_ = (actual), *e_ = (expected); \
+		if (!a_ || wcscmp(a_, e_) != 0) { \
+			fprintf(stderr, "%s:%d: %s is \"%ls\", expected \"%ls\"\n", __FILE__, __LINE__, #actual, \
+				a_ ? a_ : L"(null)", e_); \
+			testFailures++; \
+		} \
+	} while (0)
+
+// Exit code that makes CTest report a test as skipped
+#define TEST_SKIPPED 77
+
+#define TEST_RESULT() (testFailures ? 1 : 0)
@@ -0,0 +1,140 @@
+#include "batchrender.h"
+#include "swrender.h"
+#include "timefmt.h"
+#include "test.h"
+
+#define WIDTH 96
+#define HEIGHT 40
+#define FRAME_SIZE (3 * WIDTH * HEIGHT)
+
+typedef struct {
+	PBYTE data;
+	SIZE_T size;
+} OUTPUT;
+
+static BOOL Collect(PVOID context, const BYTE *data, SIZE_T size) {
+	OUTPUT *out = context;
+	PBYTE grown = realloc(out->data, out->size + size);
+	if (!grown) return FALSE;
+	memcpy(grown + out->size, data, size);
+	out->data = grown;
+	out->size += size;
+	return TRUE;
+}
+
+static void TestPatterns(void) {
+	CHECK(IsValidFramePattern(L"frame-%u.png"));
+	CHECK(IsValidFramePattern(L"100%%/frame-%05u.ppm"));
+	CHECK(!IsValidFramePattern(L"frame.png"));
+	CHECK(!IsValidFramePattern(L"%u-%u.png"));
+	CHECK(!IsValidFramePattern(L"%s.png"));
+	CHECK(!IsValidFramePattern(L"%100u.png"));
+}
+
+static void RenderRaw(const TTFONT *font, PSETTINGS settings, LONGLONG start, UINT nFrames, UINT nThreads,
+	OUTPUT *out) {
+	BATCH_JOB job = {
+		.font = font,
+		.settings = settings,
+		.width = WIDTH,
+		.height = HEIGHT,
+		.startUtc = start,
+		.stepMs = 1000,
+		.nFrames = nFrames,
+		.nThreads = nThreads,
+		.output = BATCH_OUTPUT_RAW,
+		.writeRaw = Collect,
+		.writeContext = out
+	};
+	CHECK(RenderFrameBatch(&job, NULL));
+	CHECK_EQ_INT(out->size, (SIZE_T)nFrames * FRAME_SIZE);
+}
+
+static void TestParallelMatchesSerial(const TTFONT *font) {
+	PROPERTIES props = { 0 };
+	static const char config[] = "clock.1.zone=UTC\nclock.2.zone=UTC+05:30\nclock.2.label=Delhi\n";
+	CHECK(ParseProperties(&props, (const BYTE *)config, sizeof(config) - 1));
+	SETTINGS settings;
+	PropertiesToSettings(&settings, &props, NULL, 0);
+
+	// Enough frames for several workers and rounds, crossing midnight
+	UINT nFrames = 1000;
+	LONGLONG start = MakeUtcTimeMs(2024, 12, 31, 23, 55, 0);
+
+	OUTPUT serial = { 0 }, parallel = { 0 };
+	RenderRaw(font, &settings, start, nFrames, 1, &serial);
+	RenderRaw(font, &settings, start, nFrames, 5, &parallel);
+	CHECK(serial.size == parallel.size && memcmp(serial.data, parallel.data, serial.size) == 0);
+
+	// Any frame equals a frame rendered from scratch
+	UINT frame = 321;
+	LOCAL_TIME_CACHE cache;
+	CLOCK_ZONE zone;
+	CLOCK_TIME times[2];
+	for (UINT c = 0; c < 2; c++) {
+		ResolveClockZone(settings.clocks[c].zone, &zone);
+		InitLocalTimeCache(&cache, &zone);
+		SplitClockTime(UtcToCachedLocalTimeMs(&cache, start + frame * 1000LL), &times[c]);
+	}
+
+	SW_RENDERER renderer;
+	InitSwRenderer(&renderer, font, NULL);
+	CHECK(RenderClockToSurface(&renderer, WIDTH, HEIGHT, &settings, times));
+	BYTE expected[FRAME_SIZE];
+	CopySurfaceRgb(&renderer.surface, expected);
+	CHECK(serial.data && memcmp(serial.data + (SIZE_T)frame * FRAME_SIZE, expected, FRAME_SIZE) == 0);
+	FreeSwRenderer(&renderer);
+
+	free(serial.data);
+	free(parallel.data);
+	FreeProperties(&props);
+}
+
+static void TestImageSequence(const TTFONT *font) {
+	SETTINGS settings;
+	RestoreDefaultSettings(&settings);
+
+	BATCH_JOB job = {
+		.font = font,
+		.settings = &settings,
+		.width = WIDTH,
+		.height = HEIGHT,
+		.stepMs = 1000,
+		.nFrames = 3,
+		.output = BATCH_OUTPUT_IMAGES,
+		.imagePattern = L"test_batch-%02u.ppm",
+		.imageFormat = IMAGE_FORMAT_PPM
+	};
+	CHECK(RenderFrameBatch(&job, NULL));
+
+	for (UINT i = 0; i < 3; i++) {
+		char path[32];
+		snprintf(path, sizeof(path), "test_batch-%02u.ppm", i);
+		FILE *file = fopen(path, "rb");
+		CHECK(file != NULL);
+		if (file) {
+			fseek(file, 0, SEEK_END);
+			CHECK_EQ_INT(ftell(file), sizeof("P6\n96 40\n255\n") - 1 + FRAME_SIZE);
+			fclose(file);
+		}
+		remove(path);
+	}
+
+	// Output errors are reported
+	job.imagePattern = L"/nonexistent/frame-%u.ppm";
+	CHECK(!RenderFrameBatch(&job, NULL));
+}
+
+int main(void) {
+	TestPatterns();
+
+	TTFONT font;
+	CHECK(LoadTrueTypeFont(&font, TEST_FONT_PATH));
+	if (font.data) {
+		TestParallelMatchesSerial(&font);
+		TestImageSequence(&font);
+		FreeTrueTypeFont(&font);
+	}
+
+	return TEST_RESULT();
+}
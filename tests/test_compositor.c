@@ -0,0 +1,208 @@
+#include "compositor.h"
+#include "swrender.h"
+#include "test.h"
+
+// Straightforward versions of the blend, rounding to nearest
+static DWORD Scale(DWORD channel, DWORD factor) {
+	return (channel * factor + 127) / 255;
+}
+
+static DWORD ReferenceBlend(DWORD d, DWORD s, DWORD opacity) {
+	DWORD a = Scale(s >> 24, opacity), result = 0;
+	for (int shift = 0; shift < 24; shift += 8) {
+		DWORD channel = Scale((s >> shift) & 0xFF, opacity) + Scale((d >> shift) & 0xFF, 255 - a);
+		result |= channel << shift;
+	}
+	return result;
+}
+
+static void TestBlendRow(void) {
+	// Random premultiplied pixels, with runs of transparent and opaque ones to
+	// cover the shortcuts, over random opaque pixels
+	enum { COUNT = 103 };
+	DWORD src[COUNT], dst[COUNT], expected[COUNT];
+	DWORD seed = 12345;
+	BYTE opacities[] = { 255, 128, 1, 0 };
+
+	for (UINT o = 0; o < sizeof(opacities); o++) {
+		for (UINT i = 0; i < COUNT; i++) {
+			seed = seed * 1103515245 + 12345;
+			DWORD alpha = i < 8 ? 0 : i < 16 ? 255 : (seed >> 16) & 0xFF;
+			DWORD color = seed * 2654435761u;
+			src[i] = alpha << 24;
+			for (int shift = 0; shift < 24; shift += 8) {
+				src[i] |= Scale((color >> shift) & 0xFF, alpha) << shift;
+			}
+			dst[i] = (seed * 40503u) & 0xFFFFFF;
+			expected[i] = ReferenceBlend(dst[i], src[i], opacities[o]);
+		}
+
+		BlendPremultipliedRow(dst, src, COUNT, opacities[o]);
+		UINT mismatches = 0;
+		for (UINT i = 0; i < COUNT; i++) {
+			mismatches += dst[i] != expected[i];
+		}
+		CHECK_EQ_INT(mismatches, 0);
+	}
+}
+
+static void TestCoverageRows(void) {
+	enum { COUNT = 103 };
+	BYTE src[COUNT], dst[COUNT], expectedCoverage[COUNT];
+	DWORD pixels[COUNT], expectedPixels[COUNT];
+	COLORREF fg = RGB(250, 128, 3), bg = RGB(10, 40, 200);
+	DWORD seed = 54321;
+
+	for (UINT i = 0; i < COUNT; i++) {
+		seed = seed * 1103515245 + 12345;
+		src[i] = i < 16 ? 0 : i < 32 ? 255 : (BYTE)(seed >> 16);
+		dst[i] = (BYTE)(seed >> 8);
+		expectedCoverage[i] = (BYTE)ReferenceBlend(dst[i], (DWORD)src[i] << 24 | src[i], 200);
+
+		// A single layer of fg at this coverage over bg
+		DWORD premultiplied = (DWORD)src[i] << 24 | Scale(GetRValue(fg), src[i]) << 16 |
+			Scale(GetGValue(fg), src[i]) << 8 | Scale(GetBValue(fg), src[i]);
+		expectedPixels[i] = ReferenceBlend(ColorToPixel(bg), premultiplied, 255);
+	}
+
+	BlendCoverageRow(dst, src, COUNT, 200);
+	ExpandCoverageRow(pixels, src, COUNT, fg, bg);
+	UINT mismatches = 0;
+	for (UINT i = 0; i < COUNT; i++) {
+		mismatches += dst[i] != expectedCoverage[i];
+		mismatches += pixels[i] != expectedPixels[i];
+	}
+	CHECK_EQ_INT(mismatches, 0);
+}
+
+static void TestDirtyTiles(void) {
+	SURFACE target;
+	CHECK(CreateSurface(&target, 200, 130));
+
+	COMPOSITOR compositor;
+	InitCompositor(&compositor);
+	SetCompositorBackground(&compositor, RGB(0, 0, 255));
+	CHECK(SetCompositorTarget(&compositor, &target));
+
+	RECT rect = { 10, 10, 190, 120 };
+	UINT bottom, top;
+	CHECK(AddLayer(&compositor, &rect, &bottom));
+	CHECK(AddLayer(&compositor, &rect, &top));
+
+	// Everything is composed once, then nothing until something changes
+	CHECK_EQ_INT(ComposeLayers(&compositor), 4 * 3);
+	CHECK_EQ_INT(target.pixels[0], 0x0000FF);
+	CHECK_EQ_INT(ComposeLayers(&compositor), 0);
+
+	// A mask within one tile only composes that tile
+	BYTE opaque[10 * 10];
+	memset(opaque, 255, sizeof(opaque));
+	DrawLayerMask(&compositor, bottom, 80, 20, opaque, 10, 10, 10, RGB(255, 0, 0));
+	CHECK_EQ_INT(ComposeLayers(&compositor), 1);
+	RECT tile = { 64, 0, 128, 64 };
+	CHECK(EqualRect(&compositor.dirtyRect, &tile));
+	CHECK_EQ_INT(target.pixels[35 * 200 + 95], 0xFF0000);
+
+	// Layers are composed in order
+	BYTE half[10 * 10];
+	memset(half, 128, sizeof(half));
+	DrawLayerMask(&compositor, top, 80, 20, half, 10, 10, 10, RGB(0, 255, 0));
+	CHECK_EQ_INT(ComposeLayers(&compositor), 1);
+	CHECK_EQ_INT(target.pixels[35 * 200 + 95], 0x7F8000);
+
+	SetLayerOpacity(&compositor, top, 0);
+	CHECK_EQ_INT(ComposeLayers(&compositor), 1);
+	CHECK_EQ_INT(target.pixels[35 * 200 + 95], 0xFF0000);
+
+	// Clearing brings back the background
+	ClearLayer(&compositor, bottom);
+	CHECK_EQ_INT(ComposeLayers(&compositor), 1);
+	CHECK_EQ_INT(target.pixels[35 * 200 + 95], 0x0000FF);
+
+	// Masks are clipped to their layer
+	DrawLayerMask(&compositor, bottom, 175, 100, opaque, 10, 10, 10, RGB(255, 0, 0));
+	CHECK_EQ_INT(ComposeLayers(&compositor), 1);
+	CHECK_EQ_INT(target.pixels[115 * 200 + 189], 0xFF0000);
+	CHECK_EQ_INT(target.pixels[115 * 200 + 190], 0x0000FF);
+
+	FreeCompositor(&compositor);
+	FreeSurface(&target);
+}
+
+// Coverage layers look the same as color layers, give or take rounding
+static void TestCoverageMatchesColor(const TTFONT *font) {
+	SETTINGS settings;
+	RestoreDefaultSettings(&settings);
+	settings.fgColor = RGB(255, 200, 20);
+	settings.bgColor = RGB(20, 0, 90);
+	CLOCK_TIME time = { 10, 48, 36, 0 };
+
+	SW_RENDERER coverage, color;
+	InitSwRenderer(&coverage, font, NULL);
+	InitSwRenderer(&color, font, NULL);
+	color.format = COMPOSITOR_COLOR;
+	CHECK(RenderClockToSurface(&coverage, 640, 360, &settings, &time));
+	CHECK(RenderClockToSurface(&color, 640, 360, &settings, &time));
+	CHECK_EQ_INT(coverage.compositor.format, COMPOSITOR_COVERAGE);
+
+	UINT differences = 0, foreground = 0;
+	for (SIZE_T i = 0; i < 640 * 360; i++) {
+		DWORD a = coverage.surface.pixels[i], b = color.surface.pixels[i];
+		for (int shift = 0; shift < 24; shift += 8) {
+			int delta = (int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF);
+			differences += delta < -1 || delta > 1;
+		}
+		foreground += a == ColorToPixel(settings.fgColor);
+	}
+	CHECK_EQ_INT(differences, 0);
+	CHECK(foreground > 0);
+
+	// Switching the format between frames starts over
+	coverage.format = COMPOSITOR_COLOR;
+	CHECK(RenderClockToSurface(&coverage, 640, 360, &settings, &time));
+	CHECK_EQ_INT(coverage.compositor.format, COMPOSITOR_COLOR);
+	CHECK(coverage.backBuffer.coverage == NULL);
+	CHECK(memcmp(coverage.surface.pixels, color.surface.pixels, 640 * 360 * sizeof(DWORD)) == 0);
+
+	FreeSwRenderer(&coverage);
+	FreeSwRenderer(&color);
+}
+
+static void TestSecondsTick(const TTFONT *font) {
+	SETTINGS settings;
+	RestoreDefaultSettings(&settings);
+	CLOCK_TIME time = { 12, 34, 56, 0 };
+
+	SW_RENDERER renderer;
+	InitSwRenderer(&renderer, font, NULL);
+	CHECK(RenderClockToSurface(&renderer, 1280, 720, &settings, &time));
+	UINT allTiles = renderer.compositor.composedTiles;
+	CHECK_EQ_INT(allTiles, 20 * 12);
+
+	// Only tiles of the seconds are composed
+	time.second++;
+	CHECK(RenderClockToSurface(&renderer, 1280, 720, &settings, &time));
+	CHECK(renderer.compositor.composedTiles > 0 && renderer.compositor.composedTiles < allTiles / 4);
+	CHECK(renderer.compositor.dirtyRect.left >= renderer.grid.digits.units[2].left - COMPOSITOR_TILE_SIZE);
+
+	CHECK(RenderClockToSurface(&renderer, 1280, 720, &settings, &time));
+	CHECK_EQ_INT(renderer.compositor.composedTiles, 0);
+
+	FreeSwRenderer(&renderer);
+}
+
+int main(void) {
+	TestBlendRow();
+	TestCoverageRows();
+	TestDirtyTiles();
+
+	TTFONT font;
+	CHECK(LoadTrueTypeFont(&font, TEST_FONT_PATH));
+	if (font.data) {
+		TestCoverageMatchesColor(&font);
+		TestSecondsTick(&font);
+		FreeTrueTypeFont(&font);
+	}
+
+	return TEST_RESULT();
+}
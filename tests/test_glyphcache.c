@@ -0,0 +1,127 @@
+#include "glyphcache.h"
+#include "swrender.h"
+#include "test.h"
+
+static void TestHitsAndMisses(const TTFONT *font) {
+	GLYPH_CACHE cache;
+	InitGlyphCache(&cache, DEFAULT_GLYPH_CACHE_SIZE);
+
+	UINT zero = GetGlyphIndex(font, '0');
+	const GLYPH_MASK *mask = GetCachedGlyph(&cache, font, zero, 120, 0);
+	CHECK(mask->coverage != NULL);
+	int width = mask->width;
+
+	// Same key: a hit with the same mask
+	mask = GetCachedGlyph(&cache, font, zero, 120, 0);
+	CHECK_EQ_INT(mask->width, width);
+
+	// Each subpixel offset is rasterized separately, and is shifted
+	GLYPH_MASK reference;
+	CHECK(RasterizeGlyph(font, zero, GetFontScale(font, 120), 0.5f, &reference));
+	mask = GetCachedGlyph(&cache, font, zero, 120, GLYPH_SUBPIXEL_BUCKETS / 2);
+	CHECK(mask->width == reference.width && mask->height == reference.height && mask->left == reference.left);
+	CHECK(memcmp(mask->coverage, reference.coverage, (SIZE_T)mask->width * mask->height) == 0);
+	FreeGlyphMask(&reference);
+
+	// Empty glyphs are cached, too
+	mask = GetCachedGlyph(&cache, font, GetGlyphIndex(font, ' '), 120, 0);
+	CHECK(mask->coverage == NULL);
+	mask = GetCachedGlyph(&cache, font, GetGlyphIndex(font, ' '), 120, 0);
+
+	GLYPH_CACHE_STATS stats;
+	GetGlyphCacheStats(&cache, &stats);
+	CHECK_EQ_INT(stats.hits, 2);
+	CHECK_EQ_INT(stats.misses, 3);
+	CHECK_EQ_INT(stats.entries, 3);
+	CHECK_EQ_INT(stats.evictions, 0);
+	CHECK(stats.bytesInUse >= (SIZE_T)width * 2 && stats.bytesInUse <= stats.bytesReserved);
+
+	FreeGlyphCache(&cache);
+}
+
+static void TestEviction(const TTFONT *font) {
+	// Room for a few large digits only
+	GLYPH_CACHE cache;
+	InitGlyphCache(&cache, 16 * 1024);
+
+	UINT glyphs[10];
+	for (UINT i = 0; i < 10; i++) {
+		glyphs[i] = GetGlyphIndex(font, '0' + i);
+	}
+
+	for (UINT round = 0; round < 3; round++) {
+		for (UINT i = 0; i < 10; i++) {
+			const GLYPH_MASK *mask = GetCachedGlyph(&cache, font, glyphs[i], 150, 0);
+			CHECK(mask->coverage != NULL);
+			CHECK(cache.stats.bytesInUse <= cache.maxBytes);
+		}
+	}
+
+	GLYPH_CACHE_STATS stats;
+	GetGlyphCacheStats(&cache, &stats);
+	CHECK(stats.evictions > 0);
+	CHECK(stats.entries < 10);
+	CHECK_EQ_INT(stats.hits + stats.misses, 30);
+
+	// The most recently used glyph is still there, the least recently used is not
+	ULONGLONG misses = stats.misses;
+	GetCachedGlyph(&cache, font, glyphs[9], 150, 0);
+	CHECK_EQ_INT(cache.stats.misses, misses);
+	GetCachedGlyph(&cache, font, glyphs[0], 150, 0);
+	CHECK_EQ_INT(cache.stats.misses, misses + 1);
+
+	// Memory stays close to the cap: at most a partially used page per size
+	// class is held on top of the masks
+	for (UINT i = 0; i < 10; i++) {
+		GetCachedGlyph(&cache, font, glyphs[i], 20, 0);
+	}
+	GetGlyphCacheStats(&cache, &stats);
+	CHECK(stats.bytesInUse <= cache.maxBytes);
+	CHECK(stats.bytesReserved <= cache.maxBytes + 16 * GLYPH_POOL_MIN_PAGE_SIZE);
+
+	ClearGlyphCache(&cache);
+	GetGlyphCacheStats(&cache, &stats);
+	CHECK_EQ_INT(stats.entries, 0);
+	CHECK_EQ_INT(stats.bytesInUse, 0);
+	CHECK_EQ_INT(stats.bytesReserved, 0);
+	CHECK(stats.hits > 0);
+
+	FreeGlyphCache(&cache);
+}
+
+static void TestSharedCache(const TTFONT *font) {
+	// Two monitors of the same size share glyphs
+	SETTINGS settings;
+	RestoreDefaultSettings(&settings);
+	CLOCK_TIME time = { 12, 34, 56, 0 };
+
+	GLYPH_CACHE cache;
+	InitGlyphCache(&cache, DEFAULT_GLYPH_CACHE_SIZE);
+	SW_RENDERER first, second;
+	InitSwRenderer(&first, font, &cache);
+	InitSwRenderer(&second, font, &cache);
+
+	CHECK(RenderClockToSurface(&first, 800, 300, &settings, &time));
+	ULONGLONG misses = cache.stats.misses;
+	CHECK(misses > 0);
+	CHECK(RenderClockToSurface(&second, 800, 300, &settings, &time));
+	CHECK_EQ_INT(cache.stats.misses, misses);
+	CHECK(memcmp(first.surface.pixels, second.surface.pixels, 800 * 300 * sizeof(DWORD)) == 0);
+
+	FreeSwRenderer(&first);
+	FreeSwRenderer(&second);
+	FreeGlyphCache(&cache);
+}
+
+int main(void) {
+	TTFONT font;
+	CHECK(LoadTrueTypeFont(&font, TEST_FONT_PATH));
+	if (font.data) {
+		TestHitsAndMisses(&font);
+		TestEviction(&font);
+		TestSharedCache(&font);
+		FreeTrueTypeFont(&font);
+	}
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,116 @@
+#include "clocklayout.h"
+#include "test.h"
+
+#include <limits.h>
+
+static BOOL Contains(const RECT *outer, const RECT *inner) {
+	return inner->left >= outer->left && inner->top >= outer->top &&
+		inner->right <= outer->right && inner->bottom <= outer->bottom;
+}
+
+static void TestSingleClock(void) {
+	RECT rc = { 0, 0, 1920, 1080 };
+	CLOCK_LAYOUT layout;
+	ComputeClockLayout(&layout, &rc, 3, 80, 20);
+
+	CHECK_EQ_INT(layout.nUnits, 3);
+	for (UINT i = 0; i < 3; i++) {
+		CHECK(Contains(&rc, &layout.units[i]));
+		CHECK_EQ_INT(layout.units[i].right - layout.units[i].left, layout.units[0].right - layout.units[0].left);
+		if (i > 0) {
+			CHECK(layout.units[i].left >= layout.units[i - 1].right);
+		}
+	}
+
+	// The digits are centered
+	CHECK(abs((int)layout.units[0].left - (int)(rc.right - layout.units[2].right)) <= 3);
+
+	// "00" measured 100 pixels wide at 100 pixels height fits the unit
+	int height = ComputeClockFontHeight(&layout, 1080, 100, 100);
+	CHECK(height > 0 && height <= 1080);
+	CHECK(height * 100 / 100 <= layout.textWidthPerUnit);
+}
+
+static void TestGrid(void) {
+	RECT rc = { 0, 0, 1920, 1080 };
+
+	for (UINT n = 1; n <= 12; n++) {
+		CLOCK_GRID grid;
+		ComputeClockGrid(&grid, &rc, n, n % 2 == 0, 3, 80, 20, 1080, 1100);
+
+		CHECK(grid.columns * grid.rows >= n);
+		CHECK(grid.fontHeight > 0);
+		CHECK_EQ_INT(grid.labelHeight, n % 2 == 0 ? grid.tileHeight / 5 : 0);
+
+		// Every tile, including centered ones in the last row, is on screen
+		for (UINT i = 0; i < n; i++) {
+			POINT offset;
+			GetClockTileOffset(&grid, i, &offset);
+			RECT tile = { offset.x, offset.y, offset.x + grid.tileWidth, offset.y + grid.tileHeight };
+			CHECK(Contains(&rc, &tile));
+
+			if (grid.labelHeight) {
+				RECT label;
+				GetClockLabelRect(&grid, i, &label);
+				CHECK(Contains(&tile, &label));
+			}
+		}
+	}
+
+	// More clocks never result in larger digits
+	int previous = INT_MAX;
+	for (UINT n = 1; n <= 12; n++) {
+		CLOCK_GRID grid;
+		ComputeClockGrid(&grid, &rc, n, FALSE, 2, 80, 20, 1080, 1100);
+		CHECK(grid.fontHeight <= previous);
+		previous = grid.fontHeight;
+	}
+}
+
+static void TestDrift(void) {
+	RECT rc = { 0, 0, 1920, 1080 }, rect;
+	CHECK_EQ_INT(GetDriftLayoutRect(&rc, 16, &rect), 16);
+	RECT inset = { 16, 16, 1904, 1064 };
+	CHECK(EqualRect(&rect, &inset));
+
+	// Small windows such as the preview keep most of their area
+	RECT small = { 0, 0, 152, 40 };
+	CHECK_EQ_INT(GetDriftLayoutRect(&small, 16, &rect), 10);
+
+	POINT offset;
+	GetDriftOffset(0, 600, 123456789, &offset);
+	CHECK(offset.x == 0 && offset.y == 0);
+
+	// Within the range, one pixel at a time, reaching every row and column
+	BOOL columns[17] = { FALSE }, rows[17] = { FALSE };
+	POINT previous;
+	GetDriftOffset(8, 600, -1000, &previous);
+	BOOL smooth = TRUE, bounded = TRUE;
+	for (LONGLONG t = 0; t <= 600 * 7 * 1000; t += 1000) {
+		GetDriftOffset(8, 600, t, &offset);
+		bounded &= abs(offset.x) <= 8 && abs(offset.y) <= 8;
+		smooth &= abs(offset.x - previous.x) <= 1 && abs(offset.y - previous.y) <= 1;
+		if (bounded) {
+			columns[offset.x + 8] = rows[offset.y + 8] = TRUE;
+		}
+		previous = offset;
+	}
+	CHECK(bounded);
+	CHECK(smooth);
+	for (UINT i = 0; i < 17; i++) {
+		CHECK(columns[i] && rows[i]);
+	}
+
+	// The path only depends on the time
+	POINT again;
+	GetDriftOffset(8, 600, 133600000123456LL, &offset);
+	GetDriftOffset(8, 600, 133600000123456LL, &again);
+	CHECK(offset.x == again.x && offset.y == again.y);
+}
+
+int main(void) {
+	TestSingleClock();
+	TestGrid();
+	TestDrift();
+	return TEST_RESULT();
+}
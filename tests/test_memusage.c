@@ -0,0 +1,116 @@
+#include "glyphcache.h"
+#include "memusage.h"
+#include "properties.h"
+#include "surface.h"
+#include "test.h"
+
+static SIZE_T GetTracked(MEMORY_CATEGORY category) {
+	MEMORY_USAGE usage;
+	GetMemoryUsage(&usage);
+	return usage.bytes[category];
+}
+
+static void TestSurfaces(void) {
+	SIZE_T before = GetTracked(MEMORY_SURFACES);
+
+	SURFACE surface;
+	CHECK(CreateSurface(&surface, 100, 50));
+	CHECK_EQ_INT(GetTracked(MEMORY_SURFACES) - before, 100 * 50 * 4);
+
+	FreeSurface(&surface);
+	CHECK_EQ_INT(GetTracked(MEMORY_SURFACES), before);
+
+	// Freeing twice or freeing a failed surface changes nothing
+	FreeSurface(&surface);
+	CHECK(!CreateSurface(&surface, 0, 10));
+	FreeSurface(&surface);
+	CHECK_EQ_INT(GetTracked(MEMORY_SURFACES), before);
+}
+
+static void TestProperties(void) {
+	SIZE_T before = GetTracked(MEMORY_PROPERTIES);
+
+	PROPERTIES props = { 0 };
+	const char text[] = "scale=50\nfontName=Lato\n";
+	CHECK(ParseProperties(&props, (const BYTE *)text, strlen(text)));
+	SIZE_T parsed = GetTracked(MEMORY_PROPERTIES) - before;
+	CHECK(parsed > 0);
+
+	// Replacing a value accounts for the difference in length
+	CHECK(SetProperty(&props, L"fontName", L"Lato Hairline"));
+	CHECK_EQ_INT(GetTracked(MEMORY_PROPERTIES) - before, parsed + 9 * sizeof(WCHAR));
+
+	FreeProperties(&props);
+	CHECK_EQ_INT(GetTracked(MEMORY_PROPERTIES), before);
+}
+
+static void TestFontAndGlyphs(void) {
+	SIZE_T fontsBefore = GetTracked(MEMORY_FONTS), glyphsBefore = GetTracked(MEMORY_GLYPHS);
+
+	TTFONT font;
+	CHECK(LoadTrueTypeFont(&font, TEST_FONT_PATH));
+	if (!font.data) return;
+	CHECK_EQ_INT(GetTracked(MEMORY_FONTS) - fontsBefore, font.size);
+
+	GLYPH_CACHE cache;
+	InitGlyphCache(&cache, DEFAULT_GLYPH_CACHE_SIZE);
+	for (UINT c = '0'; c <= '9'; c++) {
+		GetCachedGlyph(&cache, &font, GetGlyphIndex(&font, c), 200, 0);
+	}
+
+	// Pages and the index are tracked, not just the masks
+	GLYPH_CACHE_STATS stats;
+	GetGlyphCacheStats(&cache, &stats);
+	CHECK(GetTracked(MEMORY_GLYPHS) - glyphsBefore > stats.bytesReserved);
+
+	FreeGlyphCache(&cache);
+	CHECK_EQ_INT(GetTracked(MEMORY_GLYPHS), glyphsBefore);
+
+	FreeTrueTypeFont(&font);
+	CHECK_EQ_INT(GetTracked(MEMORY_FONTS), fontsBefore);
+
+	MEMORY_USAGE usage;
+	GetMemoryUsage(&usage);
+	CHECK(usage.peak >= usage.total + stats.bytesReserved);
+}
+
+static void TestBudget(void) {
+	SURFACE held;
+	CHECK(CreateSurface(&held, 256, 256));
+
+	MEMORY_USAGE usage;
+	GetMemoryUsage(&usage);
+	SIZE_T frame = 1920 * 1080;
+
+	// What is already held counts against the budget
+	CHECK_EQ_INT(ChooseBackBufferMode(0, 1920, 1080), BACK_BUFFER_FULL_COLOR);
+	CHECK_EQ_INT(ChooseBackBufferMode(usage.total + frame * 4, 1920, 1080), BACK_BUFFER_FULL_COLOR);
+	CHECK_EQ_INT(ChooseBackBufferMode(frame * 4, 1920, 1080), BACK_BUFFER_LOW_COLOR);
+	CHECK_EQ_INT(ChooseBackBufferMode(usage.total + frame * 2, 1920, 1080), BACK_BUFFER_LOW_COLOR);
+	CHECK_EQ_INT(ChooseBackBufferMode(usage.total + frame, 1920, 1080), BACK_BUFFER_NONE);
+	CHECK_EQ_INT(ChooseBackBufferMode(1, 1920, 1080), BACK_BUFFER_NONE);
+
+	CHECK_EQ_INT(ChooseGlyphCacheSize(0), DEFAULT_GLYPH_CACHE_SIZE);
+	CHECK_EQ_INT(ChooseGlyphCacheSize(usage.total + 1024 * 1024 * 1024), DEFAULT_GLYPH_CACHE_SIZE);
+	CHECK_EQ_INT(ChooseGlyphCacheSize(usage.total + 4 * 1024 * 1024), 1024 * 1024);
+	CHECK_EQ_INT(ChooseGlyphCacheSize(1), MIN_GLYPH_CACHE_SIZE);
+
+	FreeSurface(&held);
+}
+
+static void TestFormat(void) {
+	MEMORY_USAGE usage = { { 8294400, 1, 0, 2048 }, 8296449, 12000000 };
+	WCHAR text[MEMORY_USAGE_MAX_CHARS];
+	FormatMemoryUsage(&usage, text, MEMORY_USAGE_MAX_CHARS);
+	CHECK_EQ_WSTR(text, L"surfaces 8100 KB, glyphs 1 KB, fonts 0 KB, properties 2 KB, total 8103 KB, peak 11719 KB");
+}
+
+int main(void) {
+	TestSurfaces();
+	TestProperties();
+	TestFontAndGlyphs();
+	TestBudget();
+	TestFormat();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,192 @@
+#include "profiles.h"
+#include "test.h"
+
+#include <stdio.h>
+
+static BOOL Parse(PPROPERTIES props, const char *text) {
+	return ParseProperties(props, (const BYTE *)text, strlen(text));
+}
+
+static UINT Resolve(PPROPERTIES props, PCWSTR host, UINT monitor, int width, int height, PSETTINGS settings) {
+	PROFILE_SET set;
+	PWSTR rejected[4];
+	UINT nRejected;
+	PROFILE_TARGET target = { host, monitor, width, height };
+	CHECK(IndexProfiles(&set, props, rejected, 4, &nRejected));
+	CHECK_EQ_INT(nRejected, 0);
+	UINT n = ResolveProfileSettings(&set, &target, settings, rejected, 4);
+	FreeProfiles(&set);
+	return n;
+}
+
+static void TestSelectors(void) {
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "scale=50\nclock.1.zone=UTC\n"
+		"profile.lobby.host=LOBBY-*\nprofile.lobby.scale=60\n"
+		"profile.wall.host=wall-01\nprofile.wall.monitor=2\nprofile.wall.space=30\n"
+		"profile.big.resolution=3840x2160\nprofile.big.scale=90\nprofile.big.clock.1.label=Big\n"));
+
+	// Without a matching profile only the base settings apply
+	SETTINGS settings;
+	CHECK_EQ_INT(Resolve(&props, L"desk", 1, 1920, 1080, &settings), 0);
+	CHECK_EQ_INT(settings.scale, 50);
+	CHECK_EQ_INT(settings.space, 20);
+	CHECK_EQ_INT(settings.nClocks, 1);
+	CHECK(settings.clocks[0].label == NULL);
+
+	// Host names ignore case and '*' matches any characters
+	CHECK_EQ_INT(Resolve(&props, L"lobby-east", 1, 1920, 1080, &settings), 0);
+	CHECK_EQ_INT(settings.scale, 60);
+	CHECK_EQ_INT(Resolve(&props, L"LOBBY-", 1, 1920, 1080, &settings), 0);
+	CHECK_EQ_INT(settings.scale, 60);
+	CHECK_EQ_INT(Resolve(&props, L"MY-LOBBY-1", 1, 1920, 1080, &settings), 0);
+	CHECK_EQ_INT(settings.scale, 50);
+
+	// All selectors of a profile must match
+	CHECK_EQ_INT(Resolve(&props, L"WALL-01", 1, 1920, 1080, &settings), 0);
+	CHECK_EQ_INT(settings.space, 20);
+	CHECK_EQ_INT(Resolve(&props, L"WALL-01", 2, 1920, 1080, &settings), 0);
+	CHECK_EQ_INT(settings.space, 30);
+	CHECK_EQ_INT(Resolve(&props, NULL, 2, 1920, 1080, &settings), 0);
+	CHECK_EQ_INT(settings.space, 20);
+
+	CHECK_EQ_INT(Resolve(&props, L"desk", 1, 3840, 2160, &settings), 0);
+	CHECK_EQ_INT(settings.scale, 90);
+	CHECK_EQ_INT(settings.nClocks, 1);
+	CHECK_EQ_WSTR(settings.clocks[0].label, L"Big");
+	CHECK_EQ_WSTR(settings.clocks[0].zone, L"UTC");
+
+	FreeProperties(&props);
+}
+
+static void TestOrder(void) {
+	// Profiles apply in the order of their first property, whether they are
+	// found by host name or not
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "profile.a.host=*\nprofile.b.host=kiosk\nprofile.c.monitor=1\nprofile.d.host=KIOSK\n"
+		"profile.d.scale=40\nprofile.c.scale=30\nprofile.b.scale=20\nprofile.a.scale=10\n"
+		"profile.b.space=5\nprofile.a.space=6\nprofile.c.fgColor=FF0000\nprofile.d.fgColor=00FF00\n"));
+
+	PROFILE_SET set;
+	PWSTR rejected[4];
+	UINT nRejected;
+	CHECK(IndexProfiles(&set, &props, rejected, 4, &nRejected));
+	CHECK_EQ_INT(set.nProfiles, 4);
+
+	PROFILE_TARGET target = { L"kiosk", 1, 800, 600 };
+	CHECK_EQ_INT(CountMatchingProfiles(&set, &target), 4);
+
+	SETTINGS settings;
+	CHECK_EQ_INT(ResolveProfileSettings(&set, &target, &settings, rejected, 4), 0);
+	CHECK_EQ_INT(settings.scale, 40);
+	CHECK_EQ_INT(settings.space, 5);
+	CHECK_EQ_INT(settings.fgColor, RGB(0, 255, 0));
+
+	target.monitor = 2;
+	CHECK_EQ_INT(CountMatchingProfiles(&set, &target), 3);
+	CHECK_EQ_INT(ResolveProfileSettings(&set, &target, &settings, rejected, 4), 0);
+	CHECK_EQ_INT(settings.fgColor, RGB(0, 255, 0));
+
+	target.host = L"other";
+	CHECK_EQ_INT(CountMatchingProfiles(&set, &target), 1);
+	CHECK_EQ_INT(ResolveProfileSettings(&set, &target, &settings, rejected, 4), 0);
+	CHECK_EQ_INT(settings.scale, 10);
+	CHECK_EQ_INT(settings.space, 6);
+	CHECK_EQ_INT(settings.fgColor, RGB(255, 255, 255));
+
+	FreeProfiles(&set);
+	FreeProperties(&props);
+}
+
+static void TestInvalid(void) {
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "profile.a.monitor=0\nprofile.a.scale=10\nprofile.b.resolution=big\nprofile.b.scale=20\n"
+		"profile.c.host=\nprofile.c.scale=30\nprofile.d.scale=101\nprofile.d.space=7\nprofile.e.unknown=1\n"
+		"profile..scale=1\nprofile.f=1\nprofile.g.=1\n"));
+
+	// A profile with an invalid selector never applies
+	PROFILE_SET set;
+	PWSTR rejected[4];
+	UINT nRejected;
+	CHECK(IndexProfiles(&set, &props, rejected, 4, &nRejected));
+	CHECK_EQ_INT(nRejected, 3);
+	CHECK_EQ_WSTR(rejected[0], L"profile.a.monitor");
+	CHECK_EQ_WSTR(rejected[1], L"profile.b.resolution");
+	CHECK_EQ_WSTR(rejected[2], L"profile.c.host");
+
+	// Invalid values are rejected like in PropertiesToSettings
+	PROFILE_TARGET target = { L"any", 1, 1920, 1080 };
+	SETTINGS settings;
+	CHECK_EQ_INT(CountMatchingProfiles(&set, &target), 2);
+	CHECK_EQ_INT(ResolveProfileSettings(&set, &target, &settings, rejected, 4), 1);
+	CHECK_EQ_WSTR(rejected[0], L"profile.d.scale");
+	CHECK_EQ_INT(settings.scale, 80);
+	CHECK_EQ_INT(settings.space, 7);
+
+	FreeProfiles(&set);
+	FreeProperties(&props);
+}
+
+static void TestMatchesPropertiesToSettings(void) {
+	// Without profiles the result is the same as PropertiesToSettings
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "scale=50\nspace=101\nclock.2.zone=UTC+9\nclock.1.zone=UTC\nclock.1.label=A\n"));
+
+	SETTINGS expected, settings;
+	PWSTR rejected[4];
+	CHECK_EQ_INT(PropertiesToSettings(&expected, &props, rejected, 4), 1);
+	CHECK_EQ_INT(Resolve(&props, L"any", 1, 1920, 1080, &settings), 1);
+	CHECK(memcmp(&expected, &settings, sizeof(SETTINGS)) == 0);
+
+	FreeProperties(&props);
+}
+
+static void TestManyProfiles(void) {
+	// One file for a fleet: every host has a profile per monitor
+	PROPERTIES props = { 0 };
+	WCHAR name[64], value[32];
+	for (UINT i = 0; i < 1000; i++) {
+		for (UINT m = 1; m <= 2; m++) {
+			swprintf(name, 64, L"profile.h%u-m%u.host", i, m);
+			swprintf(value, 32, L"HOST-%u", i);
+			CHECK(SetProperty(&props, name, value));
+			swprintf(name, 64, L"profile.h%u-m%u.monitor", i, m);
+			swprintf(value, 32, L"%u", m);
+			CHECK(SetProperty(&props, name, value));
+			swprintf(name, 64, L"profile.h%u-m%u.scale", i, m);
+			swprintf(value, 32, L"%u", (i + m) % 100);
+			CHECK(SetProperty(&props, name, value));
+		}
+	}
+
+	PROFILE_SET set;
+	PWSTR rejected[4];
+	UINT nRejected;
+	CHECK(IndexProfiles(&set, &props, rejected, 4, &nRejected));
+	CHECK_EQ_INT(set.nProfiles, 2000);
+	CHECK_EQ_INT(set.nOthers, 0);
+
+	SETTINGS settings;
+	for (UINT i = 0; i < 1000; i += 37) {
+		swprintf(name, 64, L"host-%u", i);
+		PROFILE_TARGET target = { name, 2, 1920, 1080 };
+		CHECK_EQ_INT(CountMatchingProfiles(&set, &target), 1);
+		CHECK_EQ_INT(ResolveProfileSettings(&set, &target, &settings, rejected, 4), 0);
+		CHECK_EQ_INT(settings.scale, (i + 2) % 100);
+	}
+
+	PROFILE_TARGET unknown = { L"HOST-1000", 1, 1920, 1080 };
+	CHECK_EQ_INT(CountMatchingProfiles(&set, &unknown), 0);
+
+	FreeProfiles(&set);
+	FreeProperties(&props);
+}
+
+int main(void) {
+	TestSelectors();
+	TestOrder();
+	TestInvalid();
+	TestMatchesPropertiesToSettings();
+	TestManyProfiles();
+	return TEST_RESULT();
+}
@@ -0,0 +1,154 @@
+#include "properties.h"
+#include "test.h"
+
+static BOOL Parse(PPROPERTIES props, const char *text) {
+	return ParseProperties(props, (const BYTE *)text, strlen(text));
+}
+
+static void TestParse(void) {
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "# comment\n\n  a = 1\r\nb=two words  \nempty=\nc.d-e_f=x=y"));
+	CHECK_EQ_INT(props.count, 4);
+	CHECK_EQ_WSTR(GetProperty(&props, L"a"), L"1");
+	CHECK_EQ_WSTR(GetProperty(&props, L"b"), L"two words");
+	CHECK_EQ_WSTR(GetProperty(&props, L"empty"), L"");
+	CHECK_EQ_WSTR(GetProperty(&props, L"c.d-e_f"), L"x=y");
+	CHECK(GetProperty(&props, L"missing") == NULL);
+	FreeProperties(&props);
+}
+
+static void TestDuplicatesReplaceValues(void) {
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "a=1\nb=2\na=3\n"));
+	CHECK_EQ_INT(props.count, 2);
+	CHECK_EQ_WSTR(GetProperty(&props, L"a"), L"3");
+	FreeProperties(&props);
+}
+
+static void TestRemove(void) {
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "a=1\nb=2\nc=3\nd=4\n"));
+	CHECK(RemoveProperty(&props, L"b"));
+	CHECK(!RemoveProperty(&props, L"b"));
+	CHECK(!RemoveProperty(&props, L"missing"));
+
+	// The others keep their order and can still be found
+	CHECK_EQ_INT(props.count, 3);
+	CHECK_EQ_WSTR(props.items[0].name, L"a");
+	CHECK_EQ_WSTR(props.items[1].name, L"c");
+	CHECK_EQ_WSTR(props.items[2].name, L"d");
+	CHECK(GetProperty(&props, L"b") == NULL);
+	CHECK_EQ_WSTR(GetProperty(&props, L"d"), L"4");
+
+	CHECK(SetProperty(&props, L"b", L"5"));
+	CHECK_EQ_WSTR(props.items[3].name, L"b");
+	CHECK_EQ_WSTR(GetProperty(&props, L"b"), L"5");
+	FreeProperties(&props);
+}
+
+static void TestInvalidLines(void) {
+	static const char *invalid[] = { "novalue\n", "=1\n", "a b=1\n", "a=1\n!=2\n", "key" };
+	for (UINT i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		PROPERTIES props = { 0 };
+		CHECK(!Parse(&props, invalid[i]));
+		CHECK_EQ_INT(GetLastError(), ERROR_INVALID_DATA);
+		FreeProperties(&props);
+	}
+}
+
+static void TestEncodings(void) {
+	// UTF-8 with a byte order mark
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "\xEF\xBB\xBFlabel=Z\xC3\xBCrich\n"));
+	CHECK_EQ_WSTR(GetProperty(&props, L"label"), L"Z\x00FCrich");
+	FreeProperties(&props);
+
+	// UTF-16LE with a byte order mark, as written by Notepad
+	static const BYTE utf16[] = { 0xFF, 0xFE, 'a', 0, '=', 0, 0xAC, 0x20, '\n', 0 };
+	CHECK(ParseProperties(&props, utf16, sizeof(utf16)));
+	CHECK_EQ_WSTR(GetProperty(&props, L"a"), L"\x20AC");
+	FreeProperties(&props);
+}
+
+static void TestManyProperties(void) {
+	// Enough properties to grow the index several times
+	PROPERTIES props = { 0 };
+	for (UINT i = 0; i < 5000; i++) {
+		WCHAR name[16];
+		swprintf(name, 16, L"key%u", i);
+		CHECK(SetUIntProperty(&props, name, i));
+	}
+	CHECK_EQ_INT(props.count, 5000);
+
+	UINT value;
+	CHECK(GetUIntProperty(&props, L"key0", &value) && value == 0);
+	CHECK(GetUIntProperty(&props, L"key4999", &value) && value == 4999);
+
+	// Writing them takes time linear in the size of the file
+	WCHAR widePath[] = L"test_properties_many.tmp";
+	CHECK(WriteProperties(&props, widePath));
+	FreeProperties(&props);
+
+	CHECK(ReadProperties(&props, widePath));
+	CHECK_EQ_INT(props.count, 5000);
+	CHECK(GetUIntProperty(&props, L"key2500", &value) && value == 2500);
+	CHECK(GetUIntProperty(&props, L"key4999", &value) && value == 4999);
+	FreeProperties(&props);
+	remove("test_properties_many.tmp");
+}
+
+static void TestValues(void) {
+	UINT u;
+	CHECK(ParseUIntValue(L"4294967295", &u) && u == 4294967295u);
+	CHECK(!ParseUIntValue(L"4294967296", &u));
+	CHECK(!ParseUIntValue(L"", &u));
+	CHECK(!ParseUIntValue(L"12a", &u));
+
+	COLORREF c;
+	CHECK(ParseRgbValue(L"ff8000", &c) && c == RGB(255, 128, 0));
+	CHECK(!ParseRgbValue(L"ff800", &c));
+	CHECK(!ParseRgbValue(L"ff80001", &c));
+	CHECK(!ParseRgbValue(L"gg0000", &c));
+
+	BOOL b;
+	CHECK(ParseBoolValue(L"Yes", &b) && b);
+	CHECK(ParseBoolValue(L"false", &b) && !b);
+	CHECK(!ParseBoolValue(L"1", &b));
+}
+
+static void TestRoundTrip(void) {
+	// Tests run in the build directory
+	WCHAR widePath[] = L"test_properties.tmp";
+
+	PROPERTIES props = { 0 };
+	SetProperty(&props, L"label", L"Z\x00FCrich");
+	SetRgbProperty(&props, L"color", RGB(1, 2, 3));
+	SetBoolProperty(&props, L"flag", TRUE);
+	CHECK(WriteProperties(&props, widePath));
+	FreeProperties(&props);
+
+	CHECK(ReadProperties(&props, widePath));
+	COLORREF c;
+	BOOL b;
+	CHECK_EQ_WSTR(GetProperty(&props, L"label"), L"Z\x00FCrich");
+	CHECK(GetRgbProperty(&props, L"color", &c) && c == RGB(1, 2, 3));
+	CHECK(GetBoolProperty(&props, L"flag", &b) && b);
+	FreeProperties(&props);
+
+	remove("test_properties.tmp");
+
+	CHECK(!ReadProperties(&props, L"/nonexistent/clock.properties"));
+	CHECK_EQ_INT(GetLastError(), ERROR_FILE_NOT_FOUND);
+}
+
+int main(void) {
+	TestParse();
+	TestDuplicatesReplaceValues();
+	TestRemove();
+	TestInvalidLines();
+	TestEncodings();
+	TestManyProperties();
+	TestValues();
+	TestRoundTrip();
+	return TEST_RESULT();
+}
@@ -0,0 +1,218 @@
+#include "raster.h"
+#include "ttfont.h"
+#include "swrender.h"
+#include "imagefile.h"
+#include "test.h"
+
+static void TestRaster(void) {
+	// A square from (1, 1) to (3, 3), then the same square shifted by half a
+	// pixel, in both orientations
+	for (int pass = 0; pass < 3; pass++) {
+		float o = pass == 1 ? 0.5f : 0;
+		float x[4] = { 1 + o, 3 + o, 3 + o, 1 + o }, y[4] = { 1, 1, 3, 3 };
+
+		RASTER raster;
+		CHECK(InitRaster(&raster, 5, 4));
+		for (int i = 0; i < 4; i++) {
+			int j = (i + 1) % 4;
+			if (pass == 2) {
+				AddRasterLine(&raster, x[j], y[j], x[i], y[i]);
+			}
+			else {
+				AddRasterLine(&raster, x[i], y[i], x[j], y[j]);
+			}
+		}
+
+		BYTE coverage[4 * 5];
+		ResolveRaster(&raster, coverage, 5);
+		FreeRaster(&raster);
+
+		if (pass == 1) {
+			CHECK_EQ_INT(coverage[1 * 5 + 1], 128);
+			CHECK_EQ_INT(coverage[1 * 5 + 2], 255);
+			CHECK_EQ_INT(coverage[1 * 5 + 3], 128);
+		}
+		else {
+			CHECK_EQ_INT(coverage[1 * 5 + 1], 255);
+			CHECK_EQ_INT(coverage[2 * 5 + 2], 255);
+			CHECK_EQ_INT(coverage[1 * 5 + 3], 0);
+		}
+		CHECK_EQ_INT(coverage[0], 0);
+		CHECK_EQ_INT(coverage[3 * 5 + 1], 0);
+	}
+}
+
+static void TestFont(const TTFONT *font) {
+	UINT zero = GetGlyphIndex(font, '0');
+	CHECK(zero != 0);
+	CHECK(GetGlyphIndex(font, 0x10FFFF) == 0);
+	CHECK(GetGlyphAdvance(font, zero) > 0);
+
+	// Digits are tabular, so that the clock does not move
+	CHECK_EQ_INT(GetGlyphAdvance(font, GetGlyphIndex(font, '1')), GetGlyphAdvance(font, zero));
+
+	GLYPH_MASK mask;
+	CHECK(RasterizeGlyph(font, zero, GetFontScale(font, 200), 0, &mask));
+	CHECK(mask.width > 0 && mask.height > 100 && mask.top < 0);
+
+	UINT sum = 0;
+	for (int i = 0; i < mask.width * mask.height; i++) {
+		sum += mask.coverage[i];
+	}
+	CHECK(sum > 0);
+	FreeGlyphMask(&mask);
+
+	// The space has no outline
+	CHECK(RasterizeGlyph(font, GetGlyphIndex(font, ' '), 1, 0, &mask));
+	CHECK(mask.coverage == NULL);
+}
+
+static BOOL SurfacesEqual(const SURFACE *a, const SURFACE *b) {
+	return a->width == b->width && a->height == b->height &&
+		memcmp(a->pixels, b->pixels, (SIZE_T)a->width * a->height * sizeof(DWORD)) == 0;
+}
+
+static void TestIncrementalRendering(const TTFONT *font) {
+	PROPERTIES props = { 0 };
+	static const char config[] = "clock.1.zone=UTC\nclock.1.label=One\nclock.2.zone=UTC+1\nfgColor=FF8000\n";
+	CHECK(ParseProperties(&props, (const BYTE *)config, sizeof(config) - 1));
+
+	SETTINGS settings;
+	PropertiesToSettings(&settings, &props, NULL, 0);
+
+	CLOCK_TIME first[2] = { { 11, 59, 58, 0 }, { 12, 59, 58, 0 } };
+	CLOCK_TIME second[2] = { { 11, 59, 59, 0 }, { 13, 0, 0, 0 } };
+
+	SW_RENDERER incremental, full;
+	InitSwRenderer(&incremental, font, NULL);
+	InitSwRenderer(&full, font, NULL);
+
+	CHECK(RenderClockToSurface(&incremental, 640, 360, &settings, first));
+	CHECK(RenderClockToSurface(&full, 640, 360, &settings, first));
+	CHECK(SurfacesEqual(&incremental.surface, &full.surface));
+
+	// Something other than the background was drawn, in the foreground color
+	BOOL foreground = FALSE;
+	for (int i = 0; i < 640 * 360; i++) {
+		foreground |= incremental.surface.pixels[i] == ColorToPixel(RGB(255, 128, 0));
+	}
+	CHECK(foreground);
+
+	// Redrawing only changed digits gives the same result as a full redraw
+	CHECK(RenderClockToSurface(&incremental, 640, 360, &settings, second));
+	InvalidateSwRenderer(&full);
+	CHECK(RenderClockToSurface(&full, 640, 360, &settings, second));
+	CHECK(SurfacesEqual(&incremental.surface, &full.surface));
+
+	// Appearance changes are picked up
+	settings.bgColor = RGB(0, 0, 255);
+	CHECK(RenderClockToSurface(&incremental, 640, 360, &settings, second));
+	CHECK_EQ_INT(incremental.surface.pixels[0], ColorToPixel(RGB(0, 0, 255)));
+
+	FreeSwRenderer(&incremental);
+	FreeSwRenderer(&full);
+	FreeProperties(&props);
+}
+
+static void TestDrift(const TTFONT *font) {
+	SETTINGS settings;
+	RestoreDefaultSettings(&settings);
+	settings.driftRange = 8;
+	settings.driftPeriod = 60;
+	CLOCK_TIME time = { 12, 34, 56, 0 };
+
+	SW_RENDERER renderer;
+	InitSwRenderer(&renderer, font, NULL);
+	CHECK(RenderClockToSurface(&renderer, 320, 180, &settings, &time));
+	CHECK_EQ_INT(renderer.driftRange, 8);
+	CHECK_EQ_INT(renderer.grid.rect.left, 8);
+
+	// Half way through the period, the face is at the right edge of the box
+	SURFACE drifted = { 0 };
+	CHECK(PresentSwRenderer(&renderer, &drifted, &settings, 30000));
+	POINT offset;
+	GetDriftOffset(8, 60, 30000, &offset);
+	CHECK_EQ_INT(offset.x, 8);
+
+	// The frame is the back buffer moved by the offset, nothing is redrawn
+	BOOL moved = TRUE;
+	for (int y = 0; y < 180; y++) {
+		for (int x = 0; x < 320; x++) {
+			int sx = x - offset.x, sy = y - offset.y;
+			DWORD expected = sx >= 0 && sy >= 0 && sx < 320 && sy < 180 ?
+				renderer.surface.pixels[sy * 320 + sx] : ColorToPixel(settings.bgColor);
+			moved &= drifted.pixels[y * 320 + x] == expected;
+		}
+	}
+	CHECK(moved);
+	CHECK(RenderClockToSurface(&renderer, 320, 180, &settings, &time));
+	CHECK_EQ_INT(renderer.compositor.composedTiles, 0);
+
+	FreeSurface(&drifted);
+	FreeSwRenderer(&renderer);
+}
+
+static DWORD ReadBigEndian(const BYTE *p) {
+	return ((DWORD)p[0] << 24) | ((DWORD)p[1] << 16) | ((DWORD)p[2] << 8) | p[3];
+}
+
+static void TestImageFiles(void) {
+	SURFACE surface;
+	CHECK(CreateSurface(&surface, 300, 250));
+	for (int i = 0; i < 300 * 250; i++) {
+		surface.pixels[i] = (DWORD)i * 2654435761u & 0xFFFFFF;
+	}
+
+	// PPM
+	SIZE_T size;
+	PBYTE ppm = EncodePpm(&surface, &size);
+	CHECK(ppm && size == 15 + 300 * 250 * 3);
+	CHECK(memcmp(ppm, "P6\n300 250\n255\n", 15) == 0);
+	CHECK(ppm[15 + 3 * 7 + 1] == (BYTE)(surface.pixels[7] >> 8));
+	free(ppm);
+
+	// PNG, unpacking the stored deflate blocks to compare the image data
+	PBYTE png = EncodePng(&surface, &size);
+	CHECK(png && memcmp(png, "\x89PNG\r\n\x1A\n", 8) == 0);
+	CHECK(memcmp(png + 12, "IHDR", 4) == 0 && ReadBigEndian(png + 16) == 300 && ReadBigEndian(png + 20) == 250);
+
+	const BYTE *idat = png + 8 + 25;
+	CHECK(memcmp(idat + 4, "IDAT", 4) == 0);
+	const BYTE *p = idat + 8 + 2;
+	SIZE_T pos = 0, rowSize = 1 + 300 * 3;
+	BOOL final = FALSE, match = TRUE;
+	while (!final && p < png + size) {
+		final = p[0] & 1;
+		UINT len = p[1] | (p[2] << 8);
+		CHECK((len ^ 0xFFFF) == (UINT)(p[3] | (p[4] << 8)));
+		p += 5;
+		for (UINT i = 0; i < len; i++, pos++) {
+			SIZE_T x = pos % rowSize, y = pos / rowSize;
+			BYTE expected = x == 0 ? 0 : (BYTE)(surface.pixels[y * 300 + (x - 1) / 3] >> (16 - 8 * ((x - 1) % 3)));
+			match &= p[i] == expected;
+		}
+		p += len;
+	}
+	CHECK(final && match);
+	CHECK_EQ_INT(pos, rowSize * 250);
+	CHECK(memcmp(png + size - 8, "IEND", 4) == 0);
+	free(png);
+
+	FreeSurface(&surface);
+}
+
+int main(void) {
+	TestRaster();
+	TestImageFiles();
+
+	TTFONT font;
+	CHECK(LoadTrueTypeFont(&font, TEST_FONT_PATH));
+	if (font.data) {
+		TestFont(&font);
+		TestIncrementalRendering(&font);
+		TestDrift(&font);
+		FreeTrueTypeFont(&font);
+	}
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,100 @@
+#include "replay.h"
+#include "surface.h"
+#include "test.h"
+
+static void TestHash(void) {
+	SURFACE a, b;
+	CHECK(CreateSurface(&a, 8, 4));
+	CHECK(CreateSurface(&b, 4, 8));
+
+	// The size counts, not just the pixels
+	CHECK(HashSurface(&a) != HashSurface(&b));
+
+	ULONGLONG hash = HashSurface(&a);
+	a.pixels[31] = 1;
+	CHECK(HashSurface(&a) != hash);
+	a.pixels[31] = 0;
+	CHECK(HashSurface(&a) == hash);
+
+	FreeSurface(&a);
+	FreeSurface(&b);
+}
+
+static void TestErrors(const TTFONT *font) {
+	static const PCWSTR invalid[] = {
+		L"size 0x100", L"size 100", L"time 24:00:00", L"time 12:00", L"tick 0", L"tick", L"frame 2",
+		L"set scale", L"set =1", L"set scale=1000", L"jump"
+	};
+
+	for (UINT i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+		WCHAR script[64];
+		swprintf(script, 64, L"# comment\nframe\n\n%ls\nframe\n", invalid[i]);
+
+		// Frames before the error are kept
+		REPLAY replay = { 0 };
+		CHECK(!RunReplay(&replay, script, font));
+		CHECK_EQ_INT(GetLastError(), ERROR_INVALID_DATA);
+		CHECK_EQ_INT(replay.errorLine, 4);
+		CHECK_EQ_INT(replay.nFrames, 1);
+		FreeReplay(&replay);
+	}
+}
+
+static void TestFrames(const TTFONT *font) {
+	static const WCHAR script[] =
+		L"size 320x180\r\n"
+		L"  time 10:59:59  \r\n"
+		L"frame\r\n"
+		L"tick 2\r\n"
+		L"invalidate\r\n"
+		L"frame\r\n"
+		L"set fgColor=FF0000\r\n"
+		L"frame\r\n"
+		L"reset\r\n"
+		L"frame";
+
+	REPLAY first = { 0 }, second = { 0 };
+	CHECK(RunReplay(&first, script, font));
+	CHECK(RunReplay(&second, script, font));
+	CHECK_EQ_INT(first.nFrames, 6);
+	if (first.nFrames != 6 || second.nFrames != 6) return;
+
+	// Replays are deterministic
+	for (UINT i = 0; i < first.nFrames; i++) {
+		CHECK(first.frames[i].hash == second.frames[i].hash);
+		CHECK_EQ_INT(first.frames[i].composedTiles, second.frames[i].composedTiles);
+	}
+
+	// Frames are attributed to their lines, and a tick renders the time after it
+	CHECK_EQ_INT(first.frames[0].line, 3);
+	CHECK_EQ_INT(first.frames[2].line, 4);
+	CHECK(first.frames[1].hash != first.frames[0].hash);
+
+	// Only the changed units are composed, unless everything was invalidated
+	UINT allTiles = 5 * 3;
+	CHECK_EQ_INT(first.frames[0].composedTiles, allTiles);
+	CHECK(first.frames[1].composedTiles < allTiles);
+	CHECK_EQ_INT(first.frames[3].composedTiles, allTiles);
+	CHECK(first.frames[3].hash == first.frames[2].hash);
+
+	// Changing a setting changes the frame, resetting brings it back
+	CHECK(first.frames[4].hash != first.frames[3].hash);
+	CHECK(first.frames[5].hash == first.frames[3].hash);
+
+	FreeReplay(&first);
+	FreeReplay(&second);
+}
+
+int main(void) {
+	TestHash();
+
+	TTFONT font;
+	CHECK(LoadTrueTypeFont(&font, TEST_FONT_PATH));
+	if (font.data) {
+		TestErrors(&font);
+		TestFrames(&font);
+		FreeTrueTypeFont(&font);
+	}
+
+	return TEST_RESULT();
+}
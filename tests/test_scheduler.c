@@ -0,0 +1,203 @@
+#include "scheduler.h"
+#include "timefmt.h"
+#include "test.h"
+
+// 2024-03-10 12:00:00.000 UTC
+#define START_UTC MakeUtcTimeMs(2024, 3, 10, 12, 0, 0)
+
+typedef struct {
+	TIME_SOURCE source;
+	FAKE_CLOCK clock;
+	FRAME_SCHEDULER scheduler;
+	// Second shown by the last frame, and how many seconds were skipped
+	LONGLONG shown;
+	UINT nSkipped;
+} SIMULATION, *PSIMULATION;
+
+static void StartSimulation(PSIMULATION sim, LONGLONG utcMs) {
+	InitFakeTimeSource(&sim->source, &sim->clock, utcMs);
+	InitFrameScheduler(&sim->scheduler, &sim->source, 1000, 10);
+	sim->shown = -1;
+	sim->nSkipped = 0;
+}
+
+// Lets the delay of the last tick pass, stretched by ppm like a timer whose
+// clock runs at a different rate than the wall clock, and ticks.
+static void Tick(PSIMULATION sim, UINT delayMs, int ppm, PFRAME_TICK tick) {
+	AdvanceFakeClock(&sim->clock, delayMs * 1000LL + (LONGLONG)delayMs * ppm / 1000);
+	TickFrameScheduler(&sim->scheduler, tick);
+	if (tick->render) {
+		LONGLONG second = tick->utcMs / 1000;
+		if (sim->shown >= 0 && second > sim->shown + 1) {
+			sim->nSkipped += (UINT)(second - sim->shown - 1);
+		}
+		sim->shown = second;
+	}
+}
+
+// Runs for the given number of ticks and returns the delay of the last one.
+static UINT Run(PSIMULATION sim, UINT delayMs, int ppm, UINT nTicks) {
+	FRAME_TICK tick;
+	for (UINT i = 0; i < nTicks; i++) {
+		Tick(sim, delayMs, ppm, &tick);
+		delayMs = tick.delayMs;
+	}
+	return delayMs;
+}
+
+static void TestFakeClock(void) {
+	TIME_SOURCE source;
+	FAKE_CLOCK clock;
+	InitFakeTimeSource(&source, &clock, START_UTC);
+	CHECK(GetSourceUtcMs(&source) == START_UTC);
+	CHECK(GetSourceMonotonicUs(&source) == 0);
+
+	// Microseconds add up, the wall clock rounds towards the past
+	AdvanceFakeClock(&clock, 600);
+	AdvanceFakeClock(&clock, 600);
+	CHECK(GetSourceUtcMs(&source) == START_UTC + 1);
+	CHECK(GetSourceMonotonicUs(&source) == 1200);
+
+	// Steps only move the wall clock
+	StepFakeClock(&clock, -5000);
+	CHECK(GetSourceUtcMs(&source) == START_UTC - 4999);
+	CHECK(GetSourceMonotonicUs(&source) == 1200);
+}
+
+static void TestSystemClock(void) {
+	TIME_SOURCE source;
+	InitSystemTimeSource(&source);
+	LONGLONG mono = GetSourceMonotonicUs(&source), utc = GetSourceUtcMs(&source);
+	CHECK(GetSourceMonotonicUs(&source) >= mono);
+	CHECK(GetUtcTimeMs() - utc < 1000);
+}
+
+static void TestSteady(void) {
+	SIMULATION sim;
+	StartSimulation(&sim, START_UTC + 400);
+
+	// The first tick renders and aligns to just after the next second
+	FRAME_TICK tick;
+	Tick(&sim, 0, 0, &tick);
+	CHECK(tick.render);
+	CHECK(!tick.jumped);
+	CHECK_EQ_INT(tick.delayMs, 610);
+
+	// One frame per second, each 10 ms after the second
+	Run(&sim, tick.delayMs, 0, 100);
+	CHECK_EQ_INT(sim.scheduler.nFrames, 101);
+	CHECK_EQ_INT(sim.scheduler.nEarly, 0);
+	CHECK_EQ_INT(sim.scheduler.nJumps, 0);
+	CHECK_EQ_INT(sim.nSkipped, 0);
+	CHECK_EQ_INT(GetSourceUtcMs(&sim.source) % 1000, 10);
+}
+
+static void TestTimerDrift(void) {
+	// A timer that runs 2% fast keeps coming early: those ticks render
+	// nothing and wait for the second, none is skipped
+	SIMULATION sim;
+	StartSimulation(&sim, START_UTC);
+	Run(&sim, 0, -20000, 300);
+	CHECK_EQ_INT(sim.nSkipped, 0);
+	CHECK_EQ_INT(sim.scheduler.nJumps, 0);
+	CHECK(sim.scheduler.nEarly > 0);
+	CHECK_EQ_INT(sim.scheduler.nFrames + sim.scheduler.nEarly, 300);
+	CHECK_EQ_INT(sim.shown - START_UTC / 1000 + 1, sim.scheduler.nFrames);
+
+	// One that runs slow is never a second late
+	StartSimulation(&sim, START_UTC);
+	Run(&sim, 0, 5000, 300);
+	CHECK_EQ_INT(sim.nSkipped, 0);
+	CHECK_EQ_INT(sim.scheduler.nEarly, 0);
+	CHECK_EQ_INT(sim.scheduler.nFrames, 300);
+}
+
+static void TestLate(void) {
+	// A tick that comes late, e.g. because the system was busy or a suspend
+	// on Windows, where both clocks keep counting, renders only once
+	SIMULATION sim;
+	StartSimulation(&sim, START_UTC);
+	Run(&sim, 0, 0, 10);
+
+	FRAME_TICK tick;
+	Tick(&sim, 3600 * 1000 + 123, 0, &tick);
+	CHECK(tick.render);
+	CHECK(!tick.jumped);
+	CHECK_EQ_INT(tick.delayMs, 1000 - 133 + 10);
+	CHECK_EQ_INT(sim.scheduler.nFrames, 11);
+
+	// and continues on the second
+	Run(&sim, tick.delayMs, 0, 5);
+	CHECK_EQ_INT(sim.scheduler.nFrames, 16);
+	CHECK_EQ_INT(GetSourceUtcMs(&sim.source) % 1000, 10);
+}
+
+static void TestStep(void) {
+	SIMULATION sim;
+	StartSimulation(&sim, START_UTC);
+	UINT delay = Run(&sim, 0, 0, 10);
+
+	// NTP steps the wall clock back by 1.5 s: the next tick shows the
+	// earlier second at once and aligns to the new seconds
+	FRAME_TICK tick;
+	StepFakeClock(&sim.clock, -1500);
+	Tick(&sim, delay, 0, &tick);
+	CHECK(tick.render);
+	CHECK(tick.jumped);
+	CHECK_EQ_INT(tick.delayMs, 500);
+	CHECK(tick.utcMs == START_UTC + 8510);
+	CHECK_EQ_INT(sim.scheduler.nJumps, 1);
+
+	Tick(&sim, tick.delayMs, 0, &tick);
+	CHECK(tick.render);
+	CHECK(!tick.jumped);
+	CHECK_EQ_INT(tick.delayMs, 1000);
+
+	// A step forward within the same second still redraws once
+	StepFakeClock(&sim.clock, 400);
+	Tick(&sim, 100, 0, &tick);
+	CHECK(tick.render);
+	CHECK(tick.jumped);
+	CHECK_EQ_INT(tick.delayMs, 500);
+	CHECK_EQ_INT(sim.scheduler.nJumps, 2);
+
+	// Slewing is not a jump
+	StepFakeClock(&sim.clock, 50);
+	Tick(&sim, tick.delayMs, 0, &tick);
+	CHECK(!tick.jumped);
+	CHECK_EQ_INT(sim.scheduler.nJumps, 2);
+}
+
+static void TestSuspend(void) {
+	// On Linux, the monotonic clock stops during a suspend: the wall clock
+	// seems to jump, and a single frame shows the time after the resume
+	SIMULATION sim;
+	StartSimulation(&sim, START_UTC);
+	UINT delay = Run(&sim, 0, 0, 10);
+	UINT nFrames = sim.scheduler.nFrames;
+
+	FRAME_TICK tick;
+	StepFakeClock(&sim.clock, 8 * 3600 * 1000 + 250);
+	Tick(&sim, delay, 0, &tick);
+	CHECK(tick.render);
+	CHECK(tick.jumped);
+	CHECK(tick.utcMs == START_UTC + 8 * 3600 * 1000 + 10 * 1000 + 260);
+	CHECK_EQ_INT(tick.delayMs, 750);
+	CHECK_EQ_INT(sim.scheduler.nFrames, nFrames + 1);
+
+	Run(&sim, tick.delayMs, 0, 3);
+	CHECK_EQ_INT(sim.scheduler.nFrames, nFrames + 4);
+	CHECK_EQ_INT(sim.scheduler.nJumps, 1);
+	CHECK_EQ_INT(GetSourceUtcMs(&sim.source) % 1000, 10);
+}
+
+int main(void) {
+	TestFakeClock();
+	TestSystemClock();
+	TestSteady();
+	TestTimerDrift();
+	TestLate();
+	TestStep();
+	TestSuspend();
+	return TEST_RESULT();
+}
@@ -0,0 +1,142 @@
+#include "settings.h"
+#include "test.h"
+
+static BOOL Parse(PPROPERTIES props, const char *text) {
+	return ParseProperties(props, (const BYTE *)text, strlen(text));
+}
+
+static void TestDefaults(void) {
+	SETTINGS settings;
+	RestoreDefaultSettings(&settings);
+	CHECK_EQ_INT(settings.scale, 80);
+	CHECK_EQ_INT(settings.space, 20);
+	CHECK(settings.showSeconds);
+	CHECK(!settings.use12HourClock);
+	CHECK_EQ_INT(settings.fgColor, RGB(255, 255, 255));
+	CHECK_EQ_INT(settings.bgColor, RGB(0, 0, 0));
+	CHECK_EQ_INT(settings.nClocks, 0);
+	CHECK_EQ_INT(GetClockCount(&settings), 1);
+	CHECK(!HasClockLabels(&settings));
+	CHECK_EQ_INT(settings.driftRange, 0);
+	CHECK_EQ_INT(settings.driftPeriod, 600);
+	CHECK_EQ_INT(settings.memoryBudget, 0);
+}
+
+static void TestParseAndReject(void) {
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "scale=50\nspace=101\nshowSeconds=no\nfgColor=red\nunknown=1\nuse12HourClock=yes\n"
+		"driftRange=12\ndriftPeriod=5\nmemoryBudget=64\n"));
+
+	SETTINGS settings;
+	PWSTR rejected[1];
+	CHECK_EQ_INT(PropertiesToSettings(&settings, &props, rejected, 1), 3);
+	CHECK_EQ_WSTR(rejected[0], L"space");
+	CHECK_EQ_INT(settings.scale, 50);
+	CHECK_EQ_INT(settings.space, 20);
+	CHECK(!settings.showSeconds);
+	CHECK(settings.use12HourClock);
+	CHECK_EQ_INT(settings.fgColor, RGB(255, 255, 255));
+	CHECK_EQ_INT(settings.driftRange, 12);
+	CHECK_EQ_INT(settings.driftPeriod, 600);
+	CHECK_EQ_INT(settings.memoryBudget, 64);
+	FreeProperties(&props);
+}
+
+static void TestClocks(void) {
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "clock.2.zone=UTC+9\nclock.1.zone=UTC\nclock.1.label=London\nclock.4.zone=UTC-3\n"
+		"clock.13.zone=UTC\nclock.0.zone=UTC\n"));
+
+	// Clocks are counted up to the first gap, out of range indices are rejected
+	SETTINGS settings;
+	PWSTR rejected[4];
+	CHECK_EQ_INT(PropertiesToSettings(&settings, &props, rejected, 4), 0);
+	CHECK_EQ_INT(settings.nClocks, 2);
+	CHECK_EQ_WSTR(settings.clocks[0].zone, L"UTC");
+	CHECK_EQ_WSTR(settings.clocks[0].label, L"London");
+	CHECK_EQ_WSTR(settings.clocks[1].zone, L"UTC+9");
+	CHECK(settings.clocks[1].label == NULL);
+	CHECK(settings.clocks[3].zone == NULL);
+	CHECK(HasClockLabels(&settings));
+	FreeProperties(&props);
+}
+
+static void TestRoundTrip(void) {
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "scale=42\nbgColor=102030\nclock.1.zone=UTC\nclock.1.label=A\nclock.2.zone=local\n"));
+
+	SETTINGS settings;
+	PropertiesToSettings(&settings, &props, NULL, 0);
+
+	PROPERTIES out = { 0 };
+	SettingsToProperties(&settings, &out);
+	CHECK_EQ_WSTR(GetProperty(&out, L"scale"), L"42");
+	CHECK_EQ_WSTR(GetProperty(&out, L"bgColor"), L"102030");
+	CHECK_EQ_WSTR(GetProperty(&out, L"clock.1.zone"), L"UTC");
+	CHECK_EQ_WSTR(GetProperty(&out, L"clock.2.zone"), L"local");
+
+	SETTINGS again;
+	PropertiesToSettings(&again, &out, NULL, 0);
+	CHECK_EQ_INT(again.scale, 42);
+	CHECK_EQ_INT(again.bgColor, RGB(0x10, 0x20, 0x30));
+	CHECK_EQ_INT(again.nClocks, 2);
+	CHECK_EQ_WSTR(again.clocks[0].label, L"A");
+
+	FreeProperties(&out);
+	FreeProperties(&props);
+}
+
+static void TestSerializeIntoSource(void) {
+	// Settings that point into the properties they are stored in again, as in
+	// the configuration dialog, must not be left pointing at freed values
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "fontName=Segoe UI\nclock.1.zone=UTC\nclock.1.label=A\n"));
+
+	SETTINGS settings;
+	PropertiesToSettings(&settings, &props, NULL, 0);
+	for (UINT pass = 0; pass < 2; pass++) {
+		SettingsToProperties(&settings, &props);
+		CHECK(settings.fontName == GetProperty(&props, L"fontName"));
+		CHECK(settings.clocks[0].label == GetProperty(&props, L"clock.1.label"));
+		CHECK_EQ_WSTR(settings.fontName, L"Segoe UI");
+		CHECK_EQ_WSTR(settings.clocks[0].zone, L"UTC");
+		CHECK_EQ_WSTR(settings.clocks[0].label, L"A");
+	}
+
+	FreeProperties(&props);
+}
+
+static void TestSerializeDefaults(void) {
+	// Restoring the defaults drops the clocks, and so must storing them in the
+	// properties they were read from
+	PROPERTIES props = { 0 };
+	CHECK(Parse(&props, "scale=50\nfontName=Segoe UI\nclock.1.zone=UTC\nclock.1.label=A\nclock.2.zone=UTC+9\n"));
+
+	SETTINGS settings;
+	PropertiesToSettings(&settings, &props, NULL, 0);
+	RestoreDefaultSettings(&settings);
+	SettingsToProperties(&settings, &props);
+	CHECK(GetProperty(&props, L"clock.1.zone") == NULL);
+	CHECK(GetProperty(&props, L"clock.1.label") == NULL);
+	CHECK(GetProperty(&props, L"clock.2.zone") == NULL);
+	CHECK_EQ_WSTR(GetProperty(&props, L"fontName"), L"");
+	CHECK_EQ_WSTR(GetProperty(&props, L"scale"), L"80");
+
+	// Read again, they show the single local clock of the defaults
+	SETTINGS read;
+	CHECK_EQ_INT(PropertiesToSettings(&read, &props, NULL, 0), 0);
+	CHECK_EQ_INT(read.nClocks, 0);
+	CHECK_EQ_INT(read.scale, 80);
+
+	FreeProperties(&props);
+}
+
+int main(void) {
+	TestDefaults();
+	TestParseAndReject();
+	TestClocks();
+	TestRoundTrip();
+	TestSerializeIntoSource();
+	TestSerializeDefaults();
+	return TEST_RESULT();
+}
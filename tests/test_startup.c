@@ -0,0 +1,57 @@
+#include "startup.h"
+#include "test.h"
+
+static void TestPhases(void) {
+	STARTUP_PROFILE profile;
+	BeginStartupProfile(&profile);
+	MarkStartupPhase(&profile, L"settings");
+	MarkStartupPhase(&profile, L"font");
+	CHECK(EndStartupProfile(&profile, L"first frame"));
+	CHECK_EQ_INT(profile.nPhases, 3);
+	CHECK_EQ_WSTR(profile.phases[2].name, L"first frame");
+
+	// Phases add up to the total
+	LONGLONG sum = 0;
+	for (UINT i = 0; i < profile.nPhases; i++) {
+		CHECK(profile.phases[i].us >= 0);
+		sum += profile.phases[i].us;
+	}
+	CHECK(sum == GetStartupTime(&profile));
+
+	// Nothing is recorded once finished
+	LONGLONG total = GetStartupTime(&profile);
+	MarkStartupPhase(&profile, L"late");
+	CHECK(!EndStartupProfile(&profile, L"again"));
+	CHECK_EQ_INT(profile.nPhases, 3);
+	CHECK(GetStartupTime(&profile) == total);
+}
+
+static void TestTooManyPhases(void) {
+	STARTUP_PROFILE profile;
+	BeginStartupProfile(&profile);
+	for (UINT i = 0; i < STARTUP_MAX_PHASES + 5; i++) {
+		MarkStartupPhase(&profile, L"phase");
+	}
+	CHECK_EQ_INT(profile.nPhases, STARTUP_MAX_PHASES);
+	CHECK(GetStartupTime(&profile) >= 0);
+}
+
+static void TestFormat(void) {
+	STARTUP_PROFILE profile = { 1000, 4570, 3, { { L"settings", 420 }, { L"font", 100 }, { L"first frame", 3050 } } };
+	WCHAR text[STARTUP_PROFILE_MAX_CHARS];
+	FormatStartupProfile(&profile, text, STARTUP_PROFILE_MAX_CHARS);
+	CHECK_EQ_WSTR(text, L"settings 0.42 ms, font 0.10 ms, first frame 3.05 ms, total 3.57 ms");
+
+	// Truncated rather than overflowed
+	WCHAR small[12];
+	FormatStartupProfile(&profile, small, 12);
+	CHECK(wcslen(small) < 12);
+}
+
+int main(void) {
+	TestPhases();
+	TestTooManyPhases();
+	TestFormat();
+
+	return TEST_RESULT();
+}
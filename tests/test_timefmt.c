@@ -0,0 +1,133 @@
+#include "timefmt.h"
+#include "test.h"
+
+#define HOUR_MS (60 * 60 * 1000LL)
+
+static void TestMakeUtcTime(void) {
+	CHECK_EQ_INT(MakeUtcTimeMs(1601, 1, 1, 0, 0, 0), 0);
+	CHECK_EQ_INT(MakeUtcTimeMs(1970, 1, 1, 0, 0, 0), 11644473600000LL);
+	CHECK_EQ_INT(MakeUtcTimeMs(2000, 3, 1, 0, 0, 0) - MakeUtcTimeMs(2000, 2, 28, 0, 0, 0), 48 * HOUR_MS);
+	CHECK_EQ_INT(MakeUtcTimeMs(2100, 3, 1, 0, 0, 0) - MakeUtcTimeMs(2100, 2, 28, 0, 0, 0), 24 * HOUR_MS);
+	CHECK_EQ_INT(MakeUtcTimeMs(2024, 3, 10, 12, 34, 56) - MakeUtcTimeMs(2024, 3, 10, 0, 0, 0),
+		(12 * 3600 + 34 * 60 + 56) * 1000LL);
+}
+
+static void TestFormat(void) {
+	CLOCK_TIME time = { 23, 5, 9, 0 };
+	WCHAR text[CLOCK_FORMAT_MAX_CHARS];
+
+	CHECK_EQ_INT(FormatClockTime(&time, 3, 0, text), 6);
+	CHECK_EQ_WSTR(text, L"230509");
+	CHECK_EQ_INT(FormatClockTime(&time, 2, CLOCK_FORMAT_SEPARATORS, text), 5);
+	CHECK_EQ_WSTR(text, L"23:05");
+	FormatClockTime(&time, 3, CLOCK_FORMAT_12H | CLOCK_FORMAT_SEPARATORS, text);
+	CHECK_EQ_WSTR(text, L"11:05:09");
+
+	time.hour = 0;
+	FormatClockTime(&time, 2, CLOCK_FORMAT_12H, text);
+	CHECK_EQ_WSTR(text, L"1205");
+}
+
+static void TestSplit(void) {
+	CLOCK_TIME time;
+	SplitClockTime(MakeUtcTimeMs(2024, 1, 1, 13, 14, 15) + 678, &time);
+	CHECK_EQ_INT(time.hour, 13);
+	CHECK_EQ_INT(time.minute, 14);
+	CHECK_EQ_INT(time.second, 15);
+	CHECK_EQ_INT(time.milliseconds, 678);
+
+	// Times before the epoch wrap around to the previous day
+	SplitClockTime(-1000, &time);
+	CHECK_EQ_INT(time.hour, 23);
+	CHECK_EQ_INT(time.second, 59);
+}
+
+static void TestFixedZones(void) {
+	CLOCK_ZONE zone;
+	CHECK(ResolveClockZone(L"UTC", &zone) && zone.kind == CLOCK_ZONE_FIXED && zone.fixedOffset == 0);
+	CHECK(ResolveClockZone(L"utc+9", &zone) && zone.fixedOffset == 9 * HOUR_MS);
+	CHECK(ResolveClockZone(L"UTC-03:30", &zone) && zone.fixedOffset == -(3 * HOUR_MS + HOUR_MS / 2));
+	CHECK(ResolveClockZone(L"", &zone) && zone.kind == CLOCK_ZONE_LOCAL);
+	CHECK(ResolveClockZone(L"local", &zone) && zone.kind == CLOCK_ZONE_LOCAL);
+	CHECK(!ResolveClockZone(L"UTC+15", &zone));
+	CHECK(!ResolveClockZone(L"UTC+5:3", &zone));
+	CHECK(!ResolveClockZone(L"No/Such_Zone", &zone) && zone.kind == CLOCK_ZONE_LOCAL);
+
+	LOCAL_TIME_CACHE cache;
+	ResolveClockZone(L"UTC+05:30", &zone);
+	InitLocalTimeCache(&cache, &zone);
+	LONGLONG utc = MakeUtcTimeMs(2024, 6, 1, 20, 0, 0);
+	CHECK_EQ_INT(UtcToCachedLocalTimeMs(&cache, utc) - utc, 5 * HOUR_MS + HOUR_MS / 2);
+}
+
+typedef struct {
+	PCWSTR zone;
+	// Last minute before and first minute after a transition, in UTC
+	int year, month, day, hour, minute;
+	LONGLONG offsetBefore;
+	LONGLONG offsetAfter;
+} TRANSITION;
+
+// Transitions in both hemispheres and in both directions, including a zone
+// with a 30-minute DST shift
+static const TRANSITION transitions[] = {
+	{ L"America/New_York", 2024, 3, 10, 7, 0, -5 * HOUR_MS, -4 * HOUR_MS },
+	{ L"America/New_York", 2024, 11, 3, 6, 0, -4 * HOUR_MS, -5 * HOUR_MS },
+	{ L"Europe/Berlin", 2024, 3, 31, 1, 0, 1 * HOUR_MS, 2 * HOUR_MS },
+	{ L"Europe/Berlin", 2024, 10, 27, 1, 0, 2 * HOUR_MS, 1 * HOUR_MS },
+	{ L"Australia/Sydney", 2024, 4, 6, 16, 0, 11 * HOUR_MS, 10 * HOUR_MS },
+	{ L"Australia/Sydney", 2024, 10, 5, 16, 0, 10 * HOUR_MS, 11 * HOUR_MS },
+	{ L"Australia/Lord_Howe", 2024, 4, 6, 15, 0, 11 * HOUR_MS, 21 * HOUR_MS / 2 },
+};
+
+static BOOL TestDstTransitions(void) {
+	CLOCK_ZONE zone;
+	if (!ResolveClockZone(L"America/New_York", &zone)) {
+		fprintf(stderr, "time zone database not available, skipping DST tests\n");
+		return FALSE;
+	}
+
+	for (UINT i = 0; i < sizeof(transitions) / sizeof(transitions[0]); i++) {
+		const TRANSITION *t = &transitions[i];
+		CHECK(ResolveClockZone(t->zone, &zone));
+
+		LONGLONG at = MakeUtcTimeMs(t->year, t->month, t->day, t->hour, t->minute, 0);
+
+		// Start well before the transition so that the cache has to find it
+		// within its lookahead window, then step across it
+		LOCAL_TIME_CACHE cache;
+		InitLocalTimeCache(&cache, &zone);
+		LONGLONG start = at - 20 * HOUR_MS;
+		CHECK_EQ_INT(UtcToCachedLocalTimeMs(&cache, start) - start, t->offsetBefore);
+		CHECK_EQ_INT(cache.validUntil, at);
+		CHECK_EQ_INT(UtcToCachedLocalTimeMs(&cache, at - 1) - (at - 1), t->offsetBefore);
+		CHECK_EQ_INT(UtcToCachedLocalTimeMs(&cache, at) - at, t->offsetAfter);
+
+		// A fresh cache right after the transition agrees
+		InitLocalTimeCache(&cache, &zone);
+		CHECK_EQ_INT(UtcToCachedLocalTimeMs(&cache, at + 1) - (at + 1), t->offsetAfter);
+	}
+
+	// Going back in time, e.g. after the system clock was changed, also
+	// refreshes the cache
+	ResolveClockZone(L"Europe/Berlin", &zone);
+	LOCAL_TIME_CACHE cache;
+	InitLocalTimeCache(&cache, &zone);
+	LONGLONG summer = MakeUtcTimeMs(2024, 7, 1, 12, 0, 0);
+	LONGLONG winter = MakeUtcTimeMs(2024, 1, 1, 12, 0, 0);
+	CHECK_EQ_INT(UtcToCachedLocalTimeMs(&cache, summer) - summer, 2 * HOUR_MS);
+	CHECK_EQ_INT(UtcToCachedLocalTimeMs(&cache, winter) - winter, 1 * HOUR_MS);
+
+	return TRUE;
+}
+
+int main(void) {
+	TestMakeUtcTime();
+	TestFormat();
+	TestSplit();
+	TestFixedZones();
+	BOOL zones = TestDstTransitions();
+
+	if (testFailures) return 1;
+	return zones ? 0 : TEST_SKIPPED;
+}
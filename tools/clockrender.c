@@ -0,0 +1,376 @@
+// Renders frames of the clock into PNG or PPM files or a raw video stream,
+// without a window or any system graphics library.
+
+#include "properties.h"
+#include "profiles.h"
+#include "settings.h"
+#include "swrender.h"
+#include "imagefile.h"
+#include "memusage.h"
+#include "batchrender.h"
+#include "utf.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+static void PrintUsage(void) {
+	fprintf(stderr,
+		"Usage: clockrender [options] -o <output>\n"
+		"  -o <file.png|file.ppm>     a single frame\n"
+		"  -o <frame-%%05u.png>        one file per frame, numbered from 0\n"
+		"  -o <file.rgb|->            raw 8-bit RGB frames, e.g. for ffmpeg -f rawvideo\n"
+		"  --utc YYYY-MM-DDTHH:MM:SS  render this UTC time in the configured zones (default: now)\n"
+		"  --time HH:MM:SS            show this time of day on every clock (single frame only)\n"
+		"  --frames N                 number of frames (default: 1)\n"
+		"  --step SECONDS             time between frames (default: 1)\n"
+		"  --jobs N                   worker threads (default: one per processor)\n"
+		"  --glyph-cache MB           glyph cache size per worker (default: 16, or less with memoryBudget)\n"
+		"  --size WxH                 image size (default: 1920x1080)\n"
+		"  --config <file>            settings in the .properties format\n"
+		"  --host NAME                host name that selects profiles (default: this computer's)\n"
+		"  --monitor N                monitor that selects profiles (default: 1)\n"
+		"  --font <file.ttf>          TrueType font (default: %s)\n",
+		DEFAULT_FONT_PATH);
+}
+
+static BOOL ParseTimeOfDay(PCSTR str, PCLOCK_TIME time) {
+	UINT hour, minute, second = 0;
+	int n = sscanf(str, "%u:%u:%u", &hour, &minute, &second);
+	if (n < 2 || hour > 23 || minute > 59 || second > 59) return FALSE;
+
+	time->hour = (WORD)hour;
+	time->minute = (WORD)minute;
+	time->second = (WORD)second;
+	time->milliseconds = 0;
+	return TRUE;
+}
+
+static BOOL ParseUtcTime(PCSTR str, LONGLONG *utc) {
+	int year;
+	UINT month, day, hour, minute, second = 0;
+	int n = sscanf(str, "%d-%u-%uT%u:%u:%u", &year, &month, &day, &hour, &minute, &second);
+	if (n < 5 || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 59) {
+		return FALSE;
+	}
+
+	*utc = MakeUtcTimeMs(year, month, day, hour, minute, second);
+	return TRUE;
+}
+
+static void PrintRejected(PWSTR *rejected, UINT nRejected, UINT maxRejected) {
+	for (UINT i = 0; i < min(nRejected, maxRejected); i++) {
+		PSTR name = WideToUtf8String(rejected[i]);
+		fprintf(stderr, "clockrender: ignoring invalid value of %s\n", name ? name : "?");
+		free(name);
+	}
+}
+
+// Loads settings from a file, with the profiles that apply to target on top,
+// keeping the properties alive because settings point into them
+static BOOL LoadSettingsFile(PCSTR path, PPROPERTIES props, PSETTINGS settings, const PROFILE_TARGET *target) {
+	PWSTR widePath = Utf8ToWideString(path);
+	if (!widePath) return FALSE;
+
+	BOOL ret = ReadProperties(props, widePath);
+	free(widePath);
+	if (!ret) {
+		fprintf(stderr, "clockrender: cannot read %s (error %u)\n", path, (UINT)GetLastError());
+		return FALSE;
+	}
+
+	PROFILE_SET profiles;
+	PWSTR rejected[8];
+	UINT nRejected;
+	if (!IndexProfiles(&profiles, props, rejected, 8, &nRejected)) {
+		fprintf(stderr, "clockrender: cannot index the profiles of %s (error %u)\n", path, (UINT)GetLastError());
+		return FALSE;
+	}
+	PrintRejected(rejected, nRejected, 8);
+	PrintRejected(rejected, ResolveProfileSettings(&profiles, target, settings, rejected, 8), 8);
+	FreeProfiles(&profiles);
+
+	return TRUE;
+}
+
+static BOOL WriteRawFrames(PVOID context, const BYTE *data, SIZE_T size) {
+	return fwrite(data, 1, size, (FILE *)context) == size;
+}
+
+static BOOL IsRawOutput(PCSTR output) {
+	SIZE_T len = strlen(output);
+	return strcmp(output, "-") == 0 || (len > 4 && strcmp(output + len - 4, ".rgb") == 0);
+}
+
+// Renders a sequence of frames into numbered images or a raw stream
+static int RenderSequence(PCSTR output, const TTFONT *font, PSETTINGS settings, int width, int height,
+	LONGLONG startUtc, LONGLONG stepMs, UINT nFrames, UINT nThreads, SIZE_T glyphCacheSize) {
+	BATCH_JOB job = {
+		.font = font,
+		.settings = settings,
+		.width = width,
+		.height = height,
+		.startUtc = startUtc,
+		.stepMs = stepMs,
+		.nFrames = nFrames,
+		.nThreads = nThreads,
+		.glyphCacheSize = glyphCacheSize
+	};
+
+	FILE *file = NULL;
+	PWSTR pattern = NULL;
+	if (IsRawOutput(output)) {
+		if (strcmp(output, "-") == 0) {
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			file = stdout;
+		}
+		else if (!(file = fopen(output, "wb"))) {
+			fprintf(stderr, "clockrender: cannot open %s\n", output);
+			return 1;
+		}
+		job.output = BATCH_OUTPUT_RAW;
+		job.writeRaw = WriteRawFrames;
+		job.writeContext = file;
+	}
+	else {
+		pattern = Utf8ToWideString(output);
+		if (!pattern || !IsValidFramePattern(pattern)) {
+			fprintf(stderr, "clockrender: %s must contain a single %%u for the frame number\n", output);
+			free(pattern);
+			return 2;
+		}
+		job.output = BATCH_OUTPUT_IMAGES;
+		job.imagePattern = pattern;
+		job.imageFormat = GetImageFormatFromPath(pattern);
+	}
+
+	LONGLONG start = GetPlatformMonotonicTimeMs();
+	GLYPH_CACHE_STATS glyphStats;
+	BOOL ok = RenderFrameBatch(&job, &glyphStats);
+	LONGLONG elapsed = GetPlatformMonotonicTimeMs() - start;
+
+	if (file && file != stdout && fclose(file) != 0) {
+		ok = FALSE;
+	}
+	else if (file == stdout && fflush(stdout) != 0) {
+		ok = FALSE;
+	}
+	free(pattern);
+
+	if (!ok) {
+		fprintf(stderr, "clockrender: rendering failed (error %u)\n", (UINT)GetLastError());
+		return 1;
+	}
+
+	fprintf(stderr, "clockrender: %u frames in %lld ms (%.1f frames/s)\n", nFrames, (long long)elapsed,
+		elapsed ? nFrames * 1000.0 / elapsed : 0.0);
+
+	ULONGLONG lookups = glyphStats.hits + glyphStats.misses;
+	fprintf(stderr, "clockrender: glyph cache hit rate %.2f%%, %llu evictions, %zu KB of masks\n",
+		lookups ? glyphStats.hits * 100.0 / lookups : 0.0, (unsigned long long)glyphStats.evictions,
+		glyphStats.bytesInUse / 1024);
+
+	MEMORY_USAGE usage;
+	WCHAR usageText[MEMORY_USAGE_MAX_CHARS];
+	GetMemoryUsage(&usage);
+	FormatMemoryUsage(&usage, usageText, MEMORY_USAGE_MAX_CHARS);
+	fprintf(stderr, "clockrender: memory %ls\n", usageText);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	PCSTR output = NULL, config = NULL, fontPath = DEFAULT_FONT_PATH;
+	PCSTR utcArg = NULL, timeArg = NULL, hostArg = NULL;
+	int width = 1920, height = 1080;
+	UINT nFrames = 1, nThreads = 0, step = 1, glyphCacheMb = 0, monitor = 1;
+
+	for (int i = 1; i < argc; i++) {
+		BOOL hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "-o") == 0 && hasValue) {
+			output = argv[++i];
+		}
+		else if (strcmp(argv[i], "--utc") == 0 && hasValue) {
+			utcArg = argv[++i];
+		}
+		else if (strcmp(argv[i], "--time") == 0 && hasValue) {
+			timeArg = argv[++i];
+		}
+		else if (strcmp(argv[i], "--size") == 0 && hasValue) {
+			if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0 ||
+				width > 16384 || height > 16384) {
+				fprintf(stderr, "clockrender: invalid size %s\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+			if (sscanf(argv[++i], "%u", &nFrames) != 1 || nFrames == 0) {
+				fprintf(stderr, "clockrender: invalid number of frames %s\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--step") == 0 && hasValue) {
+			if (sscanf(argv[++i], "%u", &step) != 1) {
+				fprintf(stderr, "clockrender: invalid step %s\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--jobs") == 0 && hasValue) {
+			if (sscanf(argv[++i], "%u", &nThreads) != 1 || nThreads > 256) {
+				fprintf(stderr, "clockrender: invalid number of jobs %s\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--glyph-cache") == 0 && hasValue) {
+			if (sscanf(argv[++i], "%u", &glyphCacheMb) != 1 || glyphCacheMb == 0 || glyphCacheMb > 4096) {
+				fprintf(stderr, "clockrender: invalid glyph cache size %s\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--config") == 0 && hasValue) {
+			config = argv[++i];
+		}
+		else if (strcmp(argv[i], "--host") == 0 && hasValue) {
+			hostArg = argv[++i];
+		}
+		else if (strcmp(argv[i], "--monitor") == 0 && hasValue) {
+			if (sscanf(argv[++i], "%u", &monitor) != 1 || monitor == 0) {
+				fprintf(stderr, "clockrender: invalid monitor %s\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--font") == 0 && hasValue) {
+			fontPath = argv[++i];
+		}
+		else {
+			PrintUsage();
+			return 2;
+		}
+	}
+
+	if (!output) {
+		PrintUsage();
+		return 2;
+	}
+
+	BOOL sequence = nFrames > 1 || IsRawOutput(output) || strchr(output, '%');
+	if (sequence && timeArg) {
+		fprintf(stderr, "clockrender: --time renders a single frame, use --utc for sequences\n");
+		return 2;
+	}
+
+	// Select profiles as the screen saver would on a monitor of this size
+	WCHAR hostName[256];
+	PWSTR wideHost = hostArg ? Utf8ToWideString(hostArg) : NULL;
+	PROFILE_TARGET target = { NULL, monitor, width, height };
+	if (wideHost) {
+		target.host = wideHost;
+	}
+	else if (!hostArg && GetPlatformHostName(hostName, 256)) {
+		target.host = hostName;
+	}
+
+	PROPERTIES props = { 0 };
+	SETTINGS settings;
+	RestoreDefaultSettings(&settings);
+	BOOL loaded = !config || LoadSettingsFile(config, &props, &settings, &target);
+	free(wideHost);
+	if (!loaded) {
+		FreeProperties(&props);
+		return 1;
+	}
+
+	PWSTR wideFontPath = Utf8ToWideString(fontPath);
+	TTFONT font;
+	if (!wideFontPath || !LoadTrueTypeFont(&font, wideFontPath)) {
+		fprintf(stderr, "clockrender: cannot load font %s (error %u)\n", fontPath, (UINT)GetLastError());
+		free(wideFontPath);
+		FreeProperties(&props);
+		return 1;
+	}
+	free(wideFontPath);
+
+	// Determine the time shown by each clock
+	UINT nClocks = GetClockCount(&settings);
+	CLOCK_TIME times[MAX_CLOCKS];
+	LONGLONG utc;
+	if (timeArg) {
+		if (!ParseTimeOfDay(timeArg, &times[0])) {
+			fprintf(stderr, "clockrender: invalid time %s\n", timeArg);
+			FreeTrueTypeFont(&font);
+			FreeProperties(&props);
+			return 2;
+		}
+		for (UINT i = 1; i < nClocks; i++) {
+			times[i] = times[0];
+		}
+
+		// The burn-in drift follows the given time of day
+		utc = ((times[0].hour * 60LL + times[0].minute) * 60 + times[0].second) * 1000;
+	}
+	else {
+		utc = GetUtcTimeMs();
+		if (utcArg && !ParseUtcTime(utcArg, &utc)) {
+			fprintf(stderr, "clockrender: invalid UTC time %s\n", utcArg);
+			FreeTrueTypeFont(&font);
+			FreeProperties(&props);
+			return 2;
+		}
+
+		for (UINT i = 0; i < nClocks; i++) {
+			CLOCK_ZONE zone;
+			if (!ResolveClockZone(settings.nClocks ? settings.clocks[i].zone : NULL, &zone)) {
+				PSTR name = WideToUtf8String(settings.clocks[i].zone);
+				fprintf(stderr, "clockrender: unknown time zone %s, using local time\n", name ? name : "?");
+				free(name);
+			}
+
+			LOCAL_TIME_CACHE cache;
+			InitLocalTimeCache(&cache, &zone);
+			SplitClockTime(UtcToCachedLocalTimeMs(&cache, utc), &times[i]);
+		}
+
+		if (sequence) {
+			int ret = RenderSequence(output, &font, &settings, width, height, utc, step * 1000LL, nFrames, nThreads,
+				(SIZE_T)glyphCacheMb * 1024 * 1024);
+			FreeTrueTypeFont(&font);
+			FreeProperties(&props);
+			return ret;
+		}
+	}
+
+	GLYPH_CACHE glyphCache;
+	InitGlyphCache(&glyphCache, glyphCacheMb ? (SIZE_T)glyphCacheMb * 1024 * 1024 :
+		ChooseGlyphCacheSize((SIZE_T)settings.memoryBudget * 1024 * 1024));
+
+	SW_RENDERER renderer;
+	InitSwRenderer(&renderer, &font, &glyphCache);
+
+	SURFACE drifted = { 0 };
+	PSURFACE surface = settings.driftRange ? &drifted : &renderer.surface;
+
+	int ret = 0;
+	PWSTR wideOutput = Utf8ToWideString(output);
+	if (!RenderClockToSurface(&renderer, width, height, &settings, times) ||
+		(settings.driftRange && !PresentSwRenderer(&renderer, &drifted, &settings, utc))) {
+		fprintf(stderr, "clockrender: cannot render (error %u)\n", (UINT)GetLastError());
+		ret = 1;
+	}
+	else if (!wideOutput || !WriteImageFile(wideOutput, surface, GetImageFormatFromPath(wideOutput))) {
+		fprintf(stderr, "clockrender: cannot write %s (error %u)\n", output, (UINT)GetLastError());
+		ret = 1;
+	}
+
+	free(wideOutput);
+	FreeSurface(&drifted);
+	FreeSwRenderer(&renderer);
+	FreeGlyphCache(&glyphCache);
+	FreeTrueTypeFont(&font);
+	FreeProperties(&props);
+
+	return ret;
+}
@@ -0,0 +1,247 @@
+// Replays a script of frames through the software renderer and compares the
+// frames with golden hashes, e.g. to check that an optimization does not
+// change what is drawn, and reports how long the frames took.
+
+#include "replay.h"
+#include "utf.h"
+
+#include <stdio.h>
+
+// Mismatches beyond this are counted but not listed
+#define MAX_REPORTED_MISMATCHES 10
+
+static void PrintUsage(void) {
+	fprintf(stderr,
+		"Usage: clockreplay [options] <script>\n"
+		"  --golden <file>      compare the frames with a golden file\n"
+		"  --update <file>      write the frames to a golden file instead\n"
+		"  --timing <file.csv>  write the time of every frame\n"
+		"  --repeat N           replay N times and keep the fastest time of each frame (default: 1)\n"
+		"  --max-p95-ms MS      fail if the 95th percentile of the frame times exceeds MS milliseconds\n"
+		"  --font <file.ttf>    TrueType font (default: %s)\n",
+		DEFAULT_FONT_PATH);
+}
+
+static PWSTR ReadScript(PCSTR path) {
+	PWSTR widePath = Utf8ToWideString(path);
+	if (!widePath) return NULL;
+
+	PBYTE data;
+	SIZE_T size, chars;
+	BOOL ok = ReadFileContents(widePath, 1024 * 1024, &data, &size);
+	free(widePath);
+	if (!ok) return NULL;
+
+	PWSTR text = DecodeText(data, size, &chars);
+	free(data);
+	return text;
+}
+
+static BOOL WriteGolden(PCSTR path, const REPLAY *replay) {
+	FILE *file = fopen(path, "w");
+	if (!file) return FALSE;
+
+	fprintf(file, "# Hash and composed tiles of each frame, written by clockreplay --update\n");
+	for (UINT i = 0; i < replay->nFrames; i++) {
+		fprintf(file, "%016llx %u  # line %u\n", (unsigned long long)replay->frames[i].hash,
+			replay->frames[i].composedTiles, replay->frames[i].line);
+	}
+	return fclose(file) == 0;
+}
+
+// Compares frames with the lines of a golden file. Returns the number of
+// mismatches, or -1 if the file cannot be read.
+static int CompareGolden(PCSTR path, const REPLAY *replay) {
+	FILE *file = fopen(path, "r");
+	if (!file) return -1;
+
+	char line[256];
+	UINT nGolden = 0;
+	int mismatches = 0;
+	while (fgets(line, sizeof(line), file)) {
+		unsigned long long hash;
+		UINT tiles;
+		if (line[0] == '#' || sscanf(line, "%llx %u", &hash, &tiles) != 2) continue;
+
+		UINT i = nGolden++;
+		if (i >= replay->nFrames) continue;
+
+		const REPLAY_FRAME *frame = &replay->frames[i];
+		if (frame->hash == hash && frame->composedTiles == tiles) continue;
+
+		if (mismatches++ < MAX_REPORTED_MISMATCHES) {
+			fprintf(stderr, "clockreplay: frame %u (line %u) is %016llx with %u tiles, "
+				"expected %016llx with %u tiles\n", i, frame->line, (unsigned long long)frame->hash,
+				frame->composedTiles, hash, tiles);
+		}
+	}
+	fclose(file);
+
+	if (nGolden != replay->nFrames) {
+		fprintf(stderr, "clockreplay: %u frames, expected %u\n", replay->nFrames, nGolden);
+		mismatches++;
+	}
+	return mismatches;
+}
+
+static BOOL WriteTiming(PCSTR path, const REPLAY *replay) {
+	FILE *file = fopen(path, "w");
+	if (!file) return FALSE;
+
+	fprintf(file, "frame,line,hash,tiles,us\n");
+	for (UINT i = 0; i < replay->nFrames; i++) {
+		const REPLAY_FRAME *frame = &replay->frames[i];
+		fprintf(file, "%u,%u,%016llx,%u,%lld\n", i, frame->line, (unsigned long long)frame->hash,
+			frame->composedTiles, (long long)frame->us);
+	}
+	return fclose(file) == 0;
+}
+
+static int CompareTimes(const void *a, const void *b) {
+	LONGLONG x = *(const LONGLONG *)a, y = *(const LONGLONG *)b;
+	return x < y ? -1 : x > y;
+}
+
+// Returns the given percentile of the frame times
+static LONGLONG GetPercentile(const LONGLONG *sorted, UINT count, UINT percent) {
+	UINT i = (count * percent + 99) / 100;
+	return sorted[i ? i - 1 : 0];
+}
+
+int main(int argc, char **argv) {
+	PCSTR script = NULL, golden = NULL, update = NULL, timing = NULL, fontPath = DEFAULT_FONT_PATH;
+	UINT repeat = 1;
+	double maxP95Ms = 0;
+
+	for (int i = 1; i < argc; i++) {
+		BOOL hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--golden") == 0 && hasValue) {
+			golden = argv[++i];
+		}
+		else if (strcmp(argv[i], "--update") == 0 && hasValue) {
+			update = argv[++i];
+		}
+		else if (strcmp(argv[i], "--timing") == 0 && hasValue) {
+			timing = argv[++i];
+		}
+		else if (strcmp(argv[i], "--repeat") == 0 && hasValue) {
+			if (sscanf(argv[++i], "%u", &repeat) != 1 || repeat == 0 || repeat > 1000) {
+				fprintf(stderr, "clockreplay: invalid number of repetitions %s\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--max-p95-ms") == 0 && hasValue) {
+			if (sscanf(argv[++i], "%lf", &maxP95Ms) != 1 || maxP95Ms <= 0) {
+				fprintf(stderr, "clockreplay: invalid time %s\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "--font") == 0 && hasValue) {
+			fontPath = argv[++i];
+		}
+		else if (argv[i][0] != '-' && !script) {
+			script = argv[i];
+		}
+		else {
+			PrintUsage();
+			return 2;
+		}
+	}
+
+	if (!script || (golden && update)) {
+		PrintUsage();
+		return 2;
+	}
+
+	PWSTR text = ReadScript(script);
+	if (!text) {
+		fprintf(stderr, "clockreplay: cannot read %s (error %u)\n", script, (UINT)GetLastError());
+		return 1;
+	}
+
+	PWSTR wideFontPath = Utf8ToWideString(fontPath);
+	TTFONT font;
+	if (!wideFontPath || !LoadTrueTypeFont(&font, wideFontPath)) {
+		fprintf(stderr, "clockreplay: cannot load font %s (error %u)\n", fontPath, (UINT)GetLastError());
+		free(wideFontPath);
+		free(text);
+		return 1;
+	}
+	free(wideFontPath);
+
+	// Every run must give the same frames, only the times may differ
+	REPLAY replay = { 0 };
+	int ret = 0;
+	for (UINT run = 0; run < repeat && ret == 0; run++) {
+		REPLAY current = { 0 };
+		if (!RunReplay(&current, text, &font)) {
+			fprintf(stderr, "clockreplay: %s:%u: %s (error %u)\n", script, current.errorLine,
+				GetLastError() == ERROR_INVALID_DATA ? "invalid command" : "cannot render", (UINT)GetLastError());
+			ret = 1;
+		}
+		else if (run == 0) {
+			replay = current;
+			continue;
+		}
+		else {
+			for (UINT i = 0; i < replay.nFrames && ret == 0; i++) {
+				if (current.frames[i].hash != replay.frames[i].hash) {
+					fprintf(stderr, "clockreplay: frame %u differs between runs\n", i);
+					ret = 1;
+				}
+				replay.frames[i].us = min(replay.frames[i].us, current.frames[i].us);
+			}
+		}
+		FreeReplay(&current);
+	}
+	free(text);
+	FreeTrueTypeFont(&font);
+
+	if (ret == 0 && update) {
+		if (!WriteGolden(update, &replay)) {
+			fprintf(stderr, "clockreplay: cannot write %s\n", update);
+			ret = 1;
+		}
+	}
+	else if (ret == 0 && golden) {
+		int mismatches = CompareGolden(golden, &replay);
+		if (mismatches < 0) {
+			fprintf(stderr, "clockreplay: cannot read %s\n", golden);
+			ret = 1;
+		}
+		else if (mismatches > 0) {
+			fprintf(stderr, "clockreplay: %d mismatches with %s\n", mismatches, golden);
+			ret = 1;
+		}
+	}
+
+	if (ret == 0 && timing && !WriteTiming(timing, &replay)) {
+		fprintf(stderr, "clockreplay: cannot write %s\n", timing);
+		ret = 1;
+	}
+
+	if (ret == 0 && replay.nFrames) {
+		LONGLONG *times = malloc(replay.nFrames * sizeof(LONGLONG));
+		LONGLONG total = 0;
+		for (UINT i = 0; times && i < replay.nFrames; i++) {
+			times[i] = replay.frames[i].us;
+			total += times[i];
+		}
+		if (times) {
+			qsort(times, replay.nFrames, sizeof(LONGLONG), CompareTimes);
+			LONGLONG p95 = GetPercentile(times, replay.nFrames, 95);
+			fprintf(stderr, "clockreplay: %u frames in %.2f ms, median %.3f ms, 95%% %.3f ms, max %.3f ms\n",
+				replay.nFrames, total / 1000.0, GetPercentile(times, replay.nFrames, 50) / 1000.0, p95 / 1000.0,
+				times[replay.nFrames - 1] / 1000.0);
+
+			if (maxP95Ms && p95 / 1000.0 > maxP95Ms) {
+				fprintf(stderr, "clockreplay: the 95th percentile exceeds %.3f ms\n", maxP95Ms);
+				ret = 1;
+			}
+			free(times);
+		}
+	}
+
+	FreeReplay(&replay);
+	return ret;
+}